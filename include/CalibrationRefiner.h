@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include "ThreadPool.h"
+
+// One RealSense cloud of a scan: a camera at a turntable angle, kept in the camera frame
+struct CameraView {
+    std::string file;
+    int camera;                     // Index into the refiner cameras
+    int angle;
+    Eigen::Matrix4d turntable;      // Turntable rotation of the angle
+    std::vector<Eigen::Vector3d> points;
+    std::vector<Eigen::Vector3d> normals;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> tree;
+};
+
+// Two overlapping views, the points of a are matched against b
+struct ViewPair {
+    size_t a;
+    size_t b;
+    double overlap;
+};
+
+struct RefinementStats {
+    int iterations = 0;
+    double initial_rmse = 0;
+    double final_rmse = 0;
+    size_t correspondences = 0;
+};
+
+// Multi-view ICP over the RealSense clouds of a scanned pose. Every view is placed in the world
+// as turntable(angle) * camera transform * points, so all views of a camera share the same unknown.
+// Pairs of overlapping views (neighboring cameras at the same angle, any camera at the next angle)
+// are matched point to plane, and the camera transforms are solved jointly with a robust
+// Gauss-Newton pose graph. The reference camera keeps its rotation about and its height along the
+// turntable axis, which the scan cannot observe. Pairs run in parallel.
+class CalibrationRefiner {
+public:
+    CalibrationRefiner(size_t num_threads);
+
+    void addCamera(const std::string& name, const Eigen::Matrix4d& transform);
+    // Loads the <camera>_<angle>_cloud.ply files of a pose realsense folder. Clouds are expected
+    // in the world frame unless raw (saved with realsense.raw_pointcloud)
+    size_t loadPose(const std::string& realsense_dir, double voxel_size, bool raw);
+    // Keeps the candidate pairs with at least min_overlap of their points within max_distance
+    size_t findPairs(double max_distance, double min_overlap);
+    // Refines the camera transforms, shrinking the correspondence distance from start to end over
+    // the first half of the iterations
+    RefinementStats refine(int iterations, double start_distance, double end_distance, const std::string& reference);
+
+    const std::vector<std::string>& cameraNames() const { return names; }
+    const Eigen::Matrix4d& cameraTransform(size_t camera) const { return transforms[camera]; }
+    const std::vector<CameraView>& cameraViews() const { return views; }
+    const std::vector<ViewPair>& viewPairs() const { return pairs; }
+
+    size_t max_points_per_pair = 1000;
+    int normal_neighbors = 12;
+    bool verbose = true;
+
+private:
+    void parallelFor(size_t count, const std::function<void(size_t, size_t, size_t)>& task);
+    double pairOverlap(const ViewPair& pair, double max_distance) const;
+
+    std::vector<std::string> names;
+    std::vector<Eigen::Matrix4d> transforms;
+    std::vector<CameraView> views;
+    std::vector<ViewPair> pairs;
+    size_t num_threads;
+    ThreadPool pool;
+};
+
+// Turntable rotation of the scanner, same as createRotationMatrix in RealSenseHandler.cpp
+Eigen::Matrix4d turntableRotation(double angle_degrees);
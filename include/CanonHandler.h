@@ -5,8 +5,13 @@
 #include <map>
 #include <thread>
 #include <regex>
+#include <mutex>
+#include <future>
 #include "EDSDK.h"
 #include "EDSDKTypes.h"
+#include "DeviceRegistry.h"
+#include "ImageQuality.h"
+#include "ScanManifest.h"
 
 
 class CanonHandler {
@@ -18,8 +23,10 @@ public:
     ~CanonHandler();
     void initialize();
     int camera_check();
+    int open_sessions();
 
     int turntable_position = 0;
+    double shot_ms = 0;             // When the pictures of the angle were taken, ms since the epoch
     int images_downloaded = 0;
     bool save_image = true;
     std::string save_dir;
@@ -34,7 +41,30 @@ public:
 	std::vector<EdsUInt64> bodyID;
 
     bool rename_cameras = true;
-    std::map<std::string, std::string> camera_names;
+    // Device registry id of each camera in cameraArray (-1 until registered)
+    std::vector<int> camera_ids;
+    // Whether the session of each camera in cameraArray could be opened (open_sessions)
+    std::vector<bool> session_open;
+    int register_camera(size_t index, const std::string& serial, const std::string& name);
+    std::string camera_name(size_t index) const;
+    std::string camera_label(EdsCameraRef camera) const;
+
+    // When set, transfer requests are queued and downloaded later with download_pending()
+    bool defer_downloads = false;
+    std::vector<std::pair<EdsDirectoryItemRef, EdsVoid*>> pending_transfers;
+    int download_pending();
+
+    // Sharpness scoring of the downloaded images (dslr.quality), runs off the download path
+    QualityTracker quality;
+    std::vector<std::future<void>> quality_tasks;
+    void score_image(ManifestRecord record, size_t index);
+    void wait_quality();
+    // Cameras whose last image was flagged as blurry
+    std::vector<size_t> take_reshoots();
+
+private:
+    std::mutex reshoot_mtx;
+    std::vector<size_t> reshoot;
 };
 
 extern CanonHandler canonhandle;
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "ThreadPool.h"
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> ColorCloud;
+
+struct ICPScale {
+    double voxel_size;      // Also used as the maximum correspondence distance
+    int max_iterations;
+};
+
+struct RegistrationResult {
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    double fitness = 0;
+    double inlier_rmse = 0;
+    size_t correspondences = 0;
+    int iterations = 0;
+};
+
+// Multi-scale colored ICP (Park, Zhou, Koltun, "Colored Point Cloud Registration Revisited",
+// ICCV 2017), the same method as Open3D's registration_colored_icp used by align_clouds.py.
+// The correspondence search and the linear system are computed in parallel on a thread pool.
+class CloudAligner {
+public:
+    CloudAligner(size_t num_threads);
+
+    // Aligns source onto target, refining the transformation from the coarsest to the finest scale
+    RegistrationResult align(const ColorCloud::ConstPtr& source, const ColorCloud::ConstPtr& target,
+        const std::vector<ICPScale>& scales, const Eigen::Matrix4d& init = Eigen::Matrix4d::Identity());
+
+    double lambda_geometric = 0.968;
+    // Stops a scale when fitness and rmse change less than this between iterations
+    double relative_fitness = 1e-6;
+    double relative_rmse = 1e-6;
+    bool verbose = true;
+
+private:
+    struct TargetData {
+        std::vector<Eigen::Vector3d> points;
+        std::vector<Eigen::Vector3d> normals;
+        std::vector<Eigen::Vector3d> gradients;
+        std::vector<double> intensities;
+    };
+
+    RegistrationResult alignScale(const ColorCloud::ConstPtr& source, const ColorCloud::ConstPtr& target,
+        const ICPScale& scale, const Eigen::Matrix4d& init);
+    TargetData prepareTarget(const ColorCloud::ConstPtr& target, double radius, int max_nn);
+    void parallelFor(size_t count, const std::function<void(size_t, size_t, size_t)>& task);
+
+    size_t num_threads;
+    ThreadPool pool;
+};
+
+// Transform of a small motion (rotation about x, y, z in radians, translation), as solved by ICP
+Eigen::Matrix4d vectorToTransform(const Eigen::Matrix<double, 6, 1>& x);
+ColorCloud::Ptr voxelDownsample(const ColorCloud::ConstPtr& cloud, double voxel_size);
+// Unoriented normal of the first count points of indices
+Eigen::Vector3d estimateNormal(const std::vector<Eigen::Vector3d>& points, const std::vector<int>& indices, int count);
+// Rotation from Euler angles in degrees (Z * Y * X order, as euler_to_rotation_matrix in align_clouds.py)
+Eigen::Matrix3d eulerToRotation(double roll_deg, double pitch_deg, double yaw_deg);
+// Prints the matrix the way numpy does, so the output matches align_clouds.py
+std::string formatTransform(const Eigen::Matrix4d& transformation);
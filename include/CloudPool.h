@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/filters/voxel_grid.h>
+
+// Clouds and PCL objects used to process one frameset. They keep their capacity and their index
+// buffers between framesets, so a camera in steady state reuses them instead of allocating.
+struct CloudBuffers {
+    CloudBuffers();
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr scratch;     // Filter output, swapped with cloud
+    pcl::PointCloud<pcl::Normal>::Ptr normals;
+    pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr normal_cloud;
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree;
+    pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor{true};
+    pcl::VoxelGrid<pcl::PointXYZRGB> voxel;
+
+    // Filters cloud into scratch and swaps them (filtering a cloud into itself makes PCL copy it)
+    template <typename Filter>
+    void filter(Filter& cloud_filter) {
+        cloud_filter.setInputCloud(cloud);
+        cloud_filter.filter(*scratch);
+        cloud.swap(scratch);
+    }
+    // Keeps the points inside the box, in place (same result as pass-through filters on x, y and z)
+    void crop(const Eigen::Vector3f& min, const Eigen::Vector3f& max);
+    void clear();
+    void reserve(size_t points);
+    size_t capacity() const;
+};
+
+// Buffers of one camera. Tasks borrow a set for a frameset and it comes back to the pool when the
+// last copy of the pointer is dropped. New sets are reserved to the largest cloud seen so far, and
+// at most max_idle sets are kept.
+class CloudPool : public std::enable_shared_from_this<CloudPool> {
+public:
+    explicit CloudPool(size_t max_idle = 2) : max_idle(max_idle) {}
+
+    std::shared_ptr<CloudBuffers> borrow();
+    void setMaxIdle(size_t count);
+    size_t highWater();
+    size_t created();
+
+private:
+    void release(CloudBuffers* buffers);
+
+    std::mutex mtx;
+    std::vector<std::unique_ptr<CloudBuffers>> idle;
+    size_t max_idle;
+    size_t high_water = 0;
+    size_t sets_created = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+
+enum class DeviceKind { RealSense = 0, Canon = 1 };
+
+enum class DeviceState { Offline = 0, Ready, Capturing, Failed };
+
+// Health and throughput counters of a device, updated from the capture and processing threads
+// without locking
+struct DeviceStats {
+    std::atomic<int> captures{0};           // Framesets or images saved
+    std::atomic<int> dropped{0};            // Frames skipped by the device, images that never arrived
+    std::atomic<int> failures{0};
+    std::atomic<int> retries{0};
+    std::atomic<long long> process_us{0};   // Processing (RealSense) or download (Canon) time
+    std::atomic<long long> bytes_written{0};
+
+    void addTime(std::chrono::steady_clock::time_point start) {
+        process_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    void reset() {
+        captures = 0;
+        dropped = 0;
+        failures = 0;
+        retries = 0;
+        process_us = 0;
+        bytes_written = 0;
+    }
+};
+
+struct DeviceInfo {
+    int id;
+    DeviceKind kind;
+    int slot;               // Index among the devices of the same kind
+    std::string serial;
+    std::string name;       // Used in file names (rs1, or 1 for cam1)
+    std::string label;      // Shown in the menus
+};
+
+// Gives every RealSense and Canon device a small integer id the first time it is seen, and
+// keeps it for the whole run. Slots are dense per kind, so the handlers keep their device data
+// in flat arrays. Devices are only added during initialization, afterwards the infos, stats and
+// states can be read from any thread.
+class DeviceRegistry {
+public:
+    static DeviceRegistry& getInstance() {
+        static DeviceRegistry instance;
+        return instance;
+    }
+
+    // Returns the id of the device, adding it if the serial is new (the names are then updated)
+    int add(DeviceKind kind, const std::string& serial, const std::string& name, const std::string& label = "");
+    // Returns -1 if the device was never added
+    int find(DeviceKind kind, const std::string& serial) const;
+    int id(DeviceKind kind, int slot) const { return slots[static_cast<int>(kind)][slot]; }
+    int count(DeviceKind kind) const { return static_cast<int>(slots[static_cast<int>(kind)].size()); }
+    int size() const { return static_cast<int>(devices.size()); }
+
+    const DeviceInfo& info(int id) const { return devices[id]; }
+    DeviceStats& stats(int id) { return device_stats[id]; }
+    DeviceState state(int id) const { return static_cast<DeviceState>(states[id].load()); }
+    void setState(int id, DeviceState state) { states[id] = static_cast<int>(state); }
+    void resetStats();
+
+private:
+    DeviceRegistry() {}
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+    std::vector<DeviceInfo> devices;
+    std::vector<int> slots[2];
+    // Atomics cannot be moved, a deque keeps them in place as devices are added
+    std::deque<DeviceStats> device_stats;
+    std::deque<std::atomic<int>> states;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <functional>
+
+// One step of the startup of a device (opening a session, starting a pipeline, warmup frames)
+struct StartupResult {
+    std::string kind;       // RealSense or Canon
+    std::string device;
+    std::string step;
+    bool ok = false;
+    int attempts = 0;
+    double ms = 0;
+    std::string error;
+};
+
+// Startup steps of the devices since the last clear, filled from the startup threads
+class StartupReport {
+public:
+    static StartupReport& getInstance() {
+        static StartupReport instance;
+        return instance;
+    }
+
+    void add(const StartupResult& result) {
+        std::lock_guard<std::mutex> lock(mtx);
+        results.push_back(result);
+    }
+    std::vector<StartupResult> take() {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<StartupResult> taken;
+        taken.swap(results);
+        return taken;
+    }
+
+private:
+    StartupReport() {}
+    StartupReport(const StartupReport&) = delete;
+    StartupReport& operator=(const StartupReport&) = delete;
+
+    std::mutex mtx;
+    std::vector<StartupResult> results;
+};
+
+// Runs a startup step on its own thread, again while it throws, up to retries times. An attempt
+// that takes longer than timeout_ms is given up and not retried, as the device is still busy with
+// it: its thread is left to finish and its result goes to abandon (if given), which undoes what a
+// late success did (closes the session, stops the pipeline). The step is added to the report.
+template <typename T>
+bool runStartupStep(const std::function<T()>& attempt, int timeout_ms, int retries, StartupResult& result, T& value,
+                    const std::function<void(T&)>& abandon = nullptr) {
+    // Shared with the attempt thread, which may outlive this call
+    struct AttemptState {
+        std::mutex mtx;
+        std::promise<T> promise;
+        bool given_up = false;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    int max_attempts = retries > 0 ? retries + 1 : 1;
+    result.ok = false;
+    result.attempts = 0;
+    while (result.attempts < max_attempts) {
+        result.attempts++;
+        auto state = std::make_shared<AttemptState>();
+        std::future<T> future = state->promise.get_future();
+        std::thread([state, attempt, abandon]() {
+            try {
+                T attempt_value = attempt();
+                std::unique_lock<std::mutex> lock(state->mtx);
+                if (!state->given_up) {
+                    state->promise.set_value(attempt_value);
+                    return;
+                }
+                lock.unlock();
+                if (abandon) abandon(attempt_value);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                if (!state->given_up) state->promise.set_exception(std::current_exception());
+            }
+        }).detach();
+        if (future.wait_for(std::chrono::milliseconds(timeout_ms)) == std::future_status::timeout) {
+            // The attempt may have finished just now, only give it up while it is still running
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if (future.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout) {
+                state->given_up = true;
+                result.error = "timed out after " + std::to_string(timeout_ms) + " ms";
+                break;
+            }
+        }
+        try {
+            value = future.get();
+            result.ok = true;
+            result.error.clear();
+            break;
+        }
+        catch (const std::exception& e) {
+            result.error = e.what();
+        }
+    }
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    StartupReport::getInstance().add(result);
+    return result.ok;
+}
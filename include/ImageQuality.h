@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+
+// Sharpness and exposure of an image, the metrics of scripts/measure_blur.py
+struct ImageScore {
+    double laplacian = 0;       // Variance of the Laplacian
+    double gradient = 0;        // Mean Sobel gradient magnitude (the directional metric)
+    double directionality = 0;  // |std(gx) - std(gy)|
+    double frequency = 0;       // Mean log magnitude of the last 10 rows of the shifted spectrum
+    double brightness = 0;      // Mean gray level
+    double clipped = 0;         // Fraction of pixels under 5 or over 250
+    int width = 0;
+    int height = 0;
+    double decode_ms = 0;
+    double score_ms = 0;
+};
+
+// Laplacian, Sobel and exposure statistics of an 8-bit gray image in one pass. The 1 pixel border
+// is skipped. The inner loops only use integer math on contiguous rows so they are vectorized.
+ImageScore scoreGray(const unsigned char* data, int width, int height, size_t stride);
+double frequencySharpness(const cv::Mat& gray);
+// Decodes a JPEG at 1/reduction of its size (1, 2, 4 or 8, scaled in the DCT domain by libjpeg)
+// and scores it. The frequency metric needs a DFT, so it is only computed when asked.
+ImageScore scoreImage(const std::string& file, int reduction, bool frequency);
+// Value of a metric (laplacian, directional or frequency), higher is sharper
+double metricValue(const ImageScore& score, const std::string& metric);
+
+// Running mean and deviation of the metric per camera. A value is an outlier when it is more than
+// num_std_dev deviations from the mean of the previous values of its camera, like
+// detect_outliers in measure_blur.py but without waiting for the whole pose.
+class QualityTracker {
+public:
+    // Returns the z-score of the value against the previous ones, 0 until min_samples were added
+    double add(const std::string& camera, double value, int min_samples);
+    void reset();
+
+private:
+    struct Running {
+        int count = 0;
+        double mean = 0;
+        double m2 = 0;
+    };
+    std::map<std::string, Running> cameras;
+    std::mutex mtx;
+};
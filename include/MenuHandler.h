@@ -4,6 +4,8 @@
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
 
 #include "tabulate.hpp"
 
@@ -23,6 +25,11 @@ private:
     std::string help_title;
     tabulate::Table message;
     std::mutex print_mtx;
+    std::thread status_thread;
+    std::atomic<bool> status_running{false};
+    std::condition_variable status_cv;
+    static int ConsoleRows();
+    void DrawStatus();
 public:
     MenuHandler(
         std::map<std::string, std::string>, 
@@ -37,4 +44,7 @@ public:
     void setTitle(std::string);
     void setHelpTitle(std::string);
     void addMessage(MenuMessageStatus, std::string);
+    static tabulate::Table DeviceStatus();
+    void StartStatus(int refresh_ms);
+    void StopStatus();
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+
+#include "ThreadPool.h"
+
+// Covariances of a block of points, one array per coefficient of the symmetric 3x3 matrix so the
+// solver runs the same straight-line code over the whole block
+struct CovarianceBlock {
+    std::vector<float> xx, xy, xz, yy, yz, zz;
+    void resize(size_t count);
+};
+
+// Normal (eigenvector of the smallest eigenvalue) and curvature (smallest eigenvalue / trace) of the
+// first count covariances, closed form. Degenerate neighborhoods get a NaN normal.
+void solveNormals(const CovarianceBlock& block, size_t count, float* nx, float* ny, float* nz, float* curvature);
+
+// Normals from the covariance of the k nearest neighbors, or of the neighbors within radius (at
+// most k). Replaces pcl::NormalEstimationOMP: the chunks of points run on the calling thread and on
+// up to threads - 1 tasks of the given pool, instead of OpenMP threads.
+class NormalEstimator {
+public:
+    int k = 16;
+    float radius = 0;                   // 0 = k nearest neighbors
+    int threads = 1;                    // Chunks computed at once, the calling thread included
+    size_t chunk_size = 4096;
+
+    // Normals of cloud in the order of its points, oriented toward viewpoint. tree is set to cloud.
+    void compute(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr& cloud, pcl::search::KdTree<pcl::PointXYZRGB>& tree,
+                 const Eigen::Vector3f& viewpoint, pcl::PointCloud<pcl::Normal>& normals, ThreadPool* pool = nullptr) const;
+
+private:
+    void computeChunk(const pcl::PointCloud<pcl::PointXYZRGB>& cloud, const pcl::search::KdTree<pcl::PointXYZRGB>& tree,
+                      const Eigen::Vector3f& viewpoint, size_t begin, size_t end, pcl::PointCloud<pcl::Normal>& normals) const;
+};
@@ -1,4 +1,5 @@
 #include <vector>
 #include "EDSDKTypes.h"
 
+EdsError PreSettingCamera(EdsCameraRef camera, EdsUInt64 bodyID);
 EdsError PreSetting(std::vector<EdsCameraRef> const& cameraArray, std::vector<EdsUInt64> const& bodyID);
\ No newline at end of file
@@ -1,48 +1,142 @@
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <vector> 
 #include <string>
 #include <map>
+#include <set>
+#include <deque>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <Eigen/Dense>
 #include <librealsense2/rs.hpp>
 #include <opencv2/opencv.hpp>
 #include <nlohmann/json.hpp>
 
-#include "ThreadPool.h"
+#include "DeviceRegistry.h"
+#include "ScanManifest.h"
+#include "CloudPool.h"
+
+// World transform of one camera at one turntable angle. Processing tasks get their own copy,
+// so nothing they read changes while the next angle is captured.
+struct ViewTransform {
+    int camera_id = -1;     // Device registry id
+    int slot = -1;          // RealSense slot
+    std::string camera_name;
+    Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();  // Turntable rotation * camera transform
+    Eigen::Vector4f origin = Eigen::Vector4f(0.0f, 0.0f, 0.0f, 1.0f);  // Camera position in the world
+};
+
+// A frameset with its capture time in host ms since the epoch. Frames without a host time stamp
+// (global time or arrival metadata) get the time the host received them, which includes the
+// transfer delay, so they are not compared against the other devices.
+struct TimedFrameset {
+    rs2::frameset frameset;
+    double time_ms = 0;
+    bool host_time = false;     // time_ms comes from the frame itself
+};
+
 class RealSenseHandler {
 private:
     bool running = true;
+    std::atomic<bool> polling{false};
     
-    std::map<std::string, std::string> camera_names;
-    std::map<std::string, Eigen::Matrix4f> camera_transforms;
-    Eigen::Matrix4f rot_matrix;
+    // Per device data, indexed by the RealSense slot in the device registry (transform file
+    // order, devices without a transform are appended)
+    struct Device {
+        int id = -1;
+        std::string serial;
+        Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();
+        std::shared_ptr<rs2::pipeline> pipe;            // Set once the device is started
+        std::deque<TimedFrameset> frames;               // Latest framesets, guarded by framesetMutex
+        std::thread frame_thread;
+        unsigned long long last_frame = 0;              // Depth frame number seen by the frame thread
+        int decimation = 1;
+        // Depth filters of the device, they keep state between frames (temporal history). The
+        // framesets of a device may be processed at once on the cpu queue, filter_mtx runs its
+        // filter chain, its aligner and its point cloud block one frameset at a time.
+        rs2::decimation_filter decimation_filter;
+        rs2::threshold_filter threshold_filter;
+        rs2::spatial_filter spatial_filter;
+        rs2::temporal_filter temporal_filter;
+        std::shared_ptr<std::mutex> filter_mtx = std::make_shared<std::mutex>();
+        rs2::align align{RS2_STREAM_DEPTH};             // Kept for the aligned color images
+        rs2::pointcloud pointcloud;                     // Kept for the depth to point projection
+        std::shared_ptr<CloudPool> buffers = std::make_shared<CloudPool>();  // Clouds reused across the angles
+        std::vector<float> latency_ms;                  // Frame thread latencies, guarded by framesetMutex
+    };
+    std::vector<Device> devices;
+    std::vector<int> started;                           // Slots of the started devices
+    // Composed transforms of the scan, indexed [angle index * cameras + slot]
+    std::vector<ViewTransform> view_table;
+    int table_start = 0;
+    int table_inc = 0;
+    int table_angles = 0;
+    int table_cameras = 0;
     size_t device_count;
+    bool initialized = false;
+    nlohmann::json active_stream;                       // Stream settings the pipelines were started with
+    std::string transforms_text;                        // Content of the loaded transform file
     rs2::context ctx;
-    rs2::threshold_filter threshold_filter;
-    rs2::decimation_filter decimation_filter;
-    rs2::spatial_filter spatial_filter;
-    rs2::temporal_filter temporal_filter;
-    std::vector<rs2::pipeline> pipelines;
-    std::map<std::string, rs2::pipeline> pipeline_map;
-    std::map<std::string, rs2::frameset> frameset_map;
     std::mutex framesetMutex;
-    std::map<std::string, std::thread> frame_thread_map;
+    std::condition_variable framesetCondition;
+    size_t frame_cache_size = 4;
+    size_t max_latency_samples = 100000;
+    // Processing stage name -> total ms, for the profile benchmark
+    std::mutex stage_mtx;
+    std::map<std::string, double> stage_totals;
+    size_t stage_points = 0;
+    int stage_framesets = 0;
 
     cv::Mat h;
 
     void print_device(rs2::device dev, bool print_streams=true);
-    void process_frames(rs2::pipeline pipe, int degree, int timeout_ms=10000);
-    void start_device(std::string serial_number);
-    void frame_poll_thread(rs2::pipeline pipe);
+    TimedFrameset grab_frameset(rs2::pipeline pipe, const ViewTransform& view, int timeout_ms);
+    void process_frameset(rs2::frameset fs, ViewTransform view, int degree, double capture_ms);
+    void process_framesets(const std::vector<std::pair<ViewTransform, TimedFrameset>>& framesets, int degree, bool background);
+    void file_saved(int camera_id, const ManifestRecord& record);
+    int register_camera(const std::string& serial_number);
+    std::string device_name(const std::string& serial_number) const;
+    std::vector<ViewTransform> compute_views(int angle) const;
+    std::vector<ViewTransform> get_views(int angle) const;
+    std::shared_ptr<rs2::pipeline> start_device(std::string serial_number, std::string playback_file="");
+    std::vector<std::pair<std::string, std::string>> find_recordings(std::string playback_dir);
+    void load_transforms();
+    void apply_filters();
+    nlohmann::json stream_settings() const;
+    nlohmann::json stream_profile(const std::string& name) const;
+    void add_stage_times(const nlohmann::json& timings, size_t points);
+    void frame_poll_thread(int slot);
+    void start_frame_threads();
+    void stop_frame_threads();
+    TimedFrameset select_frameset(int slot, double trigger_ms, int timeout_ms);
+    bool skip_device(int slot) const;
+    void get_synced_frames(int degree, const std::vector<ViewTransform>& views, int timeout_ms, bool background);
 public:
     int turntable_position = 0;
-    int fail_count = 0;
+    std::atomic<int> fail_count{0};
     std::string save_dir;
+    std::set<std::string> only_cameras;     // Names of the devices to capture, all of them if empty
+    nlohmann::json last_sync_info;
     
     RealSenseHandler();
     ~RealSenseHandler();
     int device_check();
     void initialize();
+    bool is_initialized() const;
+    bool apply_config();
+    void reset_stage_times();
+    nlohmann::json stage_times();
+    void reset_frame_latency();
+    nlohmann::json frame_latency();
+    void prepare_scan(int start_degree, int degree_inc, int num_moves);
     void get_frames(int num_frames=1, int timeout_ms=10000);
-    void get_current_frame(int degree, int timeout_ms=10000, ThreadPool* pool=nullptr);
+    int wait_for_settle(int max_ms);
+    // Captures every device and processes the framesets on the cpu queue of the scheduler. With
+    // background set it returns once the framesets are captured.
+    void get_current_frame(int degree, int timeout_ms=10000, bool background=false);
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "ThreadPool.h"
+
+struct ArchiveOptions {
+    int level = 3;                                      // zstd level
+    size_t block_size = 4 << 20;                        // Files are compressed in blocks of this size
+    size_t threads = 2;                                 // Threads of the archive, without a pool
+    ThreadPool* pool = nullptr;                         // Shared pool to run on instead, not owned
+    std::set<std::string> store_extensions = { ".jpg", ".jpeg", ".png" };  // Already compressed
+};
+
+// A block of a file, stored as is (method 0) or as an independent zstd frame (method 1)
+struct ArchiveBlock {
+    uint64_t offset = 0;
+    uint64_t stored = 0;                                // Size in the archive
+    uint64_t size = 0;                                  // Size in the file
+    int method = 0;
+};
+
+struct ArchiveEntry {
+    std::string path;                                   // Relative to the archived folder, with /
+    uint64_t size = 0;
+    std::string xxh64;
+    std::vector<ArchiveBlock> blocks;
+};
+
+// Seekable archive of a folder (.moadpack), filled while the folder is written. Files are added as
+// they are completed, read on a pool and compressed in independent blocks, so big files use several
+// threads and any file can be read without the others. The layout is the "MOADPAK1" magic, the
+// blocks in the order they were compressed, a JSON index (path, size, xxh64 and blocks of every file)
+// and a 24 byte trailer: index offset and size (little endian 64 bit) and the magic again.
+class ScanArchive {
+public:
+    // The archive of the running scan
+    static ScanArchive& getInstance() {
+        static ScanArchive instance;
+        return instance;
+    }
+
+    ScanArchive() {}
+    ~ScanArchive();
+
+    // Starts an archive of the files under root, replacing the file at path
+    bool open(const std::string& path, const std::string& root, const ArchiveOptions& options);
+    bool isOpen();
+    // Queues a completed file, safe to call from any thread. Files outside root or already added are ignored.
+    void add(const std::string& file);
+    // Waits for the queued files, adds the files of root that were not added yet (sweep) and writes the index
+    bool close(bool sweep = true);
+
+    // Reads the index of an archive
+    static bool readIndex(const std::string& path, std::vector<ArchiveEntry>& entries, std::string& error);
+    // Passes the content of a file to sink, block by block
+    static bool readEntry(std::ifstream& archive, const ArchiveEntry& entry,
+                          const std::function<void(const char*, size_t)>& sink, std::string& error);
+    // True if zstd was available at build time, otherwise every block is stored
+    static bool compressionAvailable();
+
+    static constexpr const char* extension = ".moadpack";
+
+private:
+    ScanArchive(const ScanArchive&) = delete;
+    ScanArchive& operator=(const ScanArchive&) = delete;
+
+    void packFile(const std::string& file, const std::string& name);
+    void packBlock(std::shared_ptr<std::vector<char>> data, size_t entry, size_t block, bool store);
+    void wait();
+
+    std::mutex mtx;
+    std::condition_variable done;
+    std::ofstream output;
+    std::string path;
+    std::string root;
+    ArchiveOptions options;
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    std::set<std::string> names;
+    std::vector<ArchiveEntry> entries;
+    uint64_t write_pos = 0;
+    size_t pending = 0;
+    uint64_t raw_bytes = 0;
+    double start_ms = 0;
+};
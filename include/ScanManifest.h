@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <map>
+#include <set>
+#include <nlohmann/json.hpp>
+
+// A file saved during a scan
+struct ManifestRecord {
+    std::string file;                                   // Full path of the saved file
+    std::string camera;                                 // rs1, cam1, ...
+    std::string type;                                   // cloud, color, depth or img
+    int angle = 0;
+    double capture_ms = 0;                              // Capture time in ms since the epoch
+    nlohmann::json timings = nlohmann::json::object();  // Stage name -> ms
+    nlohmann::json details = nlohmann::json::object();  // Extra fields of the line, e.g. quality
+};
+
+// Files already saved in a pose folder, used to resume a scan
+struct PoseProgress {
+    nlohmann::json scan = nlohmann::json::object();    // Last scan_start line, empty without a manifest
+    bool finished = false;                              // The last scan has its scan_end line
+    // Angle -> camera -> types of the saved files
+    std::map<int, std::map<std::string, std::set<std::string>>> files;
+};
+
+// Append-only manifest of a pose (scan_manifest.jsonl in the pose folder). Every line is a JSON
+// object written and flushed as soon as its file is complete, so other tools can follow the scan
+// while it runs. The first line of a scan has "event": "scan_start" with the scan parameters, every
+// saved file adds an "event": "file" line (path relative to the pose folder, size, xxh64, camera,
+// type, angle, capture time and stage timings) and "event": "scan_end" closes it.
+class ScanManifest {
+public:
+    static ScanManifest& getInstance() {
+        static ScanManifest instance;
+        return instance;
+    }
+
+    // Starts a scan in the manifest of the pose folder, does nothing if scan_manifest.enable is false
+    void open(const std::string& pose_dir, const nlohmann::json& scan);
+    void close(const nlohmann::json& summary);
+    bool isOpen();
+    // Adds a completed file, safe to call from any thread. The file is hashed before the lock is taken.
+    void record(const ManifestRecord& record);
+
+    // Reads the manifest of a pose folder. Only the files that still have their recorded size count.
+    // Without a manifest the <camera>_<angle>_<type> names in the realsense and DSLR folders are used.
+    static PoseProgress readProgress(const std::string& pose_dir);
+
+    // XXH64 of a file as 16 hex digits, empty if it cannot be read
+    static std::string checksum(const std::string& file);
+    static double nowMs();
+
+    static constexpr const char* file_name = "scan_manifest.jsonl";
+
+private:
+    ScanManifest() {}
+    ScanManifest(const ScanManifest&) = delete;
+    ScanManifest& operator=(const ScanManifest&) = delete;
+
+    void write(const nlohmann::json& line);
+
+    std::mutex mtx;
+    std::ofstream manifest;
+    std::string pose_dir;
+    bool checksums = true;
+};
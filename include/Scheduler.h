@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+
+#include "ThreadPool.h"
+
+// Threads of a queue, the cores they may run on and their priority
+struct QueueOptions {
+    size_t threads = 1;                 // 0 = one per core of the queue
+    std::vector<int> cores;             // Any core if empty
+    std::string priority = "normal";    // normal, high or realtime
+};
+
+// Process wide task queues, so the capture, the processing and the files share one set of threads
+// sized to the machine instead of every call site starting its own:
+//  - capture: waits on the devices (RealSense framesets)
+//  - cpu: cloud filters and normals
+//  - io: archive packing
+//  - background: image scores, liveview loops
+// The queues are made from the "scheduler" section of the config, with their threads restricted to
+// the cores of the queue when cores are given. With dedicated capture, each device capture thread
+// gets one of the capture cores and the queues without cores run on the other cores, so the
+// filters do not delay the frame grabs.
+class Scheduler {
+public:
+    static Scheduler& getInstance() {
+        static Scheduler instance;
+        return instance;
+    }
+
+    static const std::vector<std::string>& queueNames();
+
+    // (Re)creates the queues from the config. The old queues finish their tasks first, so this is
+    // only called between scans.
+    void configure();
+    void configure(std::map<std::string, QueueOptions> new_options, bool dedicated);
+    // The pool of a queue, created with one thread if configure was never called
+    ThreadPool& queue(const std::string& name);
+    std::future<void> submit(const std::string& name, std::function<void()> task);
+    void waitIdle(const std::string& name);
+    // Thread of its own on the cores of the queue, for loops that would hold a worker for good
+    std::thread startThread(const std::string& name, std::function<void()> loop);
+    // Pins the capture thread of a device (RealSense frame thread) to its capture core and gives it
+    // the capture priority
+    void enterCaptureThread(size_t device);
+    QueueOptions options(const std::string& name);
+    void printSummary();
+
+    // Restricts the calling thread to the cores, false if the system refused (or no cores are given)
+    static bool pinCurrentThread(const std::vector<int>& cores);
+    // normal, high or realtime, false if the system refused (realtime needs privileges on Linux)
+    static bool setCurrentThreadPriority(const std::string& priority);
+
+private:
+    Scheduler() {}
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    std::mutex mtx;
+    std::map<std::string, QueueOptions> queue_options;
+    std::map<std::string, std::unique_ptr<ThreadPool>> queues;
+    bool dedicated_capture = false;
+};
@@ -11,12 +11,18 @@
 
 class ThreadPool {
 public:
-    ThreadPool(size_t numThreads);
+    // start runs first on each worker, with its index (core affinity, priority)
+    ThreadPool(size_t numThreads, std::function<void(size_t)> start = nullptr);
     ~ThreadPool();
 
     // Add a task to the queue
     void enqueueTask(std::function<void()> task);
 
+    // Wait until the queue is empty and no task is running, tasks added meanwhile included
+    void waitIdle();
+
+    size_t size() const { return workers.size(); }
+
 private:
     // Worker threads
     std::vector<std::thread> workers;
@@ -27,8 +33,10 @@ private:
     // Synchronization
     std::mutex queueMutex;
     std::condition_variable condition;
+    std::condition_variable idle;
     std::atomic<bool> stop;
+    size_t active = 0;
 
     // Worker function for threads
-    void workerThread();
+    void workerThread(size_t index, std::function<void(size_t)> start);
 };
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Splits the incoming serial byte stream into the JSON acknowledgements sent by the
+// turntable firmware. Anything outside of a {...} object is ignored.
+class JsonReplyParser {
+public:
+    // Feeds received bytes, returns true when a complete reply is available
+    bool feed(const char* data, size_t size);
+    // Takes the oldest complete reply (check with hasReply first)
+    nlohmann::json takeReply();
+    bool hasReply() const { return !replies.empty(); }
+
+private:
+    std::string current;
+    int depth = 0;
+    std::deque<nlohmann::json> replies;
+};
+
+// Asynchronous serial link to the turntable Arduino. A reader thread parses the JSON
+// acknowledgements and resolves the future of each command, so the next move can be
+// issued without blocking the caller. Queued commands are sent one at a time.
+class TurntableSerial {
+public:
+    TurntableSerial(const std::string& port, int baud_rate = 9600, int connect_delay_ms = 2000);
+    ~TurntableSerial();
+
+    // Builds the port path from the serial_com_port config value ("5" -> COM5, or a device path)
+    static std::string portName(const std::string& config_value);
+
+    bool connected() const { return is_connected; }
+
+    // Sends a move command, the future resolves with the firmware reply or throws on timeout
+    std::future<nlohmann::json> rotate(int degrees, int timeout_ms);
+    // Expected time for a move of the given size, based on the configured motor speed
+    static int moveTimeoutMs(int degrees);
+    size_t pending();
+
+private:
+    struct PendingCommand {
+        std::string command;
+        std::promise<nlohmann::json> reply;
+        std::chrono::milliseconds timeout;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    // A timed out command whose reply may still come, until forget_at
+    struct ExpiredCommand {
+        std::string command;
+        std::chrono::steady_clock::time_point forget_at;
+    };
+
+    bool openPort(const std::string& port, int baud_rate);
+    void closePort();
+    bool writePort(const std::string& data);
+    int readPort(char* buffer, int size);
+    void sendFront();
+    void readerThread();
+    void handleReply(const nlohmann::json& reply);
+    void expireCommands();
+    static std::string replyCommand(const nlohmann::json& reply);
+
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool is_connected = false;
+    std::atomic<bool> running{false};
+    std::thread reader;
+    std::mutex pending_mtx;
+    std::mutex write_mtx;
+    std::deque<PendingCommand> pending_commands;
+    // Timed out commands, their replies are discarded when they arrive late
+    std::deque<ExpiredCommand> expired_commands;
+    JsonReplyParser parser;
+};
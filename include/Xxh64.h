@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+// Streaming XXH64 (seed 0), the same digest as xxhsum -H1 and python xxhash.xxh64
+class Xxh64 {
+public:
+    void update(const unsigned char* data, size_t size) {
+        total += size;
+        // Complete a buffered stripe first
+        if (buffered > 0) {
+            size_t take = std::min(size, sizeof(buffer) - buffered);
+            std::memcpy(buffer + buffered, data, take);
+            buffered += take;
+            data += take;
+            size -= take;
+            if (buffered < sizeof(buffer)) return;
+            stripe(buffer);
+            buffered = 0;
+        }
+        while (size >= sizeof(buffer)) {
+            stripe(data);
+            data += sizeof(buffer);
+            size -= sizeof(buffer);
+        }
+        std::memcpy(buffer, data, size);
+        buffered = size;
+    }
+
+    uint64_t digest() const {
+        uint64_t hash;
+        if (total >= 32) {
+            hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+            for (uint64_t value : acc) {
+                hash = (hash ^ round(0, value)) * P1 + P4;
+            }
+        } else {
+            hash = P5;
+        }
+        hash += total;
+
+        const unsigned char* p = buffer;
+        size_t left = buffered;
+        for (; left >= 8; p += 8, left -= 8) {
+            hash ^= round(0, read64(p));
+            hash = rotl(hash, 27) * P1 + P4;
+        }
+        if (left >= 4) {
+            hash ^= static_cast<uint64_t>(read32(p)) * P1;
+            hash = rotl(hash, 23) * P2 + P3;
+            p += 4;
+            left -= 4;
+        }
+        for (; left > 0; p++, left--) {
+            hash ^= (*p) * P5;
+            hash = rotl(hash, 11) * P1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= P2;
+        hash ^= hash >> 29;
+        hash *= P3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    // Digest as 16 hex digits
+    std::string hex() const {
+        std::stringstream text;
+        text << std::hex << std::setfill('0') << std::setw(16) << digest();
+        return text.str();
+    }
+
+private:
+    static constexpr uint64_t P1 = 11400714785074694791ULL;
+    static constexpr uint64_t P2 = 14029467366897019727ULL;
+    static constexpr uint64_t P3 = 1609587929392839161ULL;
+    static constexpr uint64_t P4 = 9650029242287828579ULL;
+    static constexpr uint64_t P5 = 2870177450012600261ULL;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; }
+    // Little endian reads, as the reference implementation
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+        return value;
+    }
+    static uint32_t read32(const unsigned char* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    void stripe(const unsigned char* p) {
+        for (int i = 0; i < 4; i++) {
+            acc[i] = round(acc[i], read64(p + 8 * i));
+        }
+    }
+
+    uint64_t acc[4] = { P1 + P2, P2, 0, 0 - P1 };
+    unsigned char buffer[32];
+    size_t buffered = 0;
+    uint64_t total = 0;
+};
@@ -0,0 +1,38 @@
+#!/bin/bash
+# End-to-end scan benchmark: runs a full scan against the turntable simulator and prints
+# the per-angle capture/move/settle timings. RealSense data is replayed from the
+# <serial>.bag recordings in realsense.playback_dir of the benchmark config.
+#
+# Usage: scan_benchmark.sh <TurntableSim> <MultiCamCui> [config] [simulator options...]
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <TurntableSim> <MultiCamCui> [config] [simulator options...]"
+    exit 1
+fi
+
+SIM=$1
+CUI=$2
+CONFIG=${3:-moad_benchmark_config.json}
+shift 3 2>/dev/null || shift $#
+
+PORT_FILE=$(mktemp)
+rm -f "$PORT_FILE"
+
+"$SIM" --port-file "$PORT_FILE" "$@" > /dev/null &
+SIM_PID=$!
+trap 'kill $SIM_PID 2>/dev/null' EXIT
+
+# Wait for the simulator to create the pseudo-terminal
+for i in $(seq 1 50); do
+    [ -s "$PORT_FILE" ] && break
+    sleep 0.1
+done
+if [ ! -s "$PORT_FILE" ]; then
+    echo "Turntable simulator did not start"
+    exit 1
+fi
+PORT=$(cat "$PORT_FILE")
+rm -f "$PORT_FILE"
+echo "Turntable simulator on $PORT"
+
+"$CUI" --benchmark --serial "$PORT" --config "$CONFIG"
@@ -0,0 +1,228 @@
+// Align Clouds: Aligns the cloud of every pose of an object (pose-b, pose-c, ...) onto pose-a
+// with multi-scale colored ICP. Native version of scripts/align_clouds.py (stage 3), without the
+// file dialogs and the visualization, so whole objects can be processed in batch.
+//
+// Each pose cloud is the given --cloud file inside the pose folder, or all the realsense/*_cloud.ply
+// clouds of the pose merged. The pipeline follows the script: crop box around pose-a, statistical
+// outlier filter, initial rotation and bounding box alignment, then colored ICP over the voxel sizes.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <pcl/io/ply_io.h>
+#include <pcl/common/common.h>
+#include <pcl/common/transforms.h>
+#include <pcl/filters/crop_box.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+
+#include "CloudAligner.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+using std::cout;
+using std::endl;
+
+struct AlignOptions {
+    std::string object_dir;
+    std::string cloud;                                  // Cloud file inside each pose folder
+    std::vector<double> voxels = { 0.005, 0.002, 0.001 };
+    std::vector<double> iterations = { 500, 100, 100 };
+    bool crop = true;
+    std::vector<double> bounds = { 0.23, 0.36, -0.16, 0.4 };  // x, y, z_bot, height
+    std::vector<double> euler = { -90, 180, 0 };               // Initial rotation of the other poses
+    std::vector<double> filter = { 30, 1.5 };                  // Neighbors, std ratio
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string output;
+};
+
+void printUsage() {
+    cout << "Usage: AlignClouds <object_dir> [--cloud <file>] [--voxels a,b,c] [--iters a,b,c]\n"
+         << "                   [--crop x,y,z_bot,height | --no-crop] [--euler roll,pitch,yaw]\n"
+         << "                   [--filter neighbors,ratio] [--threads N] [--output <file.json>]\n";
+}
+
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stod(item));
+    }
+    return values;
+}
+
+bool parseArgs(int argc, char* argv[], AlignOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--cloud" && has_value) options.cloud = argv[++i];
+        else if (arg == "--voxels" && has_value) options.voxels = parseList(argv[++i]);
+        else if (arg == "--iters" && has_value) options.iterations = parseList(argv[++i]);
+        else if (arg == "--crop" && has_value) options.bounds = parseList(argv[++i]);
+        else if (arg == "--no-crop") options.crop = false;
+        else if (arg == "--euler" && has_value) options.euler = parseList(argv[++i]);
+        else if (arg == "--filter" && has_value) options.filter = parseList(argv[++i]);
+        else if (arg == "--threads" && has_value) options.threads = std::stoul(argv[++i]);
+        else if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg[0] != '-' && options.object_dir.empty()) options.object_dir = arg;
+        else return false;
+    }
+    return !options.object_dir.empty() && options.voxels.size() == options.iterations.size()
+        && options.bounds.size() == 4 && options.euler.size() == 3 && options.filter.size() == 2;
+}
+
+// Loads the pose cloud, merging the per-angle RealSense clouds if no file is given
+ColorCloud::Ptr loadPoseCloud(const fs::path& pose_dir, const AlignOptions& options, ThreadPool& pool) {
+    std::vector<fs::path> files;
+    if (!options.cloud.empty()) {
+        files.push_back(pose_dir / options.cloud);
+    } else if (fs::is_directory(pose_dir / "realsense")) {
+        for (const auto& entry : fs::directory_iterator(pose_dir / "realsense")) {
+            std::string name = entry.path().filename().string();
+            if (name.size() > 10 && name.substr(name.size() - 10) == "_cloud.ply") files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+    }
+
+    std::vector<std::future<ColorCloud::Ptr>> loaded;
+    for (const auto& file : files) {
+        auto job = std::make_shared<std::packaged_task<ColorCloud::Ptr()>>([file]() {
+            ColorCloud::Ptr cloud(new ColorCloud);
+            if (pcl::io::loadPLYFile<pcl::PointXYZRGB>(file.string(), *cloud) < 0) {
+                std::cerr << "Failed to load " << file.string() << endl;
+            }
+            return cloud;
+        });
+        loaded.push_back(job->get_future());
+        pool.enqueueTask([job]() { (*job)(); });
+    }
+
+    ColorCloud::Ptr merged(new ColorCloud);
+    for (auto& cloud : loaded) {
+        *merged += *cloud.get();
+    }
+    cout << pose_dir.filename().string() << ": " << merged->size() << " points from " << files.size() << " clouds" << endl;
+    return merged;
+}
+
+Eigen::Vector3d boundingBoxCenter(const ColorCloud::ConstPtr& cloud) {
+    pcl::PointXYZRGB min_point, max_point;
+    pcl::getMinMax3D(*cloud, min_point, max_point);
+    return ((min_point.getVector3fMap() + max_point.getVector3fMap()) / 2).cast<double>();
+}
+
+ColorCloud::Ptr cropCloud(const ColorCloud::ConstPtr& cloud, const Eigen::Vector3d& center, const std::vector<double>& bounds) {
+    ColorCloud::Ptr cropped(new ColorCloud);
+    pcl::CropBox<pcl::PointXYZRGB> crop_box;
+    crop_box.setInputCloud(cloud);
+    crop_box.setMin(Eigen::Vector4f(center.x() - bounds[0] / 2, center.y() - bounds[1] / 2, center.z() + bounds[2], 1));
+    crop_box.setMax(Eigen::Vector4f(center.x() + bounds[0] / 2, center.y() + bounds[1] / 2, center.z() + bounds[2] + bounds[3], 1));
+    crop_box.filter(*cropped);
+    return cropped;
+}
+
+ColorCloud::Ptr filterOutliers(const ColorCloud::ConstPtr& cloud, const std::vector<double>& filter) {
+    ColorCloud::Ptr filtered(new ColorCloud);
+    pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
+    sor.setInputCloud(cloud);
+    sor.setMeanK(static_cast<int>(filter[0]));
+    sor.setStddevMulThresh(filter[1]);
+    sor.filter(*filtered);
+    return filtered;
+}
+
+int main(int argc, char* argv[]) {
+    AlignOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    // Pose folders, pose-a is the reference
+    std::vector<fs::path> poses;
+    for (const auto& entry : fs::directory_iterator(options.object_dir)) {
+        if (entry.is_directory() && entry.path().filename().string().rfind("pose-", 0) == 0) {
+            poses.push_back(entry.path());
+        }
+    }
+    std::sort(poses.begin(), poses.end());
+    if (poses.size() < 2 || poses[0].filename() != "pose-a") {
+        std::cerr << "Expected pose-a and at least one other pose in " << options.object_dir << endl;
+        return 1;
+    }
+
+    std::vector<ICPScale> scales;
+    for (size_t i = 0; i < options.voxels.size(); i++) {
+        scales.push_back({ options.voxels[i], static_cast<int>(options.iterations[i]) });
+    }
+
+    auto total_start = std::chrono::high_resolution_clock::now();
+    ThreadPool load_pool(options.threads);
+    CloudAligner aligner(options.threads);
+
+    // Reference cloud (stage 1 and 2 of the script)
+    ColorCloud::Ptr target = loadPoseCloud(poses[0], options, load_pool);
+    Eigen::Vector3d crop_center = boundingBoxCenter(target);
+    if (options.crop) target = cropCloud(target, crop_center, options.bounds);
+    ColorCloud::Ptr target_filtered = filterOutliers(target, options.filter);
+    Eigen::Vector3d target_center = boundingBoxCenter(target_filtered);
+
+    nlohmann::json output;
+    for (size_t p = 1; p < poses.size(); p++) {
+        std::string pose = poses[p].filename().string();
+        cout << "\nAligning " << pose << " onto " << poses[0].filename().string() << endl;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        ColorCloud::Ptr source = loadPoseCloud(poses[p], options, load_pool);
+        if (source->empty()) {
+            std::cerr << "No points in " << pose << ", skipped" << endl;
+            continue;
+        }
+        Eigen::Vector3d source_center = boundingBoxCenter(source);
+        if (options.crop) source = cropCloud(source, crop_center, options.bounds);
+        ColorCloud::Ptr source_filtered = filterOutliers(source, options.filter);
+
+        // Initial rotation around the pose center, then match the bounding box centers
+        Eigen::Matrix4d rotation = Eigen::Matrix4d::Identity();
+        rotation.block<3, 3>(0, 0) = eulerToRotation(options.euler[0], options.euler[1], options.euler[2]);
+        rotation.block<3, 1>(0, 3) = source_center - rotation.block<3, 3>(0, 0) * source_center;
+        ColorCloud::Ptr rotated(new ColorCloud);
+        pcl::transformPointCloud(*source_filtered, *rotated, rotation.cast<float>().eval());
+        Eigen::Matrix4d init = rotation;
+        init.block<3, 1>(0, 3) += target_center - boundingBoxCenter(rotated);
+
+        RegistrationResult result = aligner.align(source_filtered, target_filtered, scales, init);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+
+        // The transformation includes the initial alignment, it maps the original pose cloud onto pose-a
+        cout << "Transformation:" << endl;
+        cout << formatTransform(result.transformation) << endl;
+        cout << pose << " aligned in " << duration.count() << " ms" << endl;
+
+        std::vector<std::vector<double>> matrix(4, std::vector<double>(4));
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) matrix[row][col] = result.transformation(row, col);
+        }
+        output[pose]["transformation"] = matrix;
+        output[pose]["fitness"] = result.fitness;
+        output[pose]["inlier_rmse"] = result.inlier_rmse;
+    }
+
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - total_start);
+    cout << "\nAligned " << poses.size() - 1 << " poses in " << total.count() << " ms" << endl;
+
+    if (!options.output.empty()) {
+        std::ofstream file(options.output);
+        file << output.dump(4);
+        cout << "Transforms saved to " << options.output << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+// Blur Report: Scores the sharpness of every DSLR image of an object and writes the blurred image
+// report of scripts/measure_blur.py (outlier_images.txt), without the plot.
+//
+// Every folder of the tree with camN_DDD_*.jpg images (object/DSLR, object/pose-a/DSLR, ...) gets
+// its report in its parent folder. The images are decoded at a reduced size (libjpeg DCT scaling)
+// and scored on all cores. Outliers are the images more than --std deviations from the mean of
+// their camera in the folder, as in detect_outliers.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+#include <memory>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+#include "ImageQuality.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+using std::cout;
+using std::endl;
+
+struct BlurOptions {
+    std::string root;
+    std::string metric = "directional";
+    int reduction = 2;                                  // measure_blur.py uses a 0.5 scale factor
+    double num_std_dev = 2;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string output_name = "outlier_images.txt";
+    std::string scores;                                 // Optional CSV with every score
+    bool verbose = false;
+};
+
+struct ScoredImage {
+    fs::path file;
+    std::string camera;
+    int index;
+    double score = 0;
+};
+
+// The images of a folder, grouped by camera in the order the sorted file names list them
+struct ImageFolder {
+    fs::path path;
+    std::vector<ScoredImage> images;
+};
+
+void printUsage() {
+    cout << "Usage: BlurReport <object_dir> [--metric directional|laplacian|frequency] [--reduction 1|2|4|8]\n"
+         << "                  [--std N] [--threads N] [--output-name outlier_images.txt] [--scores <file.csv>]\n"
+         << "                  [--verbose]\n";
+}
+
+bool parseArgs(int argc, char* argv[], BlurOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--metric" && has_value) options.metric = argv[++i];
+        else if (arg == "--reduction" && has_value) options.reduction = std::stoi(argv[++i]);
+        else if (arg == "--std" && has_value) options.num_std_dev = std::stod(argv[++i]);
+        else if (arg == "--threads" && has_value) options.threads = std::stoul(argv[++i]);
+        else if (arg == "--output-name" && has_value) options.output_name = argv[++i];
+        else if (arg == "--scores" && has_value) options.scores = argv[++i];
+        else if (arg == "--verbose") options.verbose = true;
+        else if (arg[0] != '-' && options.root.empty()) options.root = arg;
+        else return false;
+    }
+    bool known_metric = options.metric == "directional" || options.metric == "laplacian" || options.metric == "frequency";
+    return !options.root.empty() && known_metric;
+}
+
+// Finds the folders with camN_DDD_ images (same rule as extract_index_from_filename)
+std::vector<ImageFolder> findImages(const fs::path& root) {
+    std::regex pattern("cam\\d+_(\\d+)_");
+    std::map<fs::path, std::vector<fs::path>> files;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        std::string name = entry.path().filename().string();
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (entry.is_regular_file() && name.rfind("cam", 0) == 0 && (extension == ".jpg" || extension == ".jpeg")) {
+            files[entry.path().parent_path()].push_back(entry.path());
+        }
+    }
+
+    std::vector<ImageFolder> folders;
+    for (auto& folder : files) {
+        ImageFolder images;
+        images.path = folder.first;
+        std::sort(folder.second.begin(), folder.second.end());
+        for (const auto& file : folder.second) {
+            std::string name = file.filename().string();
+            std::smatch match;
+            if (!std::regex_search(name, match, pattern)) continue;
+            ScoredImage image;
+            image.file = file;
+            image.camera = name.substr(0, name.find('_'));
+            image.index = std::stoi(match[1].str());
+            images.images.push_back(image);
+        }
+        if (!images.images.empty()) folders.push_back(images);
+    }
+    return folders;
+}
+
+// Writes the report in the format of write_outliers_to_file
+void writeOutliers(const fs::path& path, const std::vector<std::pair<std::string, std::vector<int>>>& outliers,
+                   const std::string& metric, const std::string& object_name) {
+    size_t total = 0;
+    for (const auto& camera : outliers) total += camera.second.size();
+
+    std::ofstream file(path);
+    file << "AUTOMATIC BLURRED IMAGE DETECTION\n";
+    file << "Object: " << object_name << "\n";
+    file << "Metric used: " << metric << "\n";
+    file << "Total outliers: " << total << "\n\n";
+
+    file << "Outliers per camera:\n";
+    for (const auto& camera : outliers) {
+        file << camera.first << ": " << camera.second.size() << "\n";
+    }
+    file << "\n";
+
+    file << "Outlier positions:\n";
+    for (const auto& camera : outliers) {
+        file << camera.first << ": [";
+        for (size_t i = 0; i < camera.second.size(); i++) {
+            file << (i > 0 ? ", " : "") << camera.second[i];
+        }
+        file << "]\n";
+    }
+}
+
+// Outliers of every camera of a folder, sorted by index (detect_outliers)
+std::vector<std::pair<std::string, std::vector<int>>> detectOutliers(const ImageFolder& folder, double num_std_dev) {
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<const ScoredImage*>> cameras;
+    for (const auto& image : folder.images) {
+        if (cameras.find(image.camera) == cameras.end()) order.push_back(image.camera);
+        cameras[image.camera].push_back(&image);
+    }
+
+    std::vector<std::pair<std::string, std::vector<int>>> outliers;
+    for (const auto& camera : order) {
+        std::vector<const ScoredImage*>& images = cameras[camera];
+        std::sort(images.begin(), images.end(), [](const ScoredImage* a, const ScoredImage* b) {
+            return a->index < b->index || (a->index == b->index && a->score < b->score);
+        });
+        double mean = 0, variance = 0;
+        for (const auto* image : images) mean += image->score;
+        mean /= images.size();
+        for (const auto* image : images) variance += (image->score - mean) * (image->score - mean);
+        double deviation = std::sqrt(variance / images.size());
+
+        std::vector<int> positions;
+        for (const auto* image : images) {
+            if (image->score < mean - num_std_dev * deviation || image->score > mean + num_std_dev * deviation) {
+                positions.push_back(image->index);
+            }
+        }
+        outliers.emplace_back(camera, positions);
+    }
+    return outliers;
+}
+
+int main(int argc, char* argv[]) {
+    BlurOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    fs::path root = fs::absolute(options.root);
+    if (!fs::is_directory(root)) {
+        std::cerr << "Folder not found: " << options.root << endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<ImageFolder> folders = findImages(root);
+    if (folders.empty()) {
+        std::cerr << "No camN_DDD_*.jpg images in " << options.root << endl;
+        return 1;
+    }
+
+    // Score every image on the pool
+    std::vector<std::future<void>> scored;
+    size_t total = 0;
+    {
+        ThreadPool pool(options.threads);
+        bool frequency = options.metric == "frequency";
+        for (auto& folder : folders) {
+            for (auto& image : folder.images) {
+                ScoredImage* target = &image;
+                auto job = std::make_shared<std::packaged_task<void()>>([target, &options, frequency]() {
+                    ImageScore score = scoreImage(target->file.string(), options.reduction, frequency);
+                    if (score.width == 0) {
+                        throw std::runtime_error("Cannot read image at " + target->file.string());
+                    }
+                    target->score = metricValue(score, options.metric);
+                });
+                scored.push_back(job->get_future());
+                pool.enqueueTask([job]() { (*job)(); });
+                total++;
+            }
+        }
+        for (auto& result : scored) {
+            result.get();
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    cout << "Scored " << total << " images in " << seconds << " s (" << total / seconds << " images/s)" << endl;
+
+    std::ofstream scores;
+    if (!options.scores.empty()) {
+        scores.open(options.scores);
+        scores << "folder,camera,index,file," << options.metric << "\n";
+    }
+
+    // One report per folder, next to it
+    std::string object_name = root.filename().string();
+    for (const auto& folder : folders) {
+        if (options.verbose) {
+            for (const auto& image : folder.images) {
+                cout << image.camera << " - " << image.index << " - " << image.score << endl;
+            }
+        }
+        if (scores.is_open()) {
+            std::string name = folder.path.lexically_relative(root).generic_string();
+            for (const auto& image : folder.images) {
+                scores << name << "," << image.camera << "," << image.index << ","
+                       << image.file.filename().string() << "," << image.score << "\n";
+            }
+        }
+
+        auto outliers = detectOutliers(folder, options.num_std_dev);
+        fs::path output = folder.path.parent_path() / options.output_name;
+        writeOutliers(output, outliers, options.metric, object_name);
+
+        size_t count = 0;
+        for (const auto& camera : outliers) count += camera.second.size();
+        cout << folder.path.lexically_relative(root).generic_string() << ": " << folder.images.size() << " images, "
+             << count << " outliers -> " << output.string() << endl;
+    }
+    return 0;
+}
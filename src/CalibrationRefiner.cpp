@@ -0,0 +1,302 @@
+#include <iostream>
+#include <future>
+#include <regex>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <pcl/io/ply_io.h>
+#include <pcl/common/transforms.h>
+
+#include "CalibrationRefiner.h"
+#include "CloudAligner.h"
+
+namespace fs = std::filesystem;
+
+CalibrationRefiner::CalibrationRefiner(size_t num_threads) : num_threads(std::max<size_t>(1, num_threads)), pool(this->num_threads) {
+}
+
+// Splits [0, count) into one chunk per thread and waits for all of them
+void CalibrationRefiner::parallelFor(size_t count, const std::function<void(size_t, size_t, size_t)>& task) {
+    size_t chunks = std::min(num_threads, std::max<size_t>(1, count));
+    size_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<std::future<void>> done;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        size_t begin = chunk * chunk_size;
+        size_t end = std::min(count, begin + chunk_size);
+        auto job = std::make_shared<std::packaged_task<void()>>([&task, begin, end, chunk]() {
+            task(begin, end, chunk);
+        });
+        done.push_back(job->get_future());
+        pool.enqueueTask([job]() { (*job)(); });
+    }
+    for (auto& future : done) {
+        future.get();
+    }
+}
+
+Eigen::Matrix4d turntableRotation(double angle_degrees) {
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    transformation.block<3, 3>(0, 0) = Eigen::AngleAxisd(-angle_degrees * EIGEN_PI / 180.0, Eigen::Vector3d::UnitZ()).matrix();
+    return transformation;
+}
+
+void CalibrationRefiner::addCamera(const std::string& name, const Eigen::Matrix4d& transform) {
+    names.push_back(name);
+    transforms.push_back(transform);
+}
+
+size_t CalibrationRefiner::loadPose(const std::string& realsense_dir, double voxel_size, bool raw) {
+    const std::regex pattern("(.+)_(\\d+)_cloud\\.ply");
+    views.clear();
+    pairs.clear();
+    for (const auto& entry : fs::directory_iterator(realsense_dir)) {
+        std::smatch match;
+        std::string filename = entry.path().filename().string();
+        if (!std::regex_match(filename, match, pattern)) continue;
+        auto camera = std::find(names.begin(), names.end(), match[1].str());
+        if (camera == names.end()) {
+            std::cerr << "No transform for " << filename << ", skipped" << std::endl;
+            continue;
+        }
+        CameraView view;
+        view.file = entry.path().string();
+        view.camera = static_cast<int>(camera - names.begin());
+        view.angle = std::stoi(match[2].str());
+        view.turntable = turntableRotation(view.angle);
+        views.push_back(view);
+    }
+    std::sort(views.begin(), views.end(), [](const CameraView& a, const CameraView& b) {
+        return a.angle != b.angle ? a.angle < b.angle : a.camera < b.camera;
+    });
+
+    // Load, move back to the camera frame, downsample and estimate normals, in parallel over the files
+    parallelFor(views.size(), [&](size_t begin, size_t end, size_t) {
+        std::vector<int> indices;
+        std::vector<float> distances;
+        for (size_t v = begin; v < end; v++) {
+            CameraView& view = views[v];
+            ColorCloud::Ptr cloud(new ColorCloud);
+            if (pcl::io::loadPLYFile<pcl::PointXYZRGB>(view.file, *cloud) < 0) {
+                std::cerr << "Failed to load " << view.file << std::endl;
+                continue;
+            }
+            if (!raw) {
+                Eigen::Matrix4d to_camera = (view.turntable * transforms[view.camera]).inverse();
+                pcl::transformPointCloud(*cloud, *cloud, to_camera.cast<float>().eval());
+            }
+            ColorCloud::Ptr downsampled = voxelDownsample(cloud, voxel_size);
+
+            view.cloud.reset(new pcl::PointCloud<pcl::PointXYZ>);
+            view.cloud->reserve(downsampled->size());
+            for (const auto& point : downsampled->points) {
+                view.cloud->push_back(pcl::PointXYZ(point.x, point.y, point.z));
+                view.points.push_back(point.getVector3fMap().cast<double>());
+            }
+            if (view.points.size() < static_cast<size_t>(normal_neighbors)) continue;
+            view.tree = std::make_shared<pcl::KdTreeFLANN<pcl::PointXYZ>>();
+            view.tree->setInputCloud(view.cloud);
+
+            view.normals.resize(view.points.size());
+            for (size_t i = 0; i < view.points.size(); i++) {
+                int found = view.tree->nearestKSearch(view.cloud->points[i], normal_neighbors, indices, distances);
+                view.normals[i] = estimateNormal(view.points, indices, found);
+            }
+        }
+    });
+
+    // Views too small for normals are dropped
+    views.erase(std::remove_if(views.begin(), views.end(), [](const CameraView& view) { return !view.tree; }), views.end());
+    return views.size();
+}
+
+// Fraction of the sampled points of a with a neighbor in b within max_distance
+double CalibrationRefiner::pairOverlap(const ViewPair& pair, double max_distance) const {
+    const CameraView& a = views[pair.a];
+    const CameraView& b = views[pair.b];
+    Eigen::Matrix4d a_to_b = (b.turntable * transforms[b.camera]).inverse() * a.turntable * transforms[a.camera];
+    size_t step = std::max<size_t>(1, a.points.size() / 300);
+    size_t sampled = 0;
+    size_t matched = 0;
+    std::vector<int> index(1);
+    std::vector<float> distance(1);
+    for (size_t i = 0; i < a.points.size(); i += step) {
+        Eigen::Vector3d q = a_to_b.block<3, 3>(0, 0) * a.points[i] + a_to_b.block<3, 1>(0, 3);
+        sampled++;
+        pcl::PointXYZ query(static_cast<float>(q.x()), static_cast<float>(q.y()), static_cast<float>(q.z()));
+        if (b.tree->nearestKSearch(query, 1, index, distance) > 0 && distance[0] <= max_distance * max_distance) matched++;
+    }
+    return sampled > 0 ? static_cast<double>(matched) / sampled : 0;
+}
+
+size_t CalibrationRefiner::findPairs(double max_distance, double min_overlap) {
+    // Candidates: every camera pair at the same angle and every view pair with the next angle
+    std::map<int, std::vector<size_t>> by_angle;
+    for (size_t v = 0; v < views.size(); v++) {
+        by_angle[views[v].angle].push_back(v);
+    }
+    std::vector<std::vector<size_t>> angles;
+    for (const auto& angle : by_angle) angles.push_back(angle.second);
+
+    std::vector<ViewPair> candidates;
+    for (size_t i = 0; i < angles.size(); i++) {
+        const auto& current = angles[i];
+        for (size_t a = 0; a < current.size(); a++) {
+            for (size_t b = a + 1; b < current.size(); b++) candidates.push_back({ current[a], current[b], 0 });
+        }
+        // The last angle wraps around to the first, unless there are only two angles
+        if (angles.size() < 2 || (angles.size() == 2 && i == 1)) continue;
+        const auto& next = angles[(i + 1) % angles.size()];
+        for (size_t a : current) {
+            for (size_t b : next) candidates.push_back({ a, b, 0 });
+        }
+    }
+
+    parallelFor(candidates.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t c = begin; c < end; c++) {
+            candidates[c].overlap = pairOverlap(candidates[c], max_distance);
+        }
+    });
+    pairs.clear();
+    for (const auto& pair : candidates) {
+        if (pair.overlap >= min_overlap) pairs.push_back(pair);
+    }
+    if (verbose) {
+        std::cout << pairs.size() << " of " << candidates.size() << " view pairs overlap" << std::endl;
+    }
+    return pairs.size();
+}
+
+RefinementStats CalibrationRefiner::refine(int iterations, double start_distance, double end_distance, const std::string& reference) {
+    const size_t dims = 6 * names.size();
+    size_t fixed = std::find(names.begin(), names.end(), reference) - names.begin();
+    if (fixed == names.size()) fixed = 0;
+
+    struct Accumulator {
+        Eigen::MatrixXd JTJ;
+        Eigen::VectorXd JTr;
+        double squared_error;
+        size_t correspondences;
+    };
+    std::vector<Accumulator> partial(num_threads);
+
+    // Point to plane system over all pairs. Camera c is updated in the rig frame (before the
+    // turntable rotation), x_c' = x_c + w_c x x_c + t_c, with x_c = transform_c * p
+    auto accumulate = [&](double max_distance) {
+        double huber = max_distance / 3;
+        for (auto& accumulator : partial) {
+            accumulator.JTJ.setZero(dims, dims);
+            accumulator.JTr.setZero(dims);
+            accumulator.squared_error = 0;
+            accumulator.correspondences = 0;
+        }
+        parallelFor(pairs.size(), [&](size_t begin, size_t end, size_t chunk) {
+            Accumulator& accumulator = partial[chunk];
+            std::vector<int> index(1);
+            std::vector<float> distance(1);
+            Eigen::Matrix<double, 12, 1> J;
+            size_t offsets[12];
+            for (size_t p = begin; p < end; p++) {
+                const CameraView& a = views[pairs[p].a];
+                const CameraView& b = views[pairs[p].b];
+                const Eigen::Matrix4d& transform_a = transforms[a.camera];
+                const Eigen::Matrix4d& transform_b = transforms[b.camera];
+                Eigen::Matrix4d a_to_b = (b.turntable * transform_b).inverse() * a.turntable * transform_a;
+                Eigen::Matrix3d rotation_b = transform_b.block<3, 3>(0, 0);
+                Eigen::Matrix3d turntable_a = a.turntable.block<3, 3>(0, 0);
+                Eigen::Matrix3d turntable_b = b.turntable.block<3, 3>(0, 0);
+                for (int k = 0; k < 6; k++) {
+                    offsets[k] = 6 * a.camera + k;
+                    offsets[k + 6] = 6 * b.camera + k;
+                }
+
+                size_t step = std::max<size_t>(1, a.points.size() / max_points_per_pair);
+                for (size_t i = 0; i < a.points.size(); i += step) {
+                    Eigen::Vector3d q = a_to_b.block<3, 3>(0, 0) * a.points[i] + a_to_b.block<3, 1>(0, 3);
+                    pcl::PointXYZ query(static_cast<float>(q.x()), static_cast<float>(q.y()), static_cast<float>(q.z()));
+                    if (b.tree->nearestKSearch(query, 1, index, distance) < 1) continue;
+                    if (distance[0] > max_distance * max_distance) continue;
+                    int j = index[0];
+                    double r = b.normals[j].dot(q - b.points[j]);
+
+                    Eigen::Vector3d x_a = transform_a.block<3, 3>(0, 0) * a.points[i] + transform_a.block<3, 1>(0, 3);
+                    Eigen::Vector3d x_b = rotation_b * b.points[j] + transform_b.block<3, 1>(0, 3);
+                    Eigen::Vector3d m_b = rotation_b * b.normals[j];
+                    Eigen::Vector3d m_a = turntable_a.transpose() * (turntable_b * m_b);
+                    J.segment<3>(0) = x_a.cross(m_a);
+                    J.segment<3>(3) = m_a;
+                    J.segment<3>(6) = -x_b.cross(m_b);
+                    J.segment<3>(9) = -m_b;
+
+                    // Huber weight against outliers and wrong matches
+                    double weight = std::abs(r) <= huber ? 1.0 : huber / std::abs(r);
+                    for (int row = 0; row < 12; row++) {
+                        accumulator.JTr(offsets[row]) += weight * J(row) * r;
+                        for (int col = 0; col < 12; col++) {
+                            accumulator.JTJ(offsets[row], offsets[col]) += weight * J(row) * J(col);
+                        }
+                    }
+                    accumulator.squared_error += r * r;
+                    accumulator.correspondences++;
+                }
+            }
+        });
+
+        Accumulator total{ Eigen::MatrixXd::Zero(dims, dims), Eigen::VectorXd::Zero(dims), 0, 0 };
+        for (const auto& accumulator : partial) {
+            total.JTJ += accumulator.JTJ;
+            total.JTr += accumulator.JTr;
+            total.squared_error += accumulator.squared_error;
+            total.correspondences += accumulator.correspondences;
+        }
+        return total;
+    };
+    auto rmse = [](const Accumulator& accumulator) {
+        return accumulator.correspondences > 0 ? std::sqrt(accumulator.squared_error / accumulator.correspondences) : 0.0;
+    };
+
+    RefinementStats stats;
+    stats.initial_rmse = rmse(accumulate(end_distance));
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        // The distance shrinks over the first half of the iterations, the rest refine at the final one
+        int shrink = iterations / 2;
+        bool final_distance = iteration >= shrink;
+        double max_distance = final_distance ? end_distance
+            : start_distance + (end_distance - start_distance) * iteration / shrink;
+        Accumulator system = accumulate(max_distance);
+        stats.iterations = iteration + 1;
+        if (system.correspondences < dims) break;
+
+        // All cameras could rotate about and shift along the turntable axis together without changing
+        // the residuals, the reference camera keeps both. Light damping for cameras without pairs
+        for (size_t k : { 2, 5 }) {
+            size_t d = 6 * fixed + k;
+            system.JTJ.row(d).setZero();
+            system.JTJ.col(d).setZero();
+            system.JTJ(d, d) = 1;
+            system.JTr(d) = 0;
+        }
+        double damping = 1e-9 * std::max(1.0, system.JTJ.diagonal().maxCoeff());
+        system.JTJ.diagonal().array() += damping;
+        Eigen::VectorXd x = system.JTJ.ldlt().solve(-system.JTr);
+        if (!x.allFinite()) break;
+
+        double largest_step = 0;
+        for (size_t c = 0; c < names.size(); c++) {
+            Eigen::Matrix<double, 6, 1> step = x.segment<6>(6 * c);
+            transforms[c] = vectorToTransform(step) * transforms[c];
+            largest_step = std::max(largest_step, step.cwiseAbs().maxCoeff());
+        }
+        if (verbose) {
+            std::cout << "[" << iteration << "] distance " << max_distance << ", rmse " << rmse(system)
+                << ", correspondences " << system.correspondences << std::endl;
+        }
+        // Converged once the distance reached its final value and the cameras stopped moving
+        if (final_distance && largest_step < 1e-6) break;
+    }
+
+    Accumulator final_system = accumulate(end_distance);
+    stats.final_rmse = rmse(final_system);
+    stats.correspondences = final_system.correspondences;
+    return stats;
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include "EDSDK.h"
 #include "EDSDKTypes.h"
+#include "CanonHandler.h"
 
 EdsError downloadImage(EdsDirectoryItemRef  directoryItem, EdsVoid* context);
 
@@ -24,6 +25,12 @@ EdsError EDSCALLBACK handleObjectEvent(EdsObjectEvent event, EdsBaseRef  object,
 		// 	std::cout << "Failed to retrieve camera serial number\n";
 		// }
 		
+		// The image is captured, keep the item to download it later if requested
+		if (canonhandle.defer_downloads) {
+			EdsRetain(object);
+			canonhandle.pending_transfers.push_back(std::make_pair(object, context));
+			break;
+		}
 		err = downloadImage(object, context);
 		break;
 	default:       break;
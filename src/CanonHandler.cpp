@@ -1,4 +1,8 @@
 #include <CanonHandler.h>
+#include "Download.h"
+#include "ConfigHandler.h"
+#include "PreSetting.h"
+#include "DeviceStartup.h"
 
 CanonHandler::CanonHandler() {
     std::cout << "Canon Handle created.\n";
@@ -30,6 +34,8 @@ CanonHandler::~CanonHandler() {
 int CanonHandler::camera_check() {
     cameraArray.clear();
     bodyID.clear();
+    camera_ids.clear();
+    session_open.clear();
 
     //Acquisition of camera list
     if (err == EDS_ERR_OK)
@@ -95,6 +101,8 @@ int CanonHandler::camera_check() {
             err = EdsGetChildAtIndex(cameraList, i, &camera);
             cameraArray.push_back(camera);
             bodyID.push_back(i + 1);
+            camera_ids.push_back(-1);
+            session_open.push_back(false);
         }
     }
 
@@ -113,6 +121,155 @@ void CanonHandler::initialize() {
     cameras_found = camera_check();
 }
 
+// Opens the sessions of all the cameras at once, each with its own timeout and retries. Returns the
+// number of cameras ready.
+int CanonHandler::open_sessions() {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    int timeout_ms = config.getValue<int>("startup.timeout_sec") * 1000;
+    int retries = config.getValue<int>("startup.retries");
+    std::cout << "Opening " << cameraArray.size() << " camera sessions..." << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<bool>> sessions;
+    for (size_t index = 0; index < cameraArray.size(); index++) {
+        EdsCameraRef session_camera = cameraArray[index];
+        EdsUInt64 body_id = bodyID[index];
+        sessions.push_back(std::async(std::launch::async, [session_camera, body_id, index, timeout_ms, retries]() {
+            StartupResult result;
+            result.kind = "Canon";
+            result.device = "Camera " + std::to_string(index + 1);
+            result.step = "session";
+            std::function<EdsError()> attempt = [session_camera, body_id]() {
+                EdsError session_err = PreSettingCamera(session_camera, body_id);
+                if (session_err != EDS_ERR_OK) {
+                    EdsCloseSession(session_camera);
+                    throw std::runtime_error("EDSDK error " + std::to_string(session_err));
+                }
+                return session_err;
+            };
+            // A session that opens after the camera was given up is closed again, without its handlers
+            std::function<void(EdsError&)> abandon = [session_camera](EdsError&) {
+                EdsSetPropertyEventHandler(session_camera, kEdsPropertyEvent_All, NULL, NULL);
+                EdsSetObjectEventHandler(session_camera, kEdsObjectEvent_All, NULL, NULL);
+                EdsSetCameraStateEventHandler(session_camera, kEdsStateEvent_All, NULL, NULL);
+                EdsCloseSession(session_camera);
+            };
+            EdsError session_err = EDS_ERR_OK;
+            if (!runStartupStep(attempt, timeout_ms, retries, result, session_err, abandon)) {
+                std::cout << "WARNING: " << result.device << " session failed: " << result.error << std::endl;
+                return false;
+            }
+            return true;
+        }));
+    }
+    int opened = 0;
+    for (size_t index = 0; index < sessions.size(); index++) {
+        session_open[index] = sessions[index].get();
+        if (session_open[index]) opened++;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << opened << "/" << cameraArray.size() << " camera sessions opened in " << ms << " ms" << std::endl;
+    return opened;
+}
+
+// Registers the camera at index (its body id is index + 1) in the device registry. The name is
+// the number used in the image file names (cam<name>_DDD_img.jpg).
+int CanonHandler::register_camera(size_t index, const std::string& serial, const std::string& name) {
+    int id = DeviceRegistry::getInstance().add(DeviceKind::Canon, serial, name, "Camera " + name);
+    if (index < camera_ids.size()) {
+        camera_ids[index] = id;
+        DeviceRegistry::getInstance().setState(id, session_open[index] ? DeviceState::Ready : DeviceState::Failed);
+    }
+    return id;
+}
+
+// Name of the camera at index, the body id if it was not registered
+std::string CanonHandler::camera_name(size_t index) const {
+    if (index < camera_ids.size() && camera_ids[index] >= 0) {
+        return DeviceRegistry::getInstance().info(camera_ids[index]).name;
+    }
+    return std::to_string(index + 1);
+}
+
+// Name of a camera shown in the menus
+std::string CanonHandler::camera_label(EdsCameraRef camera) const {
+    for (size_t index = 0; index < cameraArray.size(); index++) {
+        if (cameraArray[index] != camera) continue;
+        if (camera_ids[index] >= 0) return DeviceRegistry::getInstance().info(camera_ids[index]).label;
+        return "Camera " + camera_name(index);
+    }
+    return "Camera ?";
+}
+
+// Downloads the images whose transfer was deferred, returns the number downloaded
+int CanonHandler::download_pending() {
+    int downloaded = 0;
+    for (auto& transfer : pending_transfers) {
+        err = downloadImage(transfer.first, transfer.second);
+        if (err != EDS_ERR_OK) {
+            std::cout << "WARNING: Deferred download failed, error code " << err << std::endl;
+        } else {
+            downloaded++;
+        }
+        EdsRelease(transfer.first);
+    }
+    pending_transfers.clear();
+    return downloaded;
+}
+
+// Scores a downloaded image and adds it to the scan manifest. Images more than num_std_dev under
+// the mean of their camera are queued to be shot again.
+void CanonHandler::score_image(ManifestRecord record, size_t index) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    std::string metric = config.getValue<std::string>("dslr.quality.metric");
+    ImageScore score = scoreImage(record.file, config.getValue<int>("dslr.quality.reduction"), metric == "frequency");
+    if (score.width == 0) {
+        std::cout << "WARNING: Could not decode " << record.file << " for scoring" << std::endl;
+        ScanManifest::getInstance().record(record);
+        return;
+    }
+    double value = metricValue(score, metric);
+    double z = quality.add(record.camera, value, config.getValue<int>("dslr.quality.min_samples"));
+    bool blurry = z < -config.getValue<double>("dslr.quality.num_std_dev");
+    if (blurry) {
+        std::cout << "WARNING: " << record.camera << " at angle " << record.angle << " looks blurry ("
+            << metric << " " << value << ", z " << z << ")" << std::endl;
+        std::lock_guard<std::mutex> lock(reshoot_mtx);
+        reshoot.push_back(index);
+    }
+    if (score.clipped > config.getValue<double>("dslr.quality.max_clipped")) {
+        std::cout << "WARNING: " << record.camera << " at angle " << record.angle << " has "
+            << score.clipped * 100 << "% clipped pixels (mean level " << score.brightness << ")" << std::endl;
+    }
+
+    record.timings["quality_ms"] = score.decode_ms + score.score_ms;
+    nlohmann::json& details = record.details["quality"];
+    details["metric"] = metric;
+    details["value"] = value;
+    details["z"] = z;
+    details["blurry"] = blurry;
+    details["laplacian"] = score.laplacian;
+    details["gradient"] = score.gradient;
+    details["directionality"] = score.directionality;
+    if (metric == "frequency") details["frequency"] = score.frequency;
+    details["brightness"] = score.brightness;
+    details["clipped"] = score.clipped;
+    ScanManifest::getInstance().record(record);
+}
+
+void CanonHandler::wait_quality() {
+    for (auto& task : quality_tasks) {
+        task.get();
+    }
+    quality_tasks.clear();
+}
+
+std::vector<size_t> CanonHandler::take_reshoots() {
+    std::lock_guard<std::mutex> lock(reshoot_mtx);
+    std::vector<size_t> indices;
+    indices.swap(reshoot);
+    return indices;
+}
 
 // Create global CanonHandler object that CanonSDK functions can reference
 CanonHandler canonhandle;
\ No newline at end of file
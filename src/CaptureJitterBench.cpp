@@ -0,0 +1,210 @@
+// Capture Jitter Bench: Measures how late the capture threads of the scanner wake up for their
+// frames while the cpu queue computes normals on every core, once with the capture threads sharing
+// the cores (as before) and once with the dedicated capture cores and priority of the scheduler
+// (scheduler.capture.dedicated and priority in the config, see Scheduler.h).
+//
+// Each simulated device wakes up at its frame rate and copies a depth frame, as a RealSense frame
+// thread does. The lateness of the wake ups is the frame latency the filters add; a frame more
+// than half a period late is counted as late (a dropped frame or a wait_for_frames timeout on a
+// loaded machine). Real time priority needs root or an rtprio limit on Linux.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+
+#include "NormalEstimator.h"
+#include "Scheduler.h"
+
+using std::cout;
+using std::endl;
+
+struct BenchOptions {
+    int devices = 3;
+    int fps = 30;
+    int seconds = 10;
+    std::vector<int> capture_cores;     // Default: the last cores, one per device
+    std::string priority = "high";
+    size_t load_points = 100000;
+    int k = 16;
+};
+
+struct PhaseResult {
+    std::string phase;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+    double jitter_ms = 0;
+    size_t frames = 0;
+    size_t late = 0;
+    size_t clouds = 0;                  // Normal clouds computed by the load meanwhile
+};
+
+void printUsage() {
+    cout << "Usage: CaptureJitterBench [--devices N] [--fps N] [--seconds N] [--capture-cores 6,7] [--priority normal|high|realtime]\n"
+         << "                          [--load-points N] [--k N]\n";
+}
+
+std::vector<int> parseCores(const std::string& text) {
+    std::vector<int> cores;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) cores.push_back(std::stoi(item));
+    }
+    return cores;
+}
+
+bool parseArgs(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--devices" && has_value) options.devices = std::stoi(argv[++i]);
+        else if (arg == "--fps" && has_value) options.fps = std::stoi(argv[++i]);
+        else if (arg == "--seconds" && has_value) options.seconds = std::stoi(argv[++i]);
+        else if (arg == "--capture-cores" && has_value) options.capture_cores = parseCores(argv[++i]);
+        else if (arg == "--priority" && has_value) options.priority = argv[++i];
+        else if (arg == "--load-points" && has_value) options.load_points = std::stoul(argv[++i]);
+        else if (arg == "--k" && has_value) options.k = std::stoi(argv[++i]);
+        else return false;
+    }
+    return options.devices >= 1 && options.fps >= 1 && options.seconds >= 1 && options.k >= 3;
+}
+
+// Noisy plane of the size of a filtered camera cloud
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr synthesizeCloud(size_t count) {
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.001f);
+    for (size_t i = 0; i < count; i++) {
+        pcl::PointXYZRGB point;
+        point.x = unit(random) * 0.2f;
+        point.y = unit(random) * 0.2f;
+        point.z = 0.5f + noise(random);
+        point.r = point.g = point.b = 128;
+        cloud->push_back(point);
+    }
+    return cloud;
+}
+
+PhaseResult runPhase(const std::string& phase, const BenchOptions& options, bool dedicated,
+                     const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr& cloud) {
+    std::map<std::string, QueueOptions> queues;
+    queues["capture"].threads = static_cast<size_t>(options.devices);
+    queues["cpu"].threads = 0;
+    queues["io"].threads = 1;
+    queues["background"].threads = 1;
+    if (dedicated) {
+        queues["capture"].cores = options.capture_cores;
+        queues["capture"].priority = options.priority;
+    }
+    Scheduler& scheduler = Scheduler::getInstance();
+    scheduler.configure(queues, dedicated);
+
+    // Normals on every thread of the cpu queue until the capture is done
+    std::atomic<bool> loaded{ true };
+    std::atomic<size_t> clouds{ 0 };
+    ThreadPool& cpu = scheduler.queue("cpu");
+    for (size_t i = 0; i < cpu.size(); i++) {
+        cpu.enqueueTask([&loaded, &clouds, &options, cloud]() {
+            NormalEstimator estimator;
+            estimator.k = options.k;
+            pcl::search::KdTree<pcl::PointXYZRGB> tree;
+            pcl::PointCloud<pcl::Normal> normals;
+            while (loaded) {
+                estimator.compute(cloud, tree, Eigen::Vector3f::Zero(), normals);
+                clouds++;
+            }
+        });
+    }
+
+    // One capture thread per device, the devices are spread over the frame period
+    auto period = std::chrono::microseconds(1000000 / options.fps);
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    auto end = start + std::chrono::seconds(options.seconds);
+    std::vector<std::vector<double>> lateness(options.devices);
+    std::vector<std::thread> captures;
+    for (int device = 0; device < options.devices; device++) {
+        captures.emplace_back([&, device]() {
+            scheduler.enterCaptureThread(static_cast<size_t>(device));
+            std::vector<uint16_t> frame(640 * 480), copy(640 * 480);
+            auto next = start + period * device / options.devices;
+            while (next < end) {
+                std::this_thread::sleep_until(next);
+                auto woke = std::chrono::steady_clock::now();
+                std::memcpy(copy.data(), frame.data(), frame.size() * sizeof(uint16_t));
+                lateness[device].push_back(std::chrono::duration<double, std::milli>(woke - next).count());
+                next += period;
+            }
+        });
+    }
+    for (auto& capture : captures) capture.join();
+    loaded = false;
+    scheduler.waitIdle("cpu");
+
+    PhaseResult result;
+    result.phase = phase;
+    result.clouds = clouds;
+    std::vector<double> all;
+    for (const auto& device : lateness) all.insert(all.end(), device.begin(), device.end());
+    if (all.empty()) return result;
+    std::sort(all.begin(), all.end());
+    double period_ms = 1000.0 / options.fps;
+    double sum = 0, squares = 0;
+    for (double value : all) {
+        sum += value;
+        squares += value * value;
+        if (value > period_ms / 2) result.late++;
+    }
+    double mean = sum / all.size();
+    double variance = squares / all.size() - mean * mean;
+    result.frames = all.size();
+    result.p50_ms = all[all.size() / 2];
+    result.p99_ms = all[all.size() * 99 / 100];
+    result.max_ms = all.back();
+    result.jitter_ms = variance > 0 ? std::sqrt(variance) : 0;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    int hardware = static_cast<int>(std::thread::hardware_concurrency());
+    if (options.capture_cores.empty()) {
+        for (int core = hardware - options.devices; core < hardware; core++) {
+            if (core > 0) options.capture_cores.push_back(core);
+        }
+    }
+    cout << hardware << " cores, " << options.devices << " devices at " << options.fps << " fps for " << options.seconds
+         << " s, normals of " << options.load_points << " points (k " << options.k << ") on the cpu queue" << endl;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = synthesizeCloud(options.load_points);
+    std::vector<PhaseResult> results = { runPhase("shared", options, false, cloud), runPhase("dedicated", options, true, cloud) };
+
+    cout << std::fixed << std::setprecision(3);
+    cout << std::left << std::setw(12) << "capture" << std::right << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+         << std::setw(10) << "max ms" << std::setw(12) << "jitter ms" << std::setw(10) << "frames" << std::setw(8) << "late"
+         << std::setw(10) << "clouds" << "\n";
+    for (const auto& result : results) {
+        cout << std::left << std::setw(12) << result.phase << std::right << std::setw(10) << result.p50_ms << std::setw(10)
+             << result.p99_ms << std::setw(10) << result.max_ms << std::setw(12) << result.jitter_ms << std::setw(10) << result.frames
+             << std::setw(8) << result.late << std::setw(10) << result.clouds << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <future>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include "CloudAligner.h"
+
+CloudAligner::CloudAligner(size_t num_threads) : num_threads(std::max<size_t>(1, num_threads)), pool(this->num_threads) {
+}
+
+// Splits [0, count) into one chunk per thread and waits for all of them
+void CloudAligner::parallelFor(size_t count, const std::function<void(size_t, size_t, size_t)>& task) {
+    size_t chunks = std::min(num_threads, std::max<size_t>(1, count));
+    size_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<std::future<void>> done;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        size_t begin = chunk * chunk_size;
+        size_t end = std::min(count, begin + chunk_size);
+        auto job = std::make_shared<std::packaged_task<void()>>([&task, begin, end, chunk]() {
+            task(begin, end, chunk);
+        });
+        done.push_back(job->get_future());
+        pool.enqueueTask([job]() { (*job)(); });
+    }
+    for (auto& future : done) {
+        future.get();
+    }
+}
+
+static double intensity(const pcl::PointXYZRGB& point) {
+    return (point.r + point.g + point.b) / (3.0 * 255.0);
+}
+
+Eigen::Matrix4d vectorToTransform(const Eigen::Matrix<double, 6, 1>& x) {
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    transformation.block<3, 3>(0, 0) = (Eigen::AngleAxisd(x(2), Eigen::Vector3d::UnitZ())
+        * Eigen::AngleAxisd(x(1), Eigen::Vector3d::UnitY())
+        * Eigen::AngleAxisd(x(0), Eigen::Vector3d::UnitX())).matrix();
+    transformation.block<3, 1>(0, 3) = x.tail<3>();
+    return transformation;
+}
+
+// Target normals and color gradients, estimated from the neighbors within radius (at most max_nn)
+CloudAligner::TargetData CloudAligner::prepareTarget(const ColorCloud::ConstPtr& target, double radius, int max_nn) {
+    TargetData data;
+    size_t size = target->size();
+    data.points.resize(size);
+    data.normals.resize(size);
+    data.gradients.resize(size);
+    data.intensities.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        data.points[i] = target->points[i].getVector3fMap().cast<double>();
+        data.intensities[i] = intensity(target->points[i]);
+    }
+
+    pcl::KdTreeFLANN<pcl::PointXYZRGB> tree;
+    tree.setInputCloud(target);
+    parallelFor(size, [&](size_t begin, size_t end, size_t) {
+        std::vector<int> indices;
+        std::vector<float> distances;
+        for (size_t i = begin; i < end; i++) {
+            const Eigen::Vector3d& point = data.points[i];
+            int found = tree.radiusSearch(target->points[i], radius, indices, distances, max_nn);
+            if (found < 3) {
+                data.normals[i] = Eigen::Vector3d::UnitZ();
+                data.gradients[i].setZero();
+                continue;
+            }
+
+            Eigen::Vector3d normal = estimateNormal(data.points, indices, found);
+            data.normals[i] = normal;
+
+            // Color gradient in the tangent plane: least squares fit of the intensity differences
+            // of the projected neighbors, with the normal component constrained to zero
+            if (found < 4) {
+                data.gradients[i].setZero();
+                continue;
+            }
+            Eigen::MatrixXd A(found + 1, 3);
+            Eigen::VectorXd b(found + 1);
+            int row = 0;
+            for (int k = 0; k < found; k++) {
+                if (indices[k] == static_cast<int>(i)) continue;
+                const Eigen::Vector3d& neighbor = data.points[indices[k]];
+                Eigen::Vector3d projected = neighbor - (neighbor - point).dot(normal) * normal;
+                A.row(row) = projected - point;
+                b(row) = data.intensities[indices[k]] - data.intensities[i];
+                row++;
+            }
+            A.row(row) = (row) * normal;
+            b(row) = 0;
+            row++;
+            Eigen::MatrixXd At = A.topRows(row).transpose();
+            data.gradients[i] = (At * A.topRows(row)).ldlt().solve(At * b.head(row));
+        }
+    });
+    return data;
+}
+
+RegistrationResult CloudAligner::alignScale(const ColorCloud::ConstPtr& source, const ColorCloud::ConstPtr& target,
+    const ICPScale& scale, const Eigen::Matrix4d& init) {
+    double max_distance = scale.voxel_size;
+    TargetData target_data = prepareTarget(target, scale.voxel_size * 2, 30);
+    pcl::KdTreeFLANN<pcl::PointXYZRGB> tree;
+    tree.setInputCloud(target);
+
+    size_t size = source->size();
+    std::vector<Eigen::Vector3d> source_points(size);
+    std::vector<double> source_intensities(size);
+    for (size_t i = 0; i < size; i++) {
+        source_points[i] = source->points[i].getVector3fMap().cast<double>();
+        source_intensities[i] = intensity(source->points[i]);
+    }
+
+    double sqrt_lambda_geometric = std::sqrt(lambda_geometric);
+    double sqrt_lambda_photometric = std::sqrt(1.0 - lambda_geometric);
+
+    struct Accumulator {
+        Eigen::Matrix<double, 6, 6> JTJ;
+        Eigen::Matrix<double, 6, 1> JTr;
+        double squared_error;
+        size_t correspondences;
+    };
+    std::vector<Accumulator> partial(num_threads);
+
+    RegistrationResult result;
+    result.transformation = init;
+    double previous_fitness = -1;
+    double previous_rmse = -1;
+
+    for (int iteration = 0; iteration <= scale.max_iterations; iteration++) {
+        Eigen::Matrix3d R = result.transformation.block<3, 3>(0, 0);
+        Eigen::Vector3d t = result.transformation.block<3, 1>(0, 3);
+
+        // Correspondences and the linear system, in parallel over the source points
+        for (auto& accumulator : partial) {
+            accumulator.JTJ.setZero();
+            accumulator.JTr.setZero();
+            accumulator.squared_error = 0;
+            accumulator.correspondences = 0;
+        }
+        parallelFor(size, [&](size_t begin, size_t end, size_t chunk) {
+            Accumulator& accumulator = partial[chunk];
+            std::vector<int> index(1);
+            std::vector<float> distance(1);
+            pcl::PointXYZRGB query;
+            for (size_t i = begin; i < end; i++) {
+                Eigen::Vector3d vs = R * source_points[i] + t;
+                query.x = static_cast<float>(vs.x());
+                query.y = static_cast<float>(vs.y());
+                query.z = static_cast<float>(vs.z());
+                if (tree.nearestKSearch(query, 1, index, distance) < 1) continue;
+                if (distance[0] > max_distance * max_distance) continue;
+
+                int j = index[0];
+                const Eigen::Vector3d& vt = target_data.points[j];
+                const Eigen::Vector3d& nt = target_data.normals[j];
+                const Eigen::Vector3d& dit = target_data.gradients[j];
+
+                // Geometric term: point to plane distance
+                Eigen::Matrix<double, 6, 1> J_geometric;
+                J_geometric.head<3>() = sqrt_lambda_geometric * vs.cross(nt);
+                J_geometric.tail<3>() = sqrt_lambda_geometric * nt;
+                double r_geometric = sqrt_lambda_geometric * (vs - vt).dot(nt);
+
+                // Photometric term: source intensity against the target color on its tangent plane
+                Eigen::Vector3d vs_proj = vs - (vs - vt).dot(nt) * nt;
+                double it_proj = target_data.intensities[j] + dit.dot(vs_proj - vt);
+                // Derivative of -it_proj with respect to vs: -dit^T (I - nt nt^T)
+                Eigen::Vector3d dM = -(dit - dit.dot(nt) * nt);
+                Eigen::Matrix<double, 6, 1> J_photometric;
+                J_photometric.head<3>() = sqrt_lambda_photometric * vs.cross(dM);
+                J_photometric.tail<3>() = sqrt_lambda_photometric * dM;
+                double r_photometric = sqrt_lambda_photometric * (source_intensities[i] - it_proj);
+
+                accumulator.JTJ += J_geometric * J_geometric.transpose() + J_photometric * J_photometric.transpose();
+                accumulator.JTr += J_geometric * r_geometric + J_photometric * r_photometric;
+                accumulator.squared_error += distance[0];
+                accumulator.correspondences++;
+            }
+        });
+
+        Eigen::Matrix<double, 6, 6> JTJ = Eigen::Matrix<double, 6, 6>::Zero();
+        Eigen::Matrix<double, 6, 1> JTr = Eigen::Matrix<double, 6, 1>::Zero();
+        double squared_error = 0;
+        size_t correspondences = 0;
+        for (const auto& accumulator : partial) {
+            JTJ += accumulator.JTJ;
+            JTr += accumulator.JTr;
+            squared_error += accumulator.squared_error;
+            correspondences += accumulator.correspondences;
+        }
+        result.correspondences = correspondences;
+        result.fitness = size > 0 ? static_cast<double>(correspondences) / size : 0;
+        result.inlier_rmse = correspondences > 0 ? std::sqrt(squared_error / correspondences) : 0;
+        result.iterations = iteration;
+
+        // Early termination once the alignment stops improving
+        if (correspondences < 6 || iteration == scale.max_iterations) break;
+        if (std::abs(previous_fitness - result.fitness) < relative_fitness
+            && std::abs(previous_rmse - result.inlier_rmse) < relative_rmse) break;
+        previous_fitness = result.fitness;
+        previous_rmse = result.inlier_rmse;
+
+        Eigen::Matrix<double, 6, 1> x = JTJ.ldlt().solve(-JTr);
+        if (!x.allFinite()) break;
+        result.transformation = vectorToTransform(x) * result.transformation;
+    }
+    return result;
+}
+
+RegistrationResult CloudAligner::align(const ColorCloud::ConstPtr& source, const ColorCloud::ConstPtr& target,
+    const std::vector<ICPScale>& scales, const Eigen::Matrix4d& init) {
+    RegistrationResult result;
+    result.transformation = init;
+    for (size_t i = 0; i < scales.size(); i++) {
+        const ICPScale& scale = scales[i];
+        if (verbose) {
+            std::cout << "[" << scale.max_iterations << ", " << scale.voxel_size << ", " << i << "]" << std::endl;
+        }
+        ColorCloud::Ptr source_down = voxelDownsample(source, scale.voxel_size);
+        ColorCloud::Ptr target_down = voxelDownsample(target, scale.voxel_size);
+        result = alignScale(source_down, target_down, scale, result.transformation);
+        if (verbose) {
+            std::cout << "RegistrationResult with fitness=" << std::scientific << std::setprecision(6) << result.fitness
+                << ", inlier_rmse=" << result.inlier_rmse << ", and correspondence_set size of "
+                << std::defaultfloat << result.correspondences << " (" << result.iterations << " iterations)" << std::endl;
+        }
+    }
+    return result;
+}
+
+Eigen::Vector3d estimateNormal(const std::vector<Eigen::Vector3d>& points, const std::vector<int>& indices, int count) {
+    // Direction of least variance of the neighborhood
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    for (int k = 0; k < count; k++) mean += points[indices[k]];
+    mean /= count;
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for (int k = 0; k < count; k++) {
+        Eigen::Vector3d d = points[indices[k]] - mean;
+        covariance += d * d.transpose();
+    }
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    return solver.eigenvectors().col(0);
+}
+
+ColorCloud::Ptr voxelDownsample(const ColorCloud::ConstPtr& cloud, double voxel_size) {
+    ColorCloud::Ptr downsampled(new ColorCloud);
+    pcl::VoxelGrid<pcl::PointXYZRGB> voxel_grid_filter;
+    voxel_grid_filter.setInputCloud(cloud);
+    float leaf = static_cast<float>(voxel_size);
+    voxel_grid_filter.setLeafSize(leaf, leaf, leaf);
+    voxel_grid_filter.filter(*downsampled);
+    return downsampled;
+}
+
+Eigen::Matrix3d eulerToRotation(double roll_deg, double pitch_deg, double yaw_deg) {
+    const double to_rad = EIGEN_PI / 180.0;
+    return (Eigen::AngleAxisd(yaw_deg * to_rad, Eigen::Vector3d::UnitZ())
+        * Eigen::AngleAxisd(pitch_deg * to_rad, Eigen::Vector3d::UnitY())
+        * Eigen::AngleAxisd(roll_deg * to_rad, Eigen::Vector3d::UnitX())).matrix();
+}
+
+std::string formatTransform(const Eigen::Matrix4d& transformation) {
+    std::stringstream out;
+    out << std::fixed << std::setprecision(8);
+    for (int row = 0; row < 4; row++) {
+        out << (row == 0 ? "[[" : " [");
+        for (int col = 0; col < 4; col++) {
+            double value = transformation(row, col);
+            if (value == 0) value = 0;  // No "-0.00000000"
+            out << (value < 0 ? "" : " ") << value << (col < 3 ? " " : "");
+        }
+        out << (row == 3 ? "]]" : "]\n");
+    }
+    return out.str();
+}
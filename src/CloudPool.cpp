@@ -0,0 +1,89 @@
+#include "CloudPool.h"
+
+CloudBuffers::CloudBuffers()
+    : cloud(new pcl::PointCloud<pcl::PointXYZRGB>),
+      scratch(new pcl::PointCloud<pcl::PointXYZRGB>),
+      normals(new pcl::PointCloud<pcl::Normal>),
+      normal_cloud(new pcl::PointCloud<pcl::PointXYZRGBNormal>),
+      tree(new pcl::search::KdTree<pcl::PointXYZRGB>) {
+}
+
+void CloudBuffers::crop(const Eigen::Vector3f& min, const Eigen::Vector3f& max) {
+    size_t kept = 0;
+    for (size_t i = 0; i < cloud->points.size(); i++) {
+        const pcl::PointXYZRGB& point = cloud->points[i];
+        if (point.x >= min.x() && point.x <= max.x() && point.y >= min.y() && point.y <= max.y() &&
+            point.z >= min.z() && point.z <= max.z()) {
+            cloud->points[kept++] = point;
+        }
+    }
+    cloud->resize(kept);
+}
+
+// Empties the clouds, their memory is kept
+void CloudBuffers::clear() {
+    cloud->clear();
+    scratch->clear();
+    normals->clear();
+    normal_cloud->clear();
+}
+
+void CloudBuffers::reserve(size_t points) {
+    cloud->reserve(points);
+    scratch->reserve(points);
+    normals->reserve(points);
+    normal_cloud->reserve(points);
+}
+
+size_t CloudBuffers::capacity() const {
+    return cloud->points.capacity() > scratch->points.capacity() ? cloud->points.capacity() : scratch->points.capacity();
+}
+
+std::shared_ptr<CloudBuffers> CloudPool::borrow() {
+    std::unique_ptr<CloudBuffers> buffers;
+    size_t reserve_points = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!idle.empty()) {
+            buffers = std::move(idle.back());
+            idle.pop_back();
+        } else {
+            sets_created++;
+            reserve_points = high_water;
+        }
+    }
+    if (!buffers) {
+        buffers.reset(new CloudBuffers);
+        buffers->reserve(reserve_points);
+    }
+    // The deleter keeps the pool alive until the set is back
+    std::shared_ptr<CloudPool> pool = shared_from_this();
+    return std::shared_ptr<CloudBuffers>(buffers.release(), [pool](CloudBuffers* returned) { pool->release(returned); });
+}
+
+void CloudPool::release(CloudBuffers* buffers) {
+    std::unique_ptr<CloudBuffers> returned(buffers);
+    size_t capacity = returned->capacity();
+    returned->clear();
+    std::lock_guard<std::mutex> lock(mtx);
+    if (capacity > high_water) high_water = capacity;
+    if (idle.size() < max_idle) idle.push_back(std::move(returned));
+}
+
+void CloudPool::setMaxIdle(size_t count) {
+    std::lock_guard<std::mutex> lock(mtx);
+    max_idle = count;
+    if (idle.size() > max_idle) idle.resize(max_idle);
+}
+
+// Largest cloud seen, in points
+size_t CloudPool::highWater() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return high_water;
+}
+
+// Number of buffer sets allocated since the start
+size_t CloudPool::created() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return sets_created;
+}
@@ -0,0 +1,277 @@
+// Cloud Pool Bench: Counts the heap allocations of the cloud processing of the scanner (copy of the
+// frame points, transform, crop, SOR, voxel grid, normals), once with new clouds and filter objects
+// for every frame as before, and once with the buffers borrowed from a CloudPool (see CloudPool.h).
+//
+// The frames are the --input cloud, or a synthetic object on a background, rotated as on the
+// turntable. The first frames fill the pool, the counts are per frame after the --warmup frames.
+//
+// The allocations are counted at malloc on glibc, which also sees the cloud storage (Eigen's
+// aligned_malloc). Elsewhere they are counted at operator new, without the cloud storage.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cerrno>
+#include <new>
+#include <random>
+#include <Eigen/Dense>
+#include <pcl/io/ply_io.h>
+#include <pcl/common/transforms.h>
+#include <pcl/common/io.h>
+
+#include "CloudPool.h"
+#include "NormalEstimator.h"
+#include "ThreadPool.h"
+
+using std::cout;
+using std::endl;
+
+namespace {
+std::atomic<unsigned long long> allocations{ 0 };
+std::atomic<unsigned long long> allocated_bytes{ 0 };
+std::atomic<unsigned long long> large_allocations{ 0 };
+const size_t large_size = 64 << 10;
+
+void countAllocation(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size >= large_size) large_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+void* memalign(size_t alignment, size_t size) {
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    countAllocation(size);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+}
+#else
+void* operator new(size_t size) {
+    countAllocation(size);
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
+struct BenchOptions {
+    std::string input;
+    size_t points = 300000;
+    int frames = 60;
+    int warmup = 2;
+    int sor_k = 50;
+    float sor_stddev = 1.0f;
+    float leaf_size = 0.0f;             // 0 = no voxel grid
+    bool normals = true;
+    int k = 16;
+    int threads = 1;
+    size_t max_idle = 2;
+};
+
+struct ModeResult {
+    std::string mode;
+    double ms = 0;
+    double allocations = 0;
+    double megabytes = 0;
+    double large = 0;
+    size_t points = 0;
+};
+
+void printUsage() {
+    cout << "Usage: CloudPoolBench [--input <cloud.ply>] [--points N] [--frames N] [--warmup N]\n"
+         << "                      [--sor-k N] [--sor-stddev X] [--leaf X] [--no-normals] [--k N] [--threads N] [--max-idle N]\n";
+}
+
+bool parseArgs(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value) options.input = argv[++i];
+        else if (arg == "--points" && has_value) options.points = std::stoul(argv[++i]);
+        else if (arg == "--frames" && has_value) options.frames = std::stoi(argv[++i]);
+        else if (arg == "--warmup" && has_value) options.warmup = std::stoi(argv[++i]);
+        else if (arg == "--sor-k" && has_value) options.sor_k = std::stoi(argv[++i]);
+        else if (arg == "--sor-stddev" && has_value) options.sor_stddev = std::stof(argv[++i]);
+        else if (arg == "--leaf" && has_value) options.leaf_size = std::stof(argv[++i]);
+        else if (arg == "--no-normals") options.normals = false;
+        else if (arg == "--k" && has_value) options.k = std::stoi(argv[++i]);
+        else if (arg == "--threads" && has_value) options.threads = std::stoi(argv[++i]);
+        else if (arg == "--max-idle" && has_value) options.max_idle = std::stoul(argv[++i]);
+        else return false;
+    }
+    return options.frames > options.warmup && options.warmup >= 0;
+}
+
+// Sphere of 10 cm on a background plane 30 cm behind it, seen from 50 cm like a scanner camera
+void synthesizeFrame(size_t count, pcl::PointCloud<pcl::PointXYZRGB>& frame) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.001f);
+    frame.clear();
+    frame.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        pcl::PointXYZRGB point;
+        if (i % 3 == 0) {
+            Eigen::Vector3f direction(unit(random), unit(random), unit(random));
+            if (direction.norm() < 1e-3f) direction = Eigen::Vector3f::UnitZ();
+            Eigen::Vector3f surface = direction.normalized() * (0.1f + noise(random));
+            point.x = surface.x();
+            point.y = surface.y();
+            point.z = surface.z() + 0.5f;
+        } else {
+            point.x = unit(random) * 0.4f;
+            point.y = unit(random) * 0.3f;
+            point.z = 0.8f + noise(random);
+        }
+        point.r = point.g = point.b = 128;
+        frame.push_back(point);
+    }
+}
+
+// The cloud processing of RealSenseHandler::process_frameset on the given buffers
+size_t processFrame(CloudBuffers& buffers, const pcl::PointCloud<pcl::PointXYZRGB>& frame, const Eigen::Matrix4f& transform,
+                    const BenchOptions& options, ThreadPool* pool) {
+    pcl::PointCloud<pcl::PointXYZRGB>& cloud = *buffers.cloud;
+    for (const auto& point : frame.points) {
+        if (point.z <= 0) continue;
+        cloud.push_back(point);
+    }
+    pcl::transformPointCloud(cloud, cloud, transform);
+    buffers.crop(Eigen::Vector3f(-0.15f, -0.15f, -0.15f), Eigen::Vector3f(0.15f, 0.15f, 0.15f));
+
+    buffers.sor.setMeanK(options.sor_k);
+    buffers.sor.setStddevMulThresh(options.sor_stddev);
+    buffers.filter(buffers.sor);
+    if (options.leaf_size > 0) {
+        buffers.voxel.setLeafSize(options.leaf_size, options.leaf_size, options.leaf_size);
+        buffers.filter(buffers.voxel);
+    }
+
+    if (options.normals) {
+        NormalEstimator estimator;
+        estimator.k = options.k;
+        estimator.threads = options.threads;
+        estimator.compute(buffers.cloud, *buffers.tree, Eigen::Vector3f(0, 0, -0.5f), *buffers.normals, pool);
+        pcl::concatenateFields(*buffers.cloud, *buffers.normals, *buffers.normal_cloud);
+    }
+    return buffers.cloud->size();
+}
+
+ModeResult runMode(const std::string& mode, const pcl::PointCloud<pcl::PointXYZRGB>& frame, const BenchOptions& options,
+                   ThreadPool* pool) {
+    ModeResult result;
+    result.mode = mode;
+    auto buffer_pool = std::make_shared<CloudPool>(options.max_idle);
+    unsigned long long start_count = 0, start_bytes = 0, start_large = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.frames; i++) {
+        if (i == options.warmup) {
+            start_count = allocations.load();
+            start_bytes = allocated_bytes.load();
+            start_large = large_allocations.load();
+            start = std::chrono::steady_clock::now();
+        }
+        // Turntable angle, 1 degree per frame around the object
+        Eigen::Affine3f transform(Eigen::Translation3f(0, 0, -0.5f));
+        transform.prerotate(Eigen::AngleAxisf(static_cast<float>(i) * 3.14159265f / 180.0f, Eigen::Vector3f::UnitY()));
+        if (mode == "pooled") {
+            std::shared_ptr<CloudBuffers> buffers = buffer_pool->borrow();
+            result.points += processFrame(*buffers, frame, transform.matrix(), options, pool);
+        } else {
+            CloudBuffers buffers;
+            buffers.cloud->reserve(frame.size());
+            result.points += processFrame(buffers, frame, transform.matrix(), options, pool);
+        }
+    }
+    double frames = options.frames - options.warmup;
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    result.allocations = (allocations.load() - start_count) / frames;
+    result.megabytes = (allocated_bytes.load() - start_bytes) / frames / 1048576.0;
+    result.large = (large_allocations.load() - start_large) / frames;
+    result.points /= options.frames;
+    if (mode == "pooled") {
+        cout << "Pool: " << buffer_pool->created() << " buffer sets created, high water " << buffer_pool->highWater() << " points" << endl;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    pcl::PointCloud<pcl::PointXYZRGB> frame;
+    if (!options.input.empty()) {
+        if (pcl::io::loadPLYFile(options.input, frame) < 0 || frame.empty()) {
+            std::cerr << "Failed to load " << options.input << endl;
+            return 1;
+        }
+    } else {
+        synthesizeFrame(options.points, frame);
+    }
+    cout << "Frame: " << frame.size() << " points, " << options.frames << " frames (" << options.warmup << " warmup)" << endl;
+
+    // Helpers of the normals, started before the counts
+    ThreadPool pool(options.threads > 1 ? options.threads - 1 : 1);
+    std::vector<ModeResult> results = { runMode("fresh", frame, options, &pool), runMode("pooled", frame, options, &pool) };
+    cout << std::fixed << std::setprecision(2);
+    cout << std::left << std::setw(8) << "mode" << std::right << std::setw(12) << "ms/frame" << std::setw(14) << "allocs/frame"
+         << std::setw(12) << "MB/frame" << std::setw(14) << ">=64KB/frame" << std::setw(12) << "points" << "\n";
+    for (const auto& result : results) {
+        cout << std::left << std::setw(8) << result.mode << std::right << std::setw(12) << result.ms << std::setw(14) << result.allocations
+             << std::setw(12) << result.megabytes << std::setw(14) << result.large << std::setw(12) << result.points << "\n";
+    }
+#if !defined(__GLIBC__)
+    cout << "(counted at operator new, the cloud storage is not included)" << endl;
+#endif
+    return 0;
+}
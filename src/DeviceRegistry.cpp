@@ -0,0 +1,38 @@
+#include "DeviceRegistry.h"
+
+int DeviceRegistry::add(DeviceKind kind, const std::string& serial, const std::string& name, const std::string& label) {
+    int existing = find(kind, serial);
+    if (existing >= 0) {
+        devices[existing].name = name;
+        devices[existing].label = label.empty() ? name : label;
+        return existing;
+    }
+
+    std::vector<int>& kind_slots = slots[static_cast<int>(kind)];
+    DeviceInfo device;
+    device.id = static_cast<int>(devices.size());
+    device.kind = kind;
+    device.slot = static_cast<int>(kind_slots.size());
+    device.serial = serial;
+    device.name = name;
+    device.label = label.empty() ? name : label;
+    devices.push_back(device);
+    kind_slots.push_back(device.id);
+    device_stats.emplace_back();
+    states.emplace_back(static_cast<int>(DeviceState::Offline));
+    return device.id;
+}
+
+int DeviceRegistry::find(DeviceKind kind, const std::string& serial) const {
+    for (int id : slots[static_cast<int>(kind)]) {
+        if (devices[id].serial == serial) return id;
+    }
+    return -1;
+}
+
+// Clears the counters of all the devices, e.g. at the start of a pose
+void DeviceRegistry::resetStats() {
+    for (auto& stats : device_stats) {
+        stats.reset();
+    }
+}
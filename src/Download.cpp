@@ -6,6 +6,9 @@
 #include "EDSDK.h"
 #include "EDSDKTypes.h"
 #include "CanonHandler.h"
+#include "ScanManifest.h"
+#include "Scheduler.h"
+#include "ConfigHandler.h"
 
 namespace fs = std::filesystem;
 
@@ -40,14 +43,15 @@ EdsError downloadImage(EdsDirectoryItemRef  directoryItem, EdsVoid* _bodyID)
 	EdsStreamRef stream = NULL;     // Get directory item information  
 	EdsDirectoryItemInfo  dirItemInfo;
 
+	auto download_start = std::chrono::steady_clock::now();
 	err = EdsGetDirectoryItemInfo(directoryItem, &dirItemInfo);
 
 	// create folder  ex) cam1
 	EdsUInt32 camid;
 	camid = (EdsUInt64)_bodyID;
 	// std::cout << "Download " << camid << std::endl;
-	std::string directory_tree = canonhandle.save_dir;// + "\\cam" + std::to_string(camid);
-	if (fs::exists(directory_tree) == FALSE)
+	std::string directory_tree = canonhandle.save_dir;// + "/cam" + std::to_string(camid);
+	if (!fs::exists(directory_tree))
 	{
 		std::filesystem::create_directories(directory_tree);
 	}
@@ -55,13 +59,13 @@ EdsError downloadImage(EdsDirectoryItemRef  directoryItem, EdsVoid* _bodyID)
 	// Create filename
 	std::string cam_name = std::to_string(camid);
 	if (canonhandle.rename_cameras) {
-		std::cout << "Renamed cam" << cam_name << " -> cam" << canonhandle.camera_names[std::to_string(camid)] << std::endl;
-		cam_name = canonhandle.camera_names[std::to_string(camid)];
+		std::cout << "Renamed cam" << cam_name << " -> cam" << canonhandle.camera_name(camid - 1) << std::endl;
+		cam_name = canonhandle.camera_name(camid - 1);
 	}
 	std::string tmp;
 	std::stringstream out_file;
 	out_file.str("");
-	out_file << "\\cam" << cam_name << "_" 
+	out_file << "/cam" << cam_name << "_" 
 		<< std::setfill('0') << std::setw(3) << canonhandle.turntable_position << "_img.jpg";
 	tmp = directory_tree + out_file.str();
 	std::cout << "Saving: " << out_file.str() << std::endl;
@@ -91,6 +95,36 @@ EdsError downloadImage(EdsDirectoryItemRef  directoryItem, EdsVoid* _bodyID)
 	}
 
 	canonhandle.images_downloaded++;
+	if (camid >= 1 && camid <= canonhandle.camera_ids.size() && canonhandle.camera_ids[camid - 1] >= 0) {
+		DeviceStats& stats = DeviceRegistry::getInstance().stats(canonhandle.camera_ids[camid - 1]);
+		if (err == EDS_ERR_OK) {
+			stats.captures++;
+			stats.bytes_written += dirItemInfo.size;
+		}
+		else stats.failures++;
+		stats.addTime(download_start);
+	}
+
+	// Add the image to the scan manifest
+	if (err == EDS_ERR_OK) {
+		ManifestRecord record;
+		record.file = tmp;
+		record.camera = "cam" + cam_name;
+		record.type = "img";
+		record.angle = canonhandle.turntable_position;
+		record.capture_ms = canonhandle.shot_ms;
+		record.timings["download_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - download_start).count();
+		record.timings["shot_to_saved_ms"] = ScanManifest::nowMs() - canonhandle.shot_ms;
+		if (ConfigHandler::getInstance().getValue<bool>("dslr.quality.enable")) {
+			// Score in the background, the next downloads do not wait for it
+			size_t index = camid - 1;
+			canonhandle.quality_tasks.push_back(Scheduler::getInstance().submit("background", [record, index]() {
+				canonhandle.score_image(record, index);
+			}));
+		} else {
+			ScanManifest::getInstance().record(record);
+		}
+	}
 
 	return err;
 }
@@ -295,14 +329,14 @@ EdsError DownloadImageByDirectory(EdsUInt64 _bodyID, int volume_num)
 		// create folder  ex) cam1
 		EdsUInt32 camid;
 		camid = _bodyID;
-		std::string directory_tree = "cam" + std::to_string(camid) + "\\card" + std::to_string(volume_num+1);
-		if (fs::exists(directory_tree) == FALSE)
+		std::string directory_tree = "cam" + std::to_string(camid) + "/card" + std::to_string(volume_num+1);
+		if (!fs::exists(directory_tree))
 		{
 			std::filesystem::create_directories(directory_tree);
 		}
 
 		std::string tmp;
-		tmp = directory_tree + "\\" + dirItemInfo.szFileName;
+		tmp = directory_tree + "/" + dirItemInfo.szFileName;
 		char* szDstFileName = new char[tmp.size() + 1];
 		strcpy(szDstFileName, tmp.c_str());
 
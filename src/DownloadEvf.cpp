@@ -114,12 +114,12 @@ EdsError DownloadEvfCommand(EdsCameraRef const& camera, std::string const& camer
 	// create folder  ex) cam1
 	// TODO: This part should be deleted 
 	std::string directory_tree = cameraName;
-	if (fs::exists(directory_tree) == FALSE) {
+	if (!fs::exists(directory_tree)) {
 		std::filesystem::create_directories(directory_tree);
 	}
 
 	std::string tmp;
-	tmp = directory_tree + "\\evf.jpg";
+	tmp = directory_tree + "/evf.jpg";
 	char* filename = new char[tmp.size() + 1];
 	strcpy(filename, tmp.c_str());
 
@@ -186,7 +186,7 @@ EdsError DownloadEvfCommand(EdsCameraRef const& camera, std::string const& camer
 		}
 		// Display Image
 		cv::Mat frame;
-		frame = cv::imread(directory_tree + "\\evf.jpg");
+		frame = cv::imread(directory_tree + "/evf.jpg");
 		if (frame.empty()) {
 			break;
 		}
@@ -312,13 +312,13 @@ EdsError DownloadEvfCommand(std::vector<EdsCameraRef> const& cameraArray, std::v
 		EdsUInt32 camid;
 		camid = (EdsUInt32)_bodyID[i];
 		std::string directory_tree = "cam" + std::to_string(camid);
-		if (fs::exists(directory_tree) == FALSE)
+		if (!fs::exists(directory_tree))
 		{
 			std::filesystem::create_directories(directory_tree);
 		}
 
 		std::string tmp;
-		tmp = directory_tree + "\\evf.jpg";
+		tmp = directory_tree + "/evf.jpg";
 		char* filename = new char[tmp.size() + 1];
 		strcpy(filename, tmp.c_str());
 
@@ -388,7 +388,7 @@ EdsError DownloadEvfCommand(std::vector<EdsCameraRef> const& cameraArray, std::v
 
 			// Display Image
 			cv::Mat frame;
-			frame = cv::imread(directory_tree + "\\evf.jpg");
+			frame = cv::imread(directory_tree + "/evf.jpg");
 			if (frame.empty()) {
 				break;
 			}
@@ -0,0 +1,630 @@
+// Mock EDSDK: Link-time replacement for the Canon EDSDK library (build with -DMOCK_EDSDK=ON).
+// Implements the calls used by the project against simulated cameras, so the DSLR capture and
+// download path can be run and profiled without cameras.
+//
+// - Cameras are listed with the serial numbers in dslr.mock.serials.
+// - A shutter press queues a DirItemRequestTransfer event, delivered by EdsGetEvent after
+//   dslr.mock.shutter_ms (like the real SDK, events are only dispatched from EdsGetEvent).
+// - EdsDownload writes the JPEG payload into the stream, taking download_ms plus the payload size
+//   over download_mb_per_s. Payloads are the .jpg files in payload_dir (in turn), or a generated
+//   payload_width x payload_height image.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+
+#include "EDSDK.h"
+#include "EDSDKTypes.h"
+#include "ConfigHandler.h"
+
+namespace fs = std::filesystem;
+
+typedef std::shared_ptr<const std::vector<unsigned char>> Payload;
+
+enum class MockKind { CameraList, Camera, Volume, DirectoryItem, Stream, EvfImage };
+
+struct MockProperty {
+    EdsDataType type;
+    std::vector<unsigned char> data;
+    std::vector<EdsInt32> desc;
+};
+
+struct __EdsObject {
+    explicit __EdsObject(MockKind kind) : kind(kind) {}
+    virtual ~__EdsObject() {}
+
+    MockKind kind;
+    std::atomic<EdsUInt32> refs{1};
+    // Objects owned by the SDK state (camera list, cameras, volumes) are never deleted on release
+    bool persistent = false;
+    __EdsObject* parent = nullptr;
+    std::vector<__EdsObject*> children;
+    std::map<EdsPropertyID, MockProperty> properties;
+    EdsProgressCallback progress = nullptr;
+    EdsVoid* progress_context = nullptr;
+};
+
+struct MockCamera : __EdsObject {
+    MockCamera() : __EdsObject(MockKind::Camera) {}
+
+    int index = 0;
+    bool session_open = false;
+    int shots = 0;
+    std::deque<std::chrono::steady_clock::time_point> pending_shots;
+
+    EdsObjectEventHandler object_handler = nullptr;
+    EdsObjectEvent object_event = 0;
+    EdsVoid* object_context = nullptr;
+    EdsPropertyEventHandler property_handler = nullptr;
+    EdsVoid* property_context = nullptr;
+    EdsStateEventHandler state_handler = nullptr;
+    EdsVoid* state_context = nullptr;
+};
+
+struct MockDirectoryItem : __EdsObject {
+    MockDirectoryItem() : __EdsObject(MockKind::DirectoryItem) {}
+
+    std::string name;
+    bool is_folder = false;
+    Payload payload;
+    size_t offset = 0;
+};
+
+struct MockStream : __EdsObject {
+    MockStream() : __EdsObject(MockKind::Stream) {}
+
+    std::string filename;    // Empty for memory streams
+    std::ofstream file;
+    std::vector<unsigned char> memory;
+    EdsUInt64 length = 0;
+};
+
+struct MockEvfImage : __EdsObject {
+    MockEvfImage() : __EdsObject(MockKind::EvfImage) {}
+
+    MockStream* stream = nullptr;
+};
+
+struct MockSettings {
+    std::vector<std::string> serials;
+    std::string model = "Canon EOS (mock)";
+    std::string payload_dir;
+    int payload_width = 6000;
+    int payload_height = 4000;
+    int payload_quality = 95;
+    int session_ms = 0;
+    int shutter_ms = 0;
+    int download_ms = 0;
+    double download_mb_per_s = 0;
+};
+
+// SDK state
+static std::mutex sdk_mutex;
+static bool sdk_initialized = false;
+static MockSettings settings;
+static __EdsObject* camera_list = nullptr;
+static std::vector<Payload> payloads;
+static size_t next_payload = 0;
+
+static MockSettings loadSettings() {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    MockSettings mock;
+    mock.serials = config.getValue<std::vector<std::string>>("dslr.mock.serials");
+    mock.payload_dir = config.getValue<std::string>("dslr.mock.payload_dir");
+    mock.payload_width = config.getValue<int>("dslr.mock.payload_width");
+    mock.payload_height = config.getValue<int>("dslr.mock.payload_height");
+    mock.payload_quality = config.getValue<int>("dslr.mock.payload_quality");
+    mock.session_ms = config.getValue<int>("dslr.mock.session_ms");
+    mock.shutter_ms = config.getValue<int>("dslr.mock.shutter_ms");
+    mock.download_ms = config.getValue<int>("dslr.mock.download_ms");
+    mock.download_mb_per_s = config.getValue<double>("dslr.mock.download_mb_per_s");
+    return mock;
+}
+
+// Textured image so the JPEG size is close to a real photo (pure noise or flat color is not)
+static Payload generatePayload(int width, int height, int quality) {
+    cv::Mat coarse(std::max(1, height / 32), std::max(1, width / 32), CV_8UC3);
+    cv::randu(coarse, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat image;
+    cv::resize(coarse, image, cv::Size(width, height), 0, 0, cv::INTER_CUBIC);
+    cv::Mat grain(image.size(), CV_8UC3);
+    cv::randn(grain, cv::Scalar::all(0), cv::Scalar::all(6));
+    image += grain;
+
+    std::vector<unsigned char> jpeg;
+    cv::imencode(".jpg", image, jpeg, { cv::IMWRITE_JPEG_QUALITY, quality });
+    return std::make_shared<const std::vector<unsigned char>>(std::move(jpeg));
+}
+
+static std::vector<Payload> loadPayloads(const MockSettings& mock) {
+    std::vector<Payload> loaded;
+    if (!mock.payload_dir.empty() && fs::is_directory(mock.payload_dir)) {
+        std::vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(mock.payload_dir)) {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension == ".jpg" || extension == ".jpeg") files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files) {
+            std::ifstream input(file, std::ios::binary);
+            std::vector<unsigned char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            loaded.push_back(std::make_shared<const std::vector<unsigned char>>(std::move(data)));
+        }
+    }
+    if (loaded.empty()) {
+        loaded.push_back(generatePayload(mock.payload_width, mock.payload_height, mock.payload_quality));
+    }
+    return loaded;
+}
+
+static void setProperty(__EdsObject* object, EdsPropertyID id, EdsUInt32 value, std::vector<EdsInt32> desc = {}) {
+    MockProperty property;
+    property.type = kEdsDataType_UInt32;
+    property.data.resize(sizeof(value));
+    std::memcpy(property.data.data(), &value, sizeof(value));
+    property.desc = desc;
+    object->properties[id] = property;
+}
+
+static void setProperty(__EdsObject* object, EdsPropertyID id, const std::string& value) {
+    MockProperty property;
+    property.type = kEdsDataType_String;
+    property.data.assign(value.begin(), value.end());
+    property.data.push_back('\0');
+    object->properties[id] = property;
+}
+
+static __EdsObject* createCamera(int index, const std::string& serial) {
+    MockCamera* camera = new MockCamera();
+    camera->persistent = true;
+    camera->index = index;
+
+    // Values from the tables in Property.h
+    setProperty(camera, kEdsPropID_BodyIDEx, serial);
+    setProperty(camera, kEdsPropID_ProductName, settings.model);
+    setProperty(camera, kEdsPropID_ISOSpeed, 0x48, { 0x48, 0x50, 0x58, 0x60 });
+    setProperty(camera, kEdsPropID_Tv, 0x70, { 0x60, 0x68, 0x70, 0x78 });
+    setProperty(camera, kEdsPropID_Av, 0x38, { 0x28, 0x30, 0x38, 0x50 });
+    setProperty(camera, kEdsPropID_WhiteBalance, 1, { 0, 1, 2, 3, 5, 8 });
+    setProperty(camera, kEdsPropID_DriveMode, 0x00, { 0x00 });
+    setProperty(camera, kEdsPropID_AEMode, 3, { 3 });
+    setProperty(camera, kEdsPropID_SaveTo, kEdsSaveTo_Camera);
+    setProperty(camera, kEdsPropID_Evf_Mode, 0);
+    setProperty(camera, kEdsPropID_Evf_OutputDevice, 0);
+
+    // Memory card with an empty DCIM folder (images are saved to the host)
+    __EdsObject* volume = new __EdsObject(MockKind::Volume);
+    volume->persistent = true;
+    volume->parent = camera;
+    MockDirectoryItem* dcim = new MockDirectoryItem();
+    dcim->persistent = true;
+    dcim->parent = volume;
+    dcim->name = "DCIM";
+    dcim->is_folder = true;
+    volume->children.push_back(dcim);
+    camera->children.push_back(volume);
+    return camera;
+}
+
+static void destroyObject(__EdsObject* object) {
+    for (__EdsObject* child : object->children) {
+        destroyObject(child);
+    }
+    delete object;
+}
+
+static void sleepMs(double ms) {
+    if (ms > 0) std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(ms * 1000)));
+}
+
+EdsError EDSAPI EdsInitializeSDK() {
+    std::lock_guard<std::mutex> lock(sdk_mutex);
+    if (sdk_initialized) return EDS_ERR_OK;
+
+    settings = loadSettings();
+    payloads = loadPayloads(settings);
+    next_payload = 0;
+
+    camera_list = new __EdsObject(MockKind::CameraList);
+    camera_list->persistent = true;
+    for (size_t i = 0; i < settings.serials.size(); i++) {
+        __EdsObject* camera = createCamera(static_cast<int>(i), settings.serials[i]);
+        camera->parent = camera_list;
+        camera_list->children.push_back(camera);
+    }
+    sdk_initialized = true;
+    std::cout << "[EDSDK MOCK] " << settings.serials.size() << " cameras, " << payloads.size()
+        << " payloads (" << payloads[0]->size() / 1024 << " KB)" << std::endl;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsTerminateSDK() {
+    std::lock_guard<std::mutex> lock(sdk_mutex);
+    if (!sdk_initialized) return EDS_ERR_OK;
+    destroyObject(camera_list);
+    camera_list = nullptr;
+    payloads.clear();
+    sdk_initialized = false;
+    return EDS_ERR_OK;
+}
+
+EdsUInt32 EDSAPI EdsRetain(EdsBaseRef inRef) {
+    if (inRef == NULL) return 0xFFFFFFFF;
+    return ++inRef->refs;
+}
+
+EdsUInt32 EDSAPI EdsRelease(EdsBaseRef inRef) {
+    if (inRef == NULL) return 0xFFFFFFFF;
+    EdsUInt32 refs = --inRef->refs;
+    if (refs == 0 && !inRef->persistent) {
+        destroyObject(inRef);
+    }
+    return refs;
+}
+
+EdsError EDSAPI EdsGetChildCount(EdsBaseRef inRef, EdsUInt32* outCount) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (outCount == NULL) return EDS_ERR_INVALID_POINTER;
+    *outCount = static_cast<EdsUInt32>(inRef->children.size());
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetChildAtIndex(EdsBaseRef inRef, EdsInt32 inIndex, EdsBaseRef* outRef) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (outRef == NULL) return EDS_ERR_INVALID_POINTER;
+    if (inIndex < 0 || inIndex >= static_cast<EdsInt32>(inRef->children.size())) return EDS_ERR_INVALID_INDEX;
+    *outRef = inRef->children[inIndex];
+    EdsRetain(*outRef);
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetParent(EdsBaseRef inRef, EdsBaseRef* outParentRef) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (outParentRef == NULL) return EDS_ERR_INVALID_POINTER;
+    *outParentRef = inRef->parent;
+    if (inRef->parent != NULL) EdsRetain(inRef->parent);
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetCameraList(EdsCameraListRef* outCameraListRef) {
+    if (outCameraListRef == NULL) return EDS_ERR_INVALID_POINTER;
+    if (!sdk_initialized) return EDS_ERR_INTERNAL_ERROR;
+    *outCameraListRef = camera_list;
+    EdsRetain(camera_list);
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetDeviceInfo(EdsCameraRef inCameraRef, EdsDeviceInfo* outDeviceInfo) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    if (outDeviceInfo == NULL) return EDS_ERR_INVALID_POINTER;
+    MockCamera* camera = static_cast<MockCamera*>(inCameraRef);
+    std::memset(outDeviceInfo, 0, sizeof(EdsDeviceInfo));
+    std::string port = "mock" + std::to_string(camera->index);
+    std::strncpy(outDeviceInfo->szPortName, port.c_str(), EDS_MAX_NAME - 1);
+    std::strncpy(outDeviceInfo->szDeviceDescription, settings.model.c_str(), EDS_MAX_NAME - 1);
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsOpenSession(EdsCameraRef inCameraRef) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    sleepMs(settings.session_ms);
+    static_cast<MockCamera*>(inCameraRef)->session_open = true;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsCloseSession(EdsCameraRef inCameraRef) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    static_cast<MockCamera*>(inCameraRef)->session_open = false;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetPropertySize(EdsBaseRef inRef, EdsPropertyID inPropertyID, EdsInt32 inParam, EdsDataType* outDataType, EdsUInt32* outSize) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    auto property = inRef->properties.find(inPropertyID);
+    if (property == inRef->properties.end()) return EDS_ERR_PROPERTIES_UNAVAILABLE;
+    if (outDataType != NULL) *outDataType = property->second.type;
+    if (outSize != NULL) *outSize = static_cast<EdsUInt32>(property->second.data.size());
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetPropertyData(EdsBaseRef inRef, EdsPropertyID inPropertyID, EdsInt32 inParam, EdsUInt32 inPropertySize, EdsVoid* outPropertyData) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (outPropertyData == NULL) return EDS_ERR_INVALID_POINTER;
+    std::memset(outPropertyData, 0, inPropertySize);
+    auto property = inRef->properties.find(inPropertyID);
+    if (property == inRef->properties.end()) {
+        // Live view metadata (zoom, histogram...) is reported as zeros
+        return inRef->kind == MockKind::EvfImage ? EDS_ERR_OK : EDS_ERR_PROPERTIES_UNAVAILABLE;
+    }
+    std::memcpy(outPropertyData, property->second.data.data(), std::min<size_t>(inPropertySize, property->second.data.size()));
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSetPropertyData(EdsBaseRef inRef, EdsPropertyID inPropertyID, EdsInt32 inParam, EdsUInt32 inPropertySize, const EdsVoid* inPropertyData) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (inPropertyData == NULL) return EDS_ERR_INVALID_POINTER;
+    MockProperty& property = inRef->properties[inPropertyID];
+    if (property.data.empty()) property.type = kEdsDataType_UInt32;
+    const unsigned char* data = static_cast<const unsigned char*>(inPropertyData);
+    property.data.assign(data, data + inPropertySize);
+
+    MockCamera* camera = inRef->kind == MockKind::Camera ? static_cast<MockCamera*>(inRef) : nullptr;
+    if (camera != nullptr && camera->property_handler != nullptr) {
+        camera->property_handler(kEdsPropertyEvent_PropertyChanged, inPropertyID, inParam, camera->property_context);
+    }
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetPropertyDesc(EdsBaseRef inRef, EdsPropertyID inPropertyID, EdsPropertyDesc* outPropertyDesc) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    if (outPropertyDesc == NULL) return EDS_ERR_INVALID_POINTER;
+    std::memset(outPropertyDesc, 0, sizeof(EdsPropertyDesc));
+    auto property = inRef->properties.find(inPropertyID);
+    if (property == inRef->properties.end()) return EDS_ERR_PROPERTIES_UNAVAILABLE;
+    const std::vector<EdsInt32>& desc = property->second.desc;
+    outPropertyDesc->numElements = static_cast<EdsInt32>(std::min<size_t>(desc.size(), 128));
+    for (EdsInt32 i = 0; i < outPropertyDesc->numElements; i++) {
+        outPropertyDesc->propDesc[i] = desc[i];
+    }
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSendCommand(EdsCameraRef inCameraRef, EdsCameraCommand inCommand, EdsInt32 inParam) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    MockCamera* camera = static_cast<MockCamera*>(inCameraRef);
+    if (!camera->session_open) return EDS_ERR_SESSION_NOT_OPEN;
+
+    bool shoot = inCommand == kEdsCameraCommand_TakePicture;
+    if (inCommand == kEdsCameraCommand_PressShutterButton) {
+        shoot = inParam == kEdsCameraCommand_ShutterButton_Completely
+            || inParam == kEdsCameraCommand_ShutterButton_Completely_NonAF;
+    }
+    if (shoot) {
+        std::lock_guard<std::mutex> lock(sdk_mutex);
+        camera->pending_shots.push_back(std::chrono::steady_clock::now() + std::chrono::milliseconds(settings.shutter_ms));
+    }
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSendStatusCommand(EdsCameraRef inCameraRef, EdsCameraStatusCommand inStatusCommand, EdsInt32 inParam) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    if (!static_cast<MockCamera*>(inCameraRef)->session_open) return EDS_ERR_SESSION_NOT_OPEN;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSetCapacity(EdsCameraRef inCameraRef, EdsCapacity inCapacity) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetVolumeInfo(EdsVolumeRef inVolumeRef, EdsVolumeInfo* outVolumeInfo) {
+    if (inVolumeRef == NULL || inVolumeRef->kind != MockKind::Volume) return EDS_ERR_INVALID_HANDLE;
+    if (outVolumeInfo == NULL) return EDS_ERR_INVALID_POINTER;
+    std::memset(outVolumeInfo, 0, sizeof(EdsVolumeInfo));
+    outVolumeInfo->storageType = kEdsStorageType_SD;
+    outVolumeInfo->access = kEdsAccess_ReadWrite;
+    outVolumeInfo->maxCapacity = 64ULL << 30;
+    outVolumeInfo->freeSpaceInBytes = 64ULL << 30;
+    std::strncpy(outVolumeInfo->szVolumeLabel, "MOCK", EDS_MAX_NAME - 1);
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetDirectoryItemInfo(EdsDirectoryItemRef inDirItemRef, EdsDirectoryItemInfo* outDirItemInfo) {
+    if (inDirItemRef == NULL || inDirItemRef->kind != MockKind::DirectoryItem) return EDS_ERR_INVALID_HANDLE;
+    if (outDirItemInfo == NULL) return EDS_ERR_INVALID_POINTER;
+    MockDirectoryItem* item = static_cast<MockDirectoryItem*>(inDirItemRef);
+    std::memset(outDirItemInfo, 0, sizeof(EdsDirectoryItemInfo));
+    outDirItemInfo->size = item->payload ? item->payload->size() : 0;
+    outDirItemInfo->isFolder = item->is_folder;
+    std::strncpy(outDirItemInfo->szFileName, item->name.c_str(), EDS_MAX_NAME - 1);
+    return EDS_ERR_OK;
+}
+
+static EdsError writeStream(MockStream* stream, const unsigned char* data, size_t size) {
+    if (stream->filename.empty()) {
+        stream->memory.insert(stream->memory.end(), data, data + size);
+    } else {
+        stream->file.write(reinterpret_cast<const char*>(data), size);
+        if (!stream->file) return EDS_ERR_FILE_WRITE_ERROR;
+    }
+    stream->length += size;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsDownload(EdsDirectoryItemRef inDirItemRef, EdsUInt64 inReadSize, EdsStreamRef outStream) {
+    if (inDirItemRef == NULL || inDirItemRef->kind != MockKind::DirectoryItem) return EDS_ERR_INVALID_HANDLE;
+    if (outStream == NULL || outStream->kind != MockKind::Stream) return EDS_ERR_INVALID_HANDLE;
+    MockDirectoryItem* item = static_cast<MockDirectoryItem*>(inDirItemRef);
+    MockStream* stream = static_cast<MockStream*>(outStream);
+    if (!item->payload) return EDS_ERR_NOT_SUPPORTED;
+
+    size_t size = static_cast<size_t>(std::min<EdsUInt64>(inReadSize, item->payload->size() - item->offset));
+    double transfer_ms = settings.download_mb_per_s > 0 ? size / (settings.download_mb_per_s * 1000.0) : 0;
+    sleepMs(settings.download_ms);
+
+    // Transfer in chunks so progress callbacks and the timing look like a USB transfer
+    const int chunks = 8;
+    size_t chunk_size = (size + chunks - 1) / chunks;
+    for (size_t done = 0; done < size; done += chunk_size) {
+        size_t length = std::min(chunk_size, size - done);
+        sleepMs(transfer_ms * length / size);
+        EdsError err = writeStream(stream, item->payload->data() + item->offset, length);
+        if (err != EDS_ERR_OK) return err;
+        item->offset += length;
+
+        EdsProgressCallback progress = stream->progress ? stream->progress : item->progress;
+        EdsVoid* context = stream->progress ? stream->progress_context : item->progress_context;
+        if (progress != nullptr) {
+            EdsBool cancel = false;
+            progress(static_cast<EdsUInt32>((done + length) * 100 / size), context, &cancel);
+            if (cancel) return EDS_ERR_OPERATION_CANCELLED;
+        }
+    }
+    if (!stream->filename.empty()) stream->file.flush();
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsDownloadComplete(EdsDirectoryItemRef inDirItemRef) {
+    if (inDirItemRef == NULL || inDirItemRef->kind != MockKind::DirectoryItem) return EDS_ERR_INVALID_HANDLE;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSetProgressCallback(EdsBaseRef inRef, EdsProgressCallback inProgressCallback, EdsProgressOption inProgressOption, EdsVoid* inContext) {
+    if (inRef == NULL) return EDS_ERR_INVALID_HANDLE;
+    inRef->progress = inProgressCallback;
+    inRef->progress_context = inContext;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsCreateFileStream(const EdsChar* inFileName, EdsFileCreateDisposition inCreateDisposition, EdsAccess inDesiredAccess, EdsStreamRef* outStream) {
+    if (inFileName == NULL || outStream == NULL) return EDS_ERR_INVALID_POINTER;
+    MockStream* stream = new MockStream();
+    stream->filename = inFileName;
+    std::ios::openmode mode = std::ios::binary | std::ios::out;
+    mode |= inCreateDisposition == kEdsFileCreateDisposition_OpenExisting ? std::ios::app : std::ios::trunc;
+    stream->file.open(stream->filename, mode);
+    if (!stream->file.is_open()) {
+        delete stream;
+        return EDS_ERR_FILE_OPEN_ERROR;
+    }
+    *outStream = stream;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsCreateMemoryStream(EdsUInt64 inBufferSize, EdsStreamRef* outStream) {
+    if (outStream == NULL) return EDS_ERR_INVALID_POINTER;
+    MockStream* stream = new MockStream();
+    stream->memory.reserve(static_cast<size_t>(inBufferSize));
+    *outStream = stream;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetPointer(EdsStreamRef inStream, EdsVoid** outPointer) {
+    if (inStream == NULL || inStream->kind != MockKind::Stream) return EDS_ERR_INVALID_HANDLE;
+    if (outPointer == NULL) return EDS_ERR_INVALID_POINTER;
+    MockStream* stream = static_cast<MockStream*>(inStream);
+    if (!stream->filename.empty()) return EDS_ERR_NOT_SUPPORTED;
+    *outPointer = stream->memory.data();
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsGetLength(EdsStreamRef inStream, EdsUInt64* outLength) {
+    if (inStream == NULL || inStream->kind != MockKind::Stream) return EDS_ERR_INVALID_HANDLE;
+    if (outLength == NULL) return EDS_ERR_INVALID_POINTER;
+    *outLength = static_cast<MockStream*>(inStream)->length;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsCreateEvfImageRef(EdsStreamRef inStreamRef, EdsEvfImageRef* outEvfImageRef) {
+    if (inStreamRef == NULL || inStreamRef->kind != MockKind::Stream) return EDS_ERR_INVALID_HANDLE;
+    if (outEvfImageRef == NULL) return EDS_ERR_INVALID_POINTER;
+    MockEvfImage* image = new MockEvfImage();
+    image->stream = static_cast<MockStream*>(inStreamRef);
+    *outEvfImageRef = image;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsDownloadEvfImage(EdsCameraRef inCameraRef, EdsEvfImageRef inEvfImageRef) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    if (inEvfImageRef == NULL || inEvfImageRef->kind != MockKind::EvfImage) return EDS_ERR_INVALID_HANDLE;
+    MockStream* stream = static_cast<MockEvfImage*>(inEvfImageRef)->stream;
+
+    Payload payload;
+    {
+        std::lock_guard<std::mutex> lock(sdk_mutex);
+        payload = payloads[static_cast<MockCamera*>(inCameraRef)->index % payloads.size()];
+    }
+    // Every live view frame replaces the previous one
+    if (stream->filename.empty()) {
+        stream->memory.clear();
+    } else {
+        stream->file.close();
+        stream->file.open(stream->filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    }
+    stream->length = 0;
+    EdsError err = writeStream(stream, payload->data(), payload->size());
+    if (!stream->filename.empty()) stream->file.flush();
+    return err;
+}
+
+EdsError EDSAPI EdsSetObjectEventHandler(EdsCameraRef inCameraRef, EdsObjectEvent inEvent, EdsObjectEventHandler inObjectEventHandler, EdsVoid* inContext) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    MockCamera* camera = static_cast<MockCamera*>(inCameraRef);
+    camera->object_handler = inObjectEventHandler;
+    camera->object_event = inEvent;
+    camera->object_context = inContext;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSetPropertyEventHandler(EdsCameraRef inCameraRef, EdsPropertyEvent inEvent, EdsPropertyEventHandler inPropertyEventHandler, EdsVoid* inContext) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    MockCamera* camera = static_cast<MockCamera*>(inCameraRef);
+    camera->property_handler = inPropertyEventHandler;
+    camera->property_context = inContext;
+    return EDS_ERR_OK;
+}
+
+EdsError EDSAPI EdsSetCameraStateEventHandler(EdsCameraRef inCameraRef, EdsStateEvent inEvent, EdsStateEventHandler inStateEventHandler, EdsVoid* inContext) {
+    if (inCameraRef == NULL || inCameraRef->kind != MockKind::Camera) return EDS_ERR_INVALID_HANDLE;
+    MockCamera* camera = static_cast<MockCamera*>(inCameraRef);
+    camera->state_handler = inStateEventHandler;
+    camera->state_context = inContext;
+    return EDS_ERR_OK;
+}
+
+// Delivers the transfer requests of the shots whose shutter time has passed
+EdsError EDSAPI EdsGetEvent() {
+    struct Delivery {
+        MockCamera* camera;
+        MockDirectoryItem* item;
+    };
+    std::vector<Delivery> deliveries;
+    {
+        std::lock_guard<std::mutex> lock(sdk_mutex);
+        if (!sdk_initialized) return EDS_ERR_OK;
+        auto now = std::chrono::steady_clock::now();
+        for (__EdsObject* object : camera_list->children) {
+            MockCamera* camera = static_cast<MockCamera*>(object);
+            while (!camera->pending_shots.empty() && camera->pending_shots.front() <= now) {
+                camera->pending_shots.pop_front();
+                camera->shots++;
+
+                MockDirectoryItem* item = new MockDirectoryItem();
+                item->parent = camera;
+                item->payload = payloads[next_payload++ % payloads.size()];
+                char name[16];
+                std::snprintf(name, sizeof(name), "IMG_%04d.JPG", camera->shots);
+                item->name = name;
+                deliveries.push_back({ camera, item });
+            }
+        }
+    }
+
+    // Handlers run without the lock, they call back into the SDK
+    for (auto& delivery : deliveries) {
+        MockCamera* camera = delivery.camera;
+        bool wanted = camera->object_event == kEdsObjectEvent_All
+            || camera->object_event == kEdsObjectEvent_DirItemRequestTransfer;
+        if (camera->object_handler != nullptr && wanted) {
+            // The handler owns the item reference and releases it
+            camera->object_handler(kEdsObjectEvent_DirItemRequestTransfer, delivery.item, camera->object_context);
+        } else {
+            EdsRelease(delivery.item);
+        }
+    }
+    return EDS_ERR_OK;
+}
@@ -0,0 +1,142 @@
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "ImageQuality.h"
+
+ImageScore scoreGray(const unsigned char* data, int width, int height, size_t stride) {
+    ImageScore score;
+    score.width = width;
+    score.height = height;
+    if (width < 3 || height < 3) return score;
+
+    double lap_sum = 0, lap_sq = 0;
+    double gx_sum = 0, gx_sq = 0, gy_sum = 0, gy_sq = 0;
+    double magnitude_sum = 0;
+    double level_sum = 0;
+    int64_t clipped = 0;
+    std::vector<float> magnitude(width);
+
+    for (int r = 1; r < height - 1; r++) {
+        const unsigned char* up = data + (r - 1) * stride;
+        const unsigned char* row = data + r * stride;
+        const unsigned char* down = data + (r + 1) * stride;
+
+        // Integer sums of the row, exact and independent per pixel
+        int64_t row_lap = 0, row_lap_sq = 0;
+        int64_t row_gx = 0, row_gx_sq = 0, row_gy = 0, row_gy_sq = 0;
+        int64_t row_level = 0, row_clipped = 0;
+        for (int c = 1; c < width - 1; c++) {
+            int lap = up[c] + down[c] + row[c - 1] + row[c + 1] - 4 * row[c];
+            int gx = (up[c + 1] + 2 * row[c + 1] + down[c + 1]) - (up[c - 1] + 2 * row[c - 1] + down[c - 1]);
+            int gy = (down[c - 1] + 2 * down[c] + down[c + 1]) - (up[c - 1] + 2 * up[c] + up[c + 1]);
+            row_lap += lap;
+            row_lap_sq += lap * lap;
+            row_gx += gx;
+            row_gx_sq += gx * gx;
+            row_gy += gy;
+            row_gy_sq += gy * gy;
+            row_level += row[c];
+            row_clipped += (row[c] < 5) | (row[c] > 250);
+            magnitude[c] = static_cast<float>(gx * gx + gy * gy);
+        }
+        float row_magnitude = 0;
+        for (int c = 1; c < width - 1; c++) {
+            row_magnitude += std::sqrt(magnitude[c]);
+        }
+
+        lap_sum += static_cast<double>(row_lap);
+        lap_sq += static_cast<double>(row_lap_sq);
+        gx_sum += static_cast<double>(row_gx);
+        gx_sq += static_cast<double>(row_gx_sq);
+        gy_sum += static_cast<double>(row_gy);
+        gy_sq += static_cast<double>(row_gy_sq);
+        magnitude_sum += row_magnitude;
+        level_sum += static_cast<double>(row_level);
+        clipped += row_clipped;
+    }
+
+    double n = static_cast<double>(width - 2) * (height - 2);
+    auto deviation = [n](double sum, double sq) {
+        double mean = sum / n;
+        double variance = sq / n - mean * mean;
+        return variance > 0 ? std::sqrt(variance) : 0.0;
+    };
+    double lap_mean = lap_sum / n;
+    score.laplacian = lap_sq / n - lap_mean * lap_mean;
+    score.gradient = magnitude_sum / n;
+    score.directionality = std::abs(deviation(gx_sum, gx_sq) - deviation(gy_sum, gy_sq));
+    score.brightness = level_sum / n;
+    score.clipped = clipped / n;
+    return score;
+}
+
+// fftshift moves row (k + h - h / 2) % h to row k, the last 10 rows are the highest vertical frequencies
+double frequencySharpness(const cv::Mat& gray) {
+    cv::Mat input, spectrum;
+    gray.convertTo(input, CV_32F);
+    cv::dft(input, spectrum, cv::DFT_COMPLEX_OUTPUT);
+
+    int h = spectrum.rows;
+    double sum = 0;
+    int count = 0;
+    for (int k = (h > 10 ? h - 10 : 0); k < h; k++) {
+        const cv::Vec2f* row = spectrum.ptr<cv::Vec2f>((k + h - h / 2) % h);
+        for (int c = 0; c < spectrum.cols; c++) {
+            double magnitude = std::sqrt(row[c][0] * row[c][0] + row[c][1] * row[c][1]);
+            sum += 20 * std::log(magnitude + 1e-12);
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+ImageScore scoreImage(const std::string& file, int reduction, bool frequency) {
+    int flag = cv::IMREAD_GRAYSCALE;
+    if (reduction == 2) flag = cv::IMREAD_REDUCED_GRAYSCALE_2;
+    else if (reduction == 4) flag = cv::IMREAD_REDUCED_GRAYSCALE_4;
+    else if (reduction == 8) flag = cv::IMREAD_REDUCED_GRAYSCALE_8;
+
+    auto start = std::chrono::steady_clock::now();
+    cv::Mat gray = cv::imread(file, flag);
+    auto decoded = std::chrono::steady_clock::now();
+    if (gray.empty()) return ImageScore();
+
+    ImageScore score = scoreGray(gray.data, gray.cols, gray.rows, gray.step);
+    if (frequency) {
+        score.frequency = frequencySharpness(gray);
+    }
+    auto end = std::chrono::steady_clock::now();
+    score.decode_ms = std::chrono::duration<double, std::milli>(decoded - start).count();
+    score.score_ms = std::chrono::duration<double, std::milli>(end - decoded).count();
+    return score;
+}
+
+double metricValue(const ImageScore& score, const std::string& metric) {
+    if (metric == "laplacian") return score.laplacian;
+    if (metric == "frequency") return score.frequency;
+    return score.gradient;
+}
+
+double QualityTracker::add(const std::string& camera, double value, int min_samples) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Running& running = cameras[camera];
+    double z = 0;
+    if (running.count >= min_samples && running.count > 1) {
+        double deviation = std::sqrt(running.m2 / running.count);
+        if (deviation > 0) z = (value - running.mean) / deviation;
+    }
+
+    // Welford update
+    running.count++;
+    double delta = value - running.mean;
+    running.mean += delta / running.count;
+    running.m2 += delta * (value - running.mean);
+    return z;
+}
+
+void QualityTracker::reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    cameras.clear();
+}
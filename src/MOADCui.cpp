@@ -5,6 +5,8 @@
 #include <regex>
 #include <fstream>
 #include <map>
+#include <set>
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -12,6 +14,7 @@
 #include <mutex>
 #include <memory>
 #include <chrono>
+#include <future>
 #include <opencv2/opencv.hpp>
 #include <nlohmann/json.hpp>
 
@@ -19,19 +22,24 @@
 #include "ConfigHandler.h"
 #include "CanonHandler.h"
 #include "RealSenseHandler.h"
-#include "ThreadPool.h"
+#include "Scheduler.h"
+#include "ScanManifest.h"
+#include "ScanArchive.h"
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "tabulate.hpp"
 #include "EDSDK.h"
 #include "EDSDKTypes.h"
 #include "Download.h"
 #include "DownloadEvf.h"
 #include "PreSetting.h"
+#include "DeviceStartup.h"
 #include "PressShutter.h"
 #include "Property.h"
 #include "TakePicture.h"
-#include "SimpleSerial.h"
+#include "TurntableSerial.h"
 #include "CameraException.h"
 
 #define CAMERA_1 "352074022019"
@@ -52,18 +60,20 @@ int degree_tracker = 0;
 
 std::string scan_folder;
 
+// Per pose scan metadata (saved as scan_info.json)
+nlohmann::json scan_info;
+
 // Liveview Threads
 std::vector<std::thread> liveview_th;
 bool liveview_active = false;
 std::thread::id liveview_thread_id;
 
 // Camera
-std::map<EdsCameraRef, std::string> camera_name;
 bool all_cameras = true;
 EdsCameraRef activeCamera;
 
 RealSenseHandler rshandle;
-SimpleSerial* Serial;
+TurntableSerial* turntable;
 
 // Menu
 MenuHandler* curr_menu;
@@ -89,43 +99,55 @@ int get_dslr_timeout() {
 	return dslr_timeout;
 }
 
-void loadJsonConfig(std::string path) {
-	ConfigHandler& config = ConfigHandler::getInstance();
-	std::optional<bool> previous_DSLR;
-	std::optional<bool> previous_RS;
+// Prints the startup steps of the devices brought up since the last report
+void printStartupReport() {
+	std::vector<StartupResult> results = StartupReport::getInstance().take();
+	if (results.empty()) return;
 
-	// Check if config is initialized
-	if (!config.emptyConfig()) {
-		// Get the previous values of DSLR and RealSense collection settings
-		previous_DSLR = config.getValue<bool>("dslr.collect_dslr");
-		previous_RS = config.getValue<bool>("realsense.collect_realsense");
+	tabulate::Table table;
+	table.add_row({"Device", "Step", "Status", "Attempts", "Time (ms)"});
+	for (const auto& result : results) {
+		table.add_row({result.kind + " " + result.device, result.step, result.ok ? "OK" : result.error,
+			std::to_string(result.attempts), std::to_string(static_cast<int>(result.ms))});
 	}
+	std::cout << "\nDevice startup:\n" << table << std::endl;
+}
+
+// Loads a config file. Devices stay open across reloads: they are only initialized the first time
+// their collection is enabled, and a reload applies the RealSense settings to the running pipelines,
+// restarting them only if the stream settings changed.
+void loadJsonConfig(std::string path) {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	auto start = std::chrono::steady_clock::now();
 
 	// Load the configuration from the specified path
 	config.loadConfig(path);
+	// Threads of the capture, processing and file work (the old queues finish their tasks first)
+	Scheduler::getInstance().configure();
 
-	// Check if the configuration has changed for DSLR
-	if (!previous_DSLR.has_value() || previous_DSLR != config.getValue<bool>("dslr.collect_dslr")) {
+	if (config.getValue<bool>("dslr.collect_dslr") && !canonhandle.isSDKLoaded) {
 		std::cout << "Initializing CanonHandler" << std::endl;
-		if (config.getValue<bool>("dslr.collect_dslr") && !canonhandle.isSDKLoaded) {
-			initializeCanon();
-		}
+		initializeCanon();
 	}
-	
-	// Check if the configuration has changed for RealSense
-	if (!previous_RS.has_value() || previous_RS != config.getValue<bool>("realsense.collect_realsense")) {
-		std::cout << "Initializing RealSenseHandler" << std::endl;
-		if (config.getValue<bool>("realsense.collect_realsense")) {
+
+	if (config.getValue<bool>("realsense.collect_realsense")) {
+		if (!rshandle.is_initialized()) {
+			std::cout << "Initializing RealSenseHandler" << std::endl;
 			initializeRealsense();
+		} else if (rshandle.apply_config()) {
+			rshandle.get_frames(config.getValue<int>("realsense.warmup_frames"));
 		}
 	}
 
 	// Set the object name from the configuration
 	std::string object_name = config.getValue<std::string>("object_name");
 	setObjectName(object_name);
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	printStartupReport();
+	std::cout << "Config " << path << " loaded in " << ms << " ms" << std::endl;
 }
 
-void saveCameraConfig(std::string path) {
+void saveCameraConfig(std::string path, std::chrono::milliseconds duration) {
 	std::vector<std::tuple<EdsPropertyID, std::map<EdsUInt32, const char*>>> propertyIDs = {
 		std::tuple<EdsPropertyID, std::map<EdsUInt32, const char*>> (kEdsPropID_ISOSpeed, iso_table),
 		std::tuple<EdsPropertyID, std::map<EdsUInt32, const char*>> (kEdsPropID_Tv, tv_table),
@@ -138,7 +160,7 @@ void saveCameraConfig(std::string path) {
 
 	// Get the model and focal length for each camera
 	for (auto& camera : canonhandle.cameraArray) {
-		std::string cam = camera_name[camera];
+		std::string cam = canonhandle.camera_label(camera);
 		EdsDeviceInfo deviceInfo;
 		EdsGetDeviceInfo(camera, &deviceInfo);
 		json_data[cam]["Model"] = deviceInfo.szDeviceDescription; 
@@ -154,11 +176,16 @@ void saveCameraConfig(std::string path) {
 		GetProperty(canonhandle.cameraArray, canonhandle.bodyID, std::get<0>(propertyID), out_table, value_arr);
 		
 		for (auto& camera : canonhandle.cameraArray) {
-			std::string cam = camera_name[camera];
+			std::string cam = canonhandle.camera_label(camera);
 			json_data[cam][name] = value_arr[0];
 		}
 	}
 
+	// Add the scan time
+	std::string minutes = std::to_string(duration.count() / 60000);
+	std::string seconds = std::to_string((duration.count() % 60000) / 1000);
+	json_data["Scan Time"] = minutes + ":" + seconds;
+
 	// Save the file as a JSON file
 	std::string output_file = "/camera_config.json";
     std::ofstream file(path + output_file);
@@ -171,38 +198,17 @@ void saveCameraConfig(std::string path) {
 	}
 }
 
-void saveScanTime(std::chrono::milliseconds duration, std::string path) {
-	// Get the given duration in minutes and seconds
-	std::string minutes = std::to_string(duration.count() / 60000);
-	std::string seconds = std::to_string((duration.count() % 60000) / 1000);
-
-	// Open the JSON file for writing
-	std::ifstream file(path + "/camera_config.json");
-	if (!file.is_open()) {
-		std::cerr << "Failed to open file for writing: " << path + "/camera_config.json" << std::endl;
-		return;
-	}
-	nlohmann::json json_data;
-	file >> json_data;
-
-	// Add the scan time to the JSON data
-	json_data["Scan Time"] = minutes + ":" + seconds;
-
-	// Save the updated JSON data back to the file
-	std::ofstream output_file(path + "/camera_config.json");
-	if (output_file.is_open()) {
-		output_file << json_data.dump(4); // Pretty print with 4 spaces indentation
-		output_file.close();
-		std::cout << "Scan time saved to camera_config.json" << std::endl;
+void saveScanInfo(std::string path) {
+	std::ofstream file(path + "/scan_info.json");
+	if (file.is_open()) {
+		file << scan_info.dump(4); // Pretty print with 4 spaces indentation
+		file.close();
+		std::cout << "Scan info saved to scan_info.json" << std::endl;
 	} else {
-		std::cerr << "Failed to open file for writing: " << path + "/camera_config.json" << std::endl;
+		std::cerr << "Failed to open file for writing: " << path + "/scan_info.json" << std::endl;
 	}
-
-	// Close the file
-	file.close();
 }
 
-
 void CheckKey()// After key is entered, _ endthread is automatically called.
 {
 	std::cin >> control_number;
@@ -330,75 +336,241 @@ char get_last_pose() {
 	return last_pose + 1; 
 }
 
-void scan(ThreadPool* pool = nullptr) {
+// Name of a DSLR in the file names and the scan manifest
+std::string dslr_name(size_t index) {
+	return "cam" + (canonhandle.rename_cameras ? canonhandle.camera_name(index) : std::to_string(index + 1));
+}
+
+// Captures the current angle. When cameras is not empty, only the named cameras are captured
+// (used to resume a scan). With background set, it returns while the RealSense framesets are
+// still being processed.
+void scan(bool background = false, bool defer_downloads = false, const std::set<std::string>& cameras = {}) {
 	ConfigHandler& config = ConfigHandler::getInstance();
 	std::string object_name = config.getValue<std::string>("object_name");
 	std::string output_dir = config.getValue<std::string>("output_dir");
 	scan_folder = output_dir + "/" + object_name;
+
+	// Check which kind of cameras are needed
+	bool rs_wanted = cameras.empty();
+	bool dslr_wanted = cameras.empty();
+	for (const auto& name : cameras) {
+		if (name.rfind("cam", 0) == 0) dslr_wanted = true;
+		else rs_wanted = true;
+	}
+	rshandle.only_cameras = cameras;
 	
 	// Collect RealSense Data
-	if(config.getValue<bool>("realsense.collect_realsense")) {
+	if(config.getValue<bool>("realsense.collect_realsense") && rs_wanted) {
 		// Create RS Scan Folder
-		rshandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\realsense";
+		rshandle.save_dir = scan_folder + "/pose-" + curr_pose + "/realsense";
 		create_folder(rshandle.save_dir, true);
 
 		// Get the current frame from RealSense
 		int rs_timeout = get_rs_timeout();
 		rshandle.turntable_position = degree_tracker;
-		rshandle.get_current_frame(degree_tracker, rs_timeout, pool);
+		rshandle.get_current_frame(degree_tracker, rs_timeout, background);
+		if (!rshandle.last_sync_info.empty()) {
+			scan_info["angles"][std::to_string(degree_tracker)]["realsense_sync"] = rshandle.last_sync_info;
+		}
 		if (rshandle.fail_count > 0) {
 			cout << "RS Failure - " << rshandle.fail_count << endl;
 		}
 	}
 
 	// Collect DSLR Data
-	if(config.getValue<bool>("dslr.collect_dslr")) {
+	if(config.getValue<bool>("dslr.collect_dslr") && dslr_wanted) {
 		canonhandle.images_downloaded = 0;
 		
 		// Create DSLR Scan Folder
-		canonhandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\DSLR";
+		canonhandle.save_dir = scan_folder + "/pose-" + curr_pose + "/DSLR";
 		create_folder(canonhandle.save_dir,true);
 		
 		// Take pictures with DSLR
 		cout << "Getting DSLR Data...\n";
 		canonhandle.turntable_position = degree_tracker;
-		for (auto& camera : canonhandle.cameraArray) {
-			std::string cam_name = camera_name[camera];
+		canonhandle.defer_downloads = defer_downloads;
+		canonhandle.shot_ms = ScanManifest::nowMs();
+		// Scores of the previous angle are done by now
+		canonhandle.wait_quality();
+		canonhandle.take_reshoots();
+		DeviceRegistry& registry = DeviceRegistry::getInstance();
+		std::vector<int> handled(canonhandle.cameraArray.size(), -1);
+		int expected = canonhandle.cameras_found;
+		if (!cameras.empty()) expected = 0;
+		for (size_t index = 0; index < canonhandle.cameraArray.size(); index++) {
+			if (!cameras.empty()) {
+				if (cameras.count(dslr_name(index)) == 0) continue;
+				expected++;
+			}
+			int id = index < canonhandle.camera_ids.size() ? canonhandle.camera_ids[index] : -1;
+			if (id >= 0) {
+				handled[index] = registry.stats(id).captures + registry.stats(id).failures;
+			}
 			EdsError err = EDS_ERR_OK;
-			err = TakePicture(camera, cam_name);
+			err = TakePicture(canonhandle.cameraArray[index], canonhandle.camera_name(index));
+			// The body can still be busy with the previous shot, try again a few times
+			for (int retry = 0; err == EDS_ERR_DEVICE_BUSY && retry < 3; retry++) {
+				if (id >= 0) registry.stats(id).retries++;
+				std::this_thread::sleep_for(100ms);
+				err = TakePicture(canonhandle.cameraArray[index], canonhandle.camera_name(index));
+			}
 		}
 
-		// Collecting images from DSLR
-		int c = 0;
+		// Collecting images from DSLR (or only the transfer requests if downloads are deferred)
 		int dslr_timeout = get_dslr_timeout();
-		while (canonhandle.images_downloaded < canonhandle.cameras_found && c < dslr_timeout) {
-			EdsGetEvent();
-			std::this_thread::sleep_for(50ms);
-			c++;
+		auto wait_for_images = [dslr_timeout](int count) {
+			int c = 0;
+			while (canonhandle.images_downloaded + (int)canonhandle.pending_transfers.size() < count && c < dslr_timeout) {
+				EdsGetEvent();
+				std::this_thread::sleep_for(50ms);
+				c++;
+			}
+			cout << "DSLR Timeout Count: " << c << "/" << dslr_timeout << endl;
+		};
+		wait_for_images(expected);
+
+		// Shoot the cameras with a blurry image again before the turntable moves
+		if (!defer_downloads && config.getValue<bool>("dslr.quality.enable") && config.getValue<bool>("dslr.quality.reshoot")) {
+			int max_reshoots = config.getValue<int>("dslr.quality.max_reshoots");
+			for (int round = 0; round < max_reshoots; round++) {
+				canonhandle.wait_quality();
+				std::vector<size_t> indices = canonhandle.take_reshoots();
+				if (indices.empty()) break;
+				canonhandle.images_downloaded = 0;
+				for (size_t index : indices) {
+					cout << "Reshooting " << dslr_name(index) << " at angle " << degree_tracker << endl;
+					if (canonhandle.camera_ids[index] >= 0) registry.stats(canonhandle.camera_ids[index]).retries++;
+					TakePicture(canonhandle.cameraArray[index], canonhandle.camera_name(index));
+				}
+				wait_for_images(static_cast<int>(indices.size()));
+			}
+		}
+
+		// Count the images that never arrived (deferred downloads have not run yet)
+		if (!defer_downloads) {
+			for (size_t index = 0; index < handled.size(); index++) {
+				int id = canonhandle.camera_ids[index];
+				if (handled[index] >= 0 && registry.stats(id).captures + registry.stats(id).failures == handled[index]) {
+					registry.stats(id).dropped++;
+				}
+			}
 		}
-		cout << "DSLR Timeout Count: " << c << "/" << dslr_timeout << endl;
 	}
 }
 
-void rotate_turntable(int degree_inc) {
-	// Issue command to move turntable.
+// Sends the move command to the turntable without waiting for the reply
+std::future<nlohmann::json> issue_rotation(int degree_inc) {
+	int timeout_ms = TurntableSerial::moveTimeoutMs(degree_inc);
+	cout << "Moving: " << degree_inc << " degrees, waiting up to " << timeout_ms << " ms.\n";
+	return turntable->rotate(degree_inc, timeout_ms);
+}
+
+// Waits for the turntable reply of an issued move and for the object to settle
+void finish_rotation(std::future<nlohmann::json>& move, int degree_inc) {
 	ConfigHandler& config = ConfigHandler::getInstance();
-	std::string degree_inc_str = std::to_string(degree_inc);
-	char *send = &degree_inc_str[0];
-	bool is_sent = Serial->WriteSerialPort(send);
-
-	if (is_sent) {
-		int wait_time = std::ceil(((abs(degree_inc)*200)+500)/1000)+5;
-		cout << "Message sent, moving: " << degree_inc << " degrees, waiting up to " << wait_time << " seconds.\n";
-		std::string incoming = Serial->ReadSerialPort(wait_time, "json");
-		cout << "Incoming: " << incoming;// << endl;
-		// std::this_thread::sleep_for(250ms);
-		
-		int turntable_delay_ms = config.getValue<int>("turntable_delay_ms");
-		std::this_thread::sleep_for(std::chrono::milliseconds(turntable_delay_ms));
+	try {
+		nlohmann::json incoming = move.get();
+		cout << "Incoming: " << incoming.dump() << endl;
+	} catch (const std::exception& e) {
+		cout << "WARNING: Turntable move failed, something went wrong: " << e.what() << endl;
+		return;
+	}
+
+	// Wait for the object to settle, the fixed delay is the upper bound
+	int turntable_delay_ms = config.getValue<int>("turntable_delay_ms");
+	int settle_ms = turntable_delay_ms;
+	if (config.getValue<bool>("turntable_settle.adaptive") && config.getValue<bool>("realsense.collect_realsense")) {
+		settle_ms = rshandle.wait_for_settle(turntable_delay_ms);
+		cout << "Turntable settled after " << settle_ms << " ms.\n";
 	} else {
-		cout << "WARNING: Serial command not sent, something went wrong.\n";
+		std::this_thread::sleep_for(std::chrono::milliseconds(turntable_delay_ms));
 	}
+	scan_info["angles"][std::to_string(degree_tracker + degree_inc)]["settle_ms"] = settle_ms;
+}
+
+void rotate_turntable(int degree_inc) {
+	// Issue command to move turntable and wait for it.
+	std::future<nlohmann::json> move = issue_rotation(degree_inc);
+	finish_rotation(move, degree_inc);
+}
+
+// Checks if the next move can be issued as soon as scan() returns. The RealSense framesets
+// are in by then with either capture, only their processing runs in the background.
+bool pipelineMoves() {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	return config.getValue<bool>("turntable_serial.pipeline");
+}
+
+// Captures num_moves angles, rotating the turntable degree_inc degrees after each one
+void runScanLoop(int degree_inc, int num_moves) {
+	bool pipeline = pipelineMoves();
+	// Compose the RealSense transforms of every angle up front
+	rshandle.prepare_scan(degree_tracker, degree_inc, num_moves);
+	for (int rots = 0; rots < num_moves; rots++)
+	{
+		auto angle_start = std::chrono::steady_clock::now();
+		// Scan all the cameras
+		scan(true, pipeline);
+		auto capture_end = std::chrono::steady_clock::now();
+		if (pipeline) {
+			// Capture is done, move while the DSLR images are downloaded
+			std::future<nlohmann::json> move = issue_rotation(degree_inc);
+			canonhandle.download_pending();
+			finish_rotation(move, degree_inc);
+		} else {
+			// Rotate the turntable
+			rotate_turntable(degree_inc);
+		}
+		auto angle_end = std::chrono::steady_clock::now();
+
+		// Record the angle timings
+		nlohmann::json& angle_info = scan_info["angles"][std::to_string(degree_tracker)];
+		angle_info["capture_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(capture_end - angle_start).count();
+		angle_info["move_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(angle_end - capture_end).count();
+		angle_info["angle_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(angle_end - angle_start).count();
+
+		// Update the degree tracker
+		degree_tracker += degree_inc;
+		cout << "Image " << rots+1 << "/" << num_moves << " taken. " << endl;
+	}
+	canonhandle.defer_downloads = false;
+}
+
+// An angle of a resumed scan and the cameras with missing files there
+struct ResumeStep {
+	int angle;
+	std::set<std::string> cameras;
+};
+
+struct ResumePlan {
+	int start_angle = 0;
+	std::vector<ResumeStep> steps;		// In scan order
+};
+
+// Turns the turntable forward to the given scan angle
+void move_to_angle(int angle) {
+	int delta = ((angle - degree_tracker) % 360 + 360) % 360;
+	if (delta != 0) {
+		rotate_turntable(delta);
+	}
+	degree_tracker = angle;
+}
+
+// Captures only the missing cameras of a resumed scan. The turntable goes straight to each angle
+// with missing files and ends where the full scan would have ended.
+void runResumeLoop(int degree_inc, int num_moves, const ResumePlan& plan) {
+	rshandle.prepare_scan(plan.start_angle, degree_inc, num_moves);
+	for (size_t step = 0; step < plan.steps.size(); step++) {
+		move_to_angle(plan.steps[step].angle);
+		auto angle_start = std::chrono::steady_clock::now();
+		scan(true, false, plan.steps[step].cameras);
+		auto capture_end = std::chrono::steady_clock::now();
+		scan_info["angles"][std::to_string(degree_tracker)]["capture_ms"] =
+			std::chrono::duration_cast<std::chrono::milliseconds>(capture_end - angle_start).count();
+		cout << "Angle " << step + 1 << "/" << plan.steps.size() << " resumed." << endl;
+	}
+	rshandle.only_cameras.clear();
+	move_to_angle(plan.start_angle + degree_inc * num_moves);
 }
 
 bool generateTransform(int degree_inc, int num_moves) {
@@ -443,15 +615,137 @@ bool generateTransform(int degree_inc, int num_moves) {
 	return false;
 }
 
+// Scans the current pose (num_moves angles, degree_inc apart) and saves the scan metadata.
+// With a resume plan only its missing angles and cameras are captured.
+// Returns the duration of the capture loop.
+std::chrono::milliseconds runPoseScan(int degree_inc, int num_moves, const ResumePlan* resume = nullptr) {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	std::chrono::milliseconds duration;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	scan_folder = config.getValue<std::string>("output_dir") + "/" + config.getValue<std::string>("object_name");
+	std::string pose_dir = scan_folder + "/pose-" + curr_pose;
+	create_folder(pose_dir, true);
+
+	// Reset the scan metadata for this pose, a resumed scan keeps the saved one
+	scan_info = nlohmann::json::object();
+	std::ifstream saved_info(pose_dir + "/scan_info.json");
+	if (resume != nullptr && saved_info.is_open()) {
+		scan_info = nlohmann::json::parse(saved_info, nullptr, false);
+		if (scan_info.is_discarded()) scan_info = nlohmann::json::object();
+	}
+	saved_info.close();
+	scan_info["degree_inc"] = degree_inc;
+	scan_info["num_moves"] = num_moves;
+
+	// Start the manifest of the pose, the files are added to it as they are saved
+	nlohmann::json manifest_scan;
+	manifest_scan["object_name"] = config.getValue<std::string>("object_name");
+	manifest_scan["pose"] = std::string("pose-") + curr_pose;
+	manifest_scan["start_angle"] = resume != nullptr ? resume->start_angle : degree_tracker;
+	if (resume != nullptr) manifest_scan["resume"] = true;
+	manifest_scan["degree_inc"] = degree_inc;
+	manifest_scan["num_moves"] = num_moves;
+	manifest_scan["cameras"] = nlohmann::json::array();
+	DeviceRegistry& registry = DeviceRegistry::getInstance();
+	if (config.getValue<bool>("realsense.collect_realsense")) {
+		for (int slot = 0; slot < registry.count(DeviceKind::RealSense); slot++) {
+			int id = registry.id(DeviceKind::RealSense, slot);
+			if (registry.state(id) != DeviceState::Offline) manifest_scan["cameras"].push_back(registry.info(id).name);
+		}
+	}
+	if (config.getValue<bool>("dslr.collect_dslr")) {
+		for (size_t index = 0; index < canonhandle.cameraArray.size(); index++) {
+			manifest_scan["cameras"].push_back(dslr_name(index));
+		}
+	}
+	ScanManifest::getInstance().open(pose_dir, manifest_scan);
+
+	// Archive the files of the pose as they are saved, <object>_pose-<x>.moadpack
+	if (config.getValue<bool>("archive.enable")) {
+		ArchiveOptions archive_options;
+		archive_options.level = config.getValue<int>("archive.level");
+		archive_options.block_size = static_cast<size_t>(config.getValue<int>("archive.block_mb")) << 20;
+		archive_options.pool = &Scheduler::getInstance().queue("io");
+		std::vector<std::string> store = config.getValue<std::vector<std::string>>("archive.store_extensions");
+		archive_options.store_extensions = std::set<std::string>(store.begin(), store.end());
+		std::string archive_dir = config.getValue<std::string>("archive.dir");
+		if (archive_dir.empty()) archive_dir = scan_folder;
+		create_folder(archive_dir, true);
+		std::string archive_name = config.getValue<std::string>("object_name") + "_pose-" + curr_pose + ScanArchive::extension;
+		ScanArchive::getInstance().open(archive_dir + "/" + archive_name, pose_dir, archive_options);
+	}
+
+	// Show the live device counters of this pose while scanning, the failures are counted per pose
+	registry.resetStats();
+	rshandle.fail_count = 0;
+	canonhandle.quality.reset();
+	rshandle.reset_frame_latency();
+	if (curr_menu != nullptr) {
+		curr_menu->StartStatus(config.getValue<int>("status_refresh_ms"));
+	}
+
+	// Start the loop timer
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		if (resume != nullptr) {
+			runResumeLoop(degree_inc, num_moves, *resume);
+		} else {
+			runScanLoop(degree_inc, num_moves);
+		}
+		// Stop the loop timer
+		auto end = std::chrono::high_resolution_clock::now();
+		// Calculate the elapsed time
+		duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+		// Convert the duration to minutes, seconds, and milliseconds
+		int minutes = duration.count() / 60000;
+		int seconds = (duration.count() % 60000) / 1000;
+		cout << "Scan Time: " << std::setfill('0') << std::setw(2) << minutes << ":" 
+			<< std::setfill('0') << std::setw(2) << seconds << endl;
+		cout << "RS Fail Count: " << rshandle.fail_count << endl;
+		cout << "Waiting for background processing...\n";
+		// Wait for the frameset processing and the image scores
+		Scheduler::getInstance().waitIdle("cpu");
+		canonhandle.wait_quality();
+	}
+	auto processed = std::chrono::high_resolution_clock::now();
+	if (curr_menu != nullptr) {
+		curr_menu->StopStatus();
+	}
+	scan_info["scan_ms"] = duration.count();
+	scan_info["total_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(processed - start).count();
+	scan_info["rs_fail_count"] = rshandle.fail_count.load();
+	// Frame latency of the RealSense frame threads, to compare capture core and priority settings
+	nlohmann::json latency = rshandle.frame_latency();
+	for (const auto& device : latency.items()) {
+		cout << "[" << device.key() << "] frame latency p50 " << device.value()["p50_ms"].get<double>() << " ms, p99 "
+			<< device.value()["p99_ms"].get<double>() << " ms, jitter " << device.value()["jitter_ms"].get<double>() << " ms\n";
+	}
+	if (!latency.empty()) scan_info["realsense_latency"] = latency;
+
+	nlohmann::json manifest_summary;
+	manifest_summary["scan_ms"] = scan_info["scan_ms"];
+	manifest_summary["total_ms"] = scan_info["total_ms"];
+	manifest_summary["rs_fail_count"] = scan_info["rs_fail_count"];
+	ScanManifest::getInstance().close(manifest_summary);
+
+	// Save camera configurations in a json file
+	if (config.getValue<bool>("dslr.collect_dslr")) {
+		saveCameraConfig(pose_dir, duration);
+	}
+	saveScanInfo(pose_dir);
+	// Adds the metadata files and the files of a resumed scan, then writes the index
+	ScanArchive::getInstance().close();
+
+	return duration;
+}
+
 bool customScan() {
 	ConfigHandler& config = ConfigHandler::getInstance();
 	if (liveview_active){
 		std::cout << "Liveview is active, please stop it before scanning." << std::endl;
 		return false;
 	}
-	// Create the thread pool
-	int thread_num = config.getValue<int>("thread_num");
-	ThreadPool pool(thread_num);
 	int degree_inc;
 	int num_moves = 0;
 
@@ -461,37 +755,7 @@ bool customScan() {
 	cout << "Enter number of moves: ";
 	std::cin >> num_moves;
 	
-	Sleep(200);
-	// Start the loop timer
-	auto start = std::chrono::high_resolution_clock::now();
-	for (int rots = 0; rots < num_moves; rots++)
-	{
-		// Scan all the cameras
-		scan(&pool);
-		// Rotate the turntable
-		rotate_turntable(degree_inc);
-		
-		// Update the degree tracker 
-		degree_tracker += degree_inc;
-		cout << "Image " << rots+1 << "/" << num_moves << " taken. " << endl;
-	}
-	// Stop the loop timer
-	auto end = std::chrono::high_resolution_clock::now();
-	// Calculate the elapsed time
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-	// Convert the duration to minutes, seconds, and milliseconds
-	int minutes = duration.count() / 60000;
-	int seconds = (duration.count() % 60000) / 1000;
-	cout << "Scan Time: " << std::setfill('0') << std::setw(2) << minutes << ":" 
-		<< std::setfill('0') << std::setw(2) << seconds << endl;
-	cout << "RS Fail Count: " << rshandle.fail_count << endl;
-	std::this_thread::sleep_for(3000ms);
-
-	// Save camera configurations in a json file
-	if (config.getValue<bool>("dslr.collect_dslr")) {
-		saveCameraConfig(scan_folder + "\\pose-" + curr_pose);
-		saveScanTime(duration, scan_folder + "\\pose-" + curr_pose);
-	}
+	runPoseScan(degree_inc, num_moves);
 
 	// Generate transform
 	generateTransform(degree_inc, num_moves);
@@ -516,42 +780,10 @@ bool fullScan() {
 		return false;
 	}
 
-	// Create thread pool
-	int thread_num = config.getValue<int>("thread_num");
-	ThreadPool pool(thread_num);
-
 	int degree_inc = config.getValue<int>("degree_inc");
 	int num_moves = config.getValue<int>("num_moves");
 	
-	Sleep(200);
-	// Start the loop timer
-	auto start = std::chrono::high_resolution_clock::now();
-	for (int rots = 0; rots < num_moves; rots++)
-	{
-		// Scan all the cameras
-		scan(&pool);
-		// Rotate the turntable
-		rotate_turntable(degree_inc);
-		
-		// Update the degree tracker
-		degree_tracker += degree_inc;
-		cout << "Image " << rots+1 << "/" << num_moves << " taken. " << endl;
-	}
-	// Stop the loop timer
-	auto end = std::chrono::high_resolution_clock::now();
-	// Calculate the elapsed time
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-	// Convert the duration to minutes, seconds, and milliseconds
-	int minutes = duration.count() / 60000;
-	int seconds = (duration.count() % 60000) / 1000;
-	cout << "Scan Time: " << std::setfill('0') << std::setw(2) << minutes << ":" 
-	<< std::setfill('0') << std::setw(2) << seconds << endl;
-	cout << "RS Fail Count: " << rshandle.fail_count << endl;
-	std::this_thread::sleep_for(3000ms);
-	
-	// Save camera configurations in a json file
-	saveCameraConfig(scan_folder + "\\pose-" + curr_pose);
-	saveScanTime(duration, scan_folder + "\\pose-" + curr_pose);
+	runPoseScan(degree_inc, num_moves);
 
 	// Generate transform
 	generateTransform(degree_inc, num_moves);
@@ -569,20 +801,391 @@ bool fullScan() {
 	return true;
 }
 
-// TODO: Check Degree Tracker
-bool collectSampleData() {
+// Returns the last pose folder of the object with saved files, 0 if there is none
+char get_resume_pose() {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	std::string path = config.getValue<std::string>("output_dir") + "/" + config.getValue<std::string>("object_name");
+	char resume_pose = 0;
+	if (!fs::is_directory(path)) {
+		return resume_pose;
+	}
+
+	for (const auto& entry : fs::directory_iterator(path)) {
+		std::string name = entry.path().filename().string();
+		if (!entry.is_directory() || name.rfind("pose-", 0) != 0 || name.length() != 6) continue;
+		for (const auto& file : fs::recursive_directory_iterator(entry.path())) {
+			if (file.is_regular_file()) {
+				if (name[5] > resume_pose) resume_pose = name[5];
+				break;
+			}
+		}
+	}
+	return resume_pose;
+}
+
+// Finds the angles and cameras of the last pose that are missing files (from its scan manifest
+// or the saved file names) and captures only those.
+bool resumeScan() {
 	ConfigHandler& config = ConfigHandler::getInstance();
 	if (liveview_active){
 		std::cout << "Liveview is active, please stop it before scanning." << std::endl;
 		return false;
 	}
+	char pose = get_resume_pose();
+	if (pose == 0) {
+		cout << "No scanned pose to resume." << endl;
+		return false;
+	}
+	std::string pose_dir = config.getValue<std::string>("output_dir") + "/" + config.getValue<std::string>("object_name") + "/pose-" + pose;
+	PoseProgress progress = ScanManifest::readProgress(pose_dir);
+
+	// Scan parameters from the manifest, the config and the first saved angle without one
+	int degree_inc = progress.scan.value("degree_inc", config.getValue<int>("degree_inc"));
+	int num_moves = progress.scan.value("num_moves", config.getValue<int>("num_moves"));
+	ResumePlan plan;
+	plan.start_angle = progress.scan.value("start_angle", progress.files.empty() ? 0 : progress.files.begin()->first);
+
+	// Files expected from every connected camera
+	std::map<std::string, std::set<std::string>> expected;
+	if (config.getValue<bool>("realsense.collect_realsense")) {
+		std::set<std::string> types;
+		if (config.getValue<bool>("realsense.collect_pointcloud")) types.insert("cloud");
+		if (config.getValue<bool>("realsense.collect_color")) types.insert("color");
+		if (config.getValue<bool>("realsense.collect_depth")) types.insert("depth");
+		DeviceRegistry& registry = DeviceRegistry::getInstance();
+		for (int slot = 0; slot < registry.count(DeviceKind::RealSense) && !types.empty(); slot++) {
+			int id = registry.id(DeviceKind::RealSense, slot);
+			if (registry.state(id) != DeviceState::Offline) expected[registry.info(id).name] = types;
+		}
+	}
+	if (config.getValue<bool>("dslr.collect_dslr")) {
+		for (size_t index = 0; index < canonhandle.cameraArray.size(); index++) {
+			expected[dslr_name(index)] = { "img" };
+		}
+	}
+
+	// Angles with missing camera files
+	for (int rots = 0; rots < num_moves; rots++) {
+		ResumeStep step;
+		step.angle = plan.start_angle + rots * degree_inc;
+		auto saved = progress.files.find(step.angle);
+		for (const auto& camera : expected) {
+			bool complete = saved != progress.files.end() && saved->second.count(camera.first) > 0 &&
+				std::includes(saved->second.at(camera.first).begin(), saved->second.at(camera.first).end(),
+					camera.second.begin(), camera.second.end());
+			if (!complete) step.cameras.insert(camera.first);
+		}
+		if (!step.cameras.empty()) plan.steps.push_back(step);
+	}
+
+	cout << "pose-" << pose << ": " << num_moves << " moves of " << degree_inc << " degrees from " << plan.start_angle
+		<< (progress.scan.empty() ? " (no manifest, using the file names)" : "")
+		<< (!progress.scan.empty() && !progress.finished ? ", the last scan was interrupted" : "") << endl;
+	if (plan.steps.empty()) {
+		cout << "All the angles are complete, nothing to resume." << endl;
+		return false;
+	}
+	cout << plan.steps.size() << " angles have missing files, the first one is " << plan.steps[0].angle
+		<< " (" << plan.steps[0].cameras.size() << " cameras)." << endl;
+
+	// The turntable position is only known while the program runs
+	cout << "Enter the current turntable angle (" << degree_tracker % 360 << " if it was not moved): ";
+	std::cin >> degree_tracker;
+
+	curr_pose = pose;
+	object_info["Pose"] = curr_pose;
+	runPoseScan(degree_inc, num_moves, &plan);
 
-	// Create thread pool
-	int thread_num = config.getValue<int>("thread_num");
-	ThreadPool pool(thread_num);
+	// Generate transform
+	generateTransform(degree_inc, num_moves);
+
+	// Recalculate angle
+	degree_tracker = degree_tracker % 360;
+	object_info["Turntable Pos"] = std::to_string(degree_tracker);
+
+	// Continue with the next pose
+	curr_pose = get_last_pose();
+	object_info["Pose"] = curr_pose;
+
+	MenuHandler::WaitUntilKeypress();
+
+	return true;
+}
+
+// Runs a full scan without user input and prints the per-angle timings
+bool runBenchmark() {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	int degree_inc = config.getValue<int>("degree_inc");
+	int num_moves = config.getValue<int>("num_moves");
+
+	cout << "Benchmark: " << num_moves << " moves of " << degree_inc << " degrees\n";
+	runPoseScan(degree_inc, num_moves);
+
+	tabulate::Table table;
+	table.add_row({"Angle", "Capture (ms)", "Move (ms)", "Settle (ms)", "Skew (ms)", "Total (ms)"});
+	int start_degree = degree_tracker - num_moves * degree_inc;
+	for (int rots = 0; rots < num_moves; rots++) {
+		int degree = start_degree + rots * degree_inc;
+		nlohmann::json angle_info = scan_info["angles"].value(std::to_string(degree), nlohmann::json::object());
+		// Settle time is recorded under the angle the turntable moved to
+		nlohmann::json next_info = scan_info["angles"].value(std::to_string(degree + degree_inc), nlohmann::json::object());
+		std::string skew = "-";
+		// No skew when a device had no host time stamps
+		if (angle_info.contains("realsense_sync") && angle_info["realsense_sync"]["skew_ms"].is_number()) {
+			skew = std::to_string(angle_info["realsense_sync"]["skew_ms"].get<double>());
+		}
+		table.add_row({std::to_string(degree % 360),
+			std::to_string(angle_info.value("capture_ms", 0)),
+			std::to_string(angle_info.value("move_ms", 0)),
+			std::to_string(next_info.value("settle_ms", 0)),
+			skew,
+			std::to_string(angle_info.value("angle_ms", 0))});
+	}
+	std::cout << table << std::endl;
+
+	cout << "Scan loop: " << scan_info["scan_ms"] << " ms\n";
+	cout << "Scan + processing: " << scan_info["total_ms"] << " ms\n";
+	cout << "RS Fail Count: " << rshandle.fail_count << endl;
+	return rshandle.fail_count == 0;
+}
+
+// Applies "key": value config overrides (dotted keys) and returns the previous values, so passing
+// them back restores the config. Unknown keys throw before anything is changed.
+nlohmann::json applyOverrides(const nlohmann::json& overrides) {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	nlohmann::json previous = nlohmann::json::object();
+	for (const auto& item : overrides.items()) {
+		previous[item.key()] = config.getValue<nlohmann::json>(item.key());
+	}
+	for (const auto& item : overrides.items()) {
+		config.setValue<nlohmann::json>(item.key(), item.value());
+	}
+	return previous;
+}
+
+// Sets up the devices that a config override turned on, the ones already running are kept and
+// get the overridden RealSense settings
+void ensureDevices() {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	if (config.getValue<bool>("dslr.collect_dslr") && !canonhandle.isSDKLoaded) {
+		initializeCanon();
+	}
+	if (config.getValue<bool>("realsense.collect_realsense")) {
+		if (!rshandle.is_initialized()) {
+			initializeRealsense();
+		} else if (rshandle.apply_config()) {
+			rshandle.get_frames(config.getValue<int>("realsense.warmup_frames"));
+		}
+	}
+	printStartupReport();
+}
+
+// Runs the scans of a job file back to back without user input, keeping the devices initialized.
+// The results of every pose are written to <job>_results.json as they finish. Job file:
+// {
+//   "config": { "dslr.quality.reshoot": true },      overrides for the whole batch (optional)
+//   "stop_on_error": false,
+//   "objects": [ { "name": "a2-engine-bot", "config": { ... },
+//     "poses": [ { "pose": "a", "degree_inc": 5, "num_moves": 72, "delay_s": 0, "transform": true, "config": { ... } } ] } ]
+// }
+// Poses without "pose" take the next pose of the object, degree_inc and num_moves default to the config.
+bool runJobs(const std::string& path) {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	std::ifstream job_file(path);
+	nlohmann::json job = nlohmann::json::parse(job_file, nullptr, false);
+	if (!job_file.is_open() || job.is_discarded() || !job.contains("objects")) {
+		std::cerr << "Invalid job file: " << path << std::endl;
+		return false;
+	}
+	// Check every override key first, a typo should not stop the batch halfway
+	try {
+		std::vector<nlohmann::json> overrides = { job.value("config", nlohmann::json::object()) };
+		for (const auto& object : job["objects"]) {
+			object.at("name").get<std::string>();
+			overrides.push_back(object.value("config", nlohmann::json::object()));
+			for (const auto& pose : object.value("poses", nlohmann::json::array())) {
+				overrides.push_back(pose.value("config", nlohmann::json::object()));
+			}
+		}
+		for (const auto& item : overrides) {
+			for (const auto& key : item.items()) config.getValue<nlohmann::json>(key.key());
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Invalid job file: " << path << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	std::string results_path = (fs::path(path).parent_path() / (fs::path(path).stem().string() + "_results.json")).string();
+	bool stop_on_error = job.value("stop_on_error", false);
+	nlohmann::json results = nlohmann::json::array();
+	int failed = 0;
+	auto batch_start = std::chrono::high_resolution_clock::now();
+
+	nlohmann::json batch_config = applyOverrides(job.value("config", nlohmann::json::object()));
+	for (const auto& object : job["objects"]) {
+		std::string name = object["name"];
+		nlohmann::json object_config = applyOverrides(object.value("config", nlohmann::json::object()));
+		setObjectName(name);
+		object_info["Object Name"] = name;
+
+		bool stop = false;
+		for (const auto& pose : object.value("poses", nlohmann::json::array())) {
+			nlohmann::json result;
+			result["object"] = name;
+			auto pose_start = std::chrono::high_resolution_clock::now();
+			nlohmann::json pose_config = nlohmann::json::object();
+			try {
+				std::string pose_name = pose.value("pose", "");
+				if (!pose_name.empty()) curr_pose = pose_name[0];
+				pose_config = applyOverrides(pose.value("config", nlohmann::json::object()));
+				ensureDevices();
+
+				int degree_inc = pose.value("degree_inc", config.getValue<int>("degree_inc"));
+				int num_moves = pose.value("num_moves", config.getValue<int>("num_moves"));
+				result["pose"] = std::string("pose-") + curr_pose;
+				result["degree_inc"] = degree_inc;
+				result["num_moves"] = num_moves;
+				cout << "\nJob: " << name << " pose-" << curr_pose << ", " << num_moves << " moves of " << degree_inc << " degrees\n";
+
+				// Time to change the pose of the object (e.g. by a fixture)
+				double delay_s = pose.value("delay_s", 0.0);
+				if (delay_s > 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(delay_s * 1000)));
+				}
+
+				runPoseScan(degree_inc, num_moves);
+				if (pose.value("transform", true)) {
+					generateTransform(degree_inc, num_moves);
+				}
+				result["scan_ms"] = scan_info["scan_ms"];
+				result["total_ms"] = scan_info["total_ms"];
+				result["rs_fail_count"] = scan_info["rs_fail_count"];
+				result["success"] = true;
+			} catch (const std::exception& e) {
+				std::cerr << "Job failed: " << name << " pose-" << curr_pose << ": " << e.what() << std::endl;
+				result["success"] = false;
+				result["error"] = e.what();
+				failed++;
+				stop = stop_on_error;
+			}
+			result["pose_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::high_resolution_clock::now() - pose_start).count();
+			applyOverrides(pose_config);
+
+			// Same bookkeeping as a full scan
+			degree_tracker = degree_tracker % 360;
+			object_info["Turntable Pos"] = std::to_string(degree_tracker);
+			curr_pose++;
+			object_info["Pose"] = curr_pose;
+
+			results.push_back(result);
+			std::ofstream results_file(results_path);
+			results_file << results.dump(4);
+			if (stop) break;
+		}
+		applyOverrides(object_config);
+		if (stop) break;
+	}
+	applyOverrides(batch_config);
+
+	tabulate::Table table;
+	table.add_row({"Object", "Pose", "Moves", "Scan (ms)", "Total (ms)", "Result"});
+	for (const auto& result : results) {
+		table.add_row({result.value("object", ""), result.value("pose", "-"),
+			std::to_string(result.value("num_moves", 0)),
+			std::to_string(result.value("scan_ms", 0)),
+			std::to_string(result.value("pose_ms", 0)),
+			result.value("success", false) ? "ok" : result.value("error", "failed")});
+	}
+	std::cout << table << std::endl;
+	auto batch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - batch_start).count();
+	cout << "Batch: " << results.size() << " poses, " << failed << " failed, " << batch_ms / 1000 << " s\n";
+	cout << "Results saved to " << results_path << endl;
+	return failed == 0;
+}
+
+// Captures and processes RealSense framesets with each stream profile of a profile file and prints
+// the mean time of every processing stage. The results are written to <file>_results.json. File:
+// {
+//   "captures": 10,
+//   "profiles": { "720p": {}, "480p-dec2": { "realsense.stream.width": 848, "realsense.stream.height": 480,
+//                 "realsense.stream.decimation": 2 } }
+// }
+// The profiles are config overrides (dotted keys), the clouds are saved under <output_dir>/profile_benchmark.
+bool runProfileBenchmark(const std::string& path) {
+	ConfigHandler& config = ConfigHandler::getInstance();
+	std::ifstream profile_file(path);
+	nlohmann::json benchmark = nlohmann::json::parse(profile_file, nullptr, false);
+	if (!profile_file.is_open() || benchmark.is_discarded() || !benchmark.contains("profiles")) {
+		std::cerr << "Invalid profile file: " << path << std::endl;
+		return false;
+	}
+	try {
+		for (const auto& profile : benchmark["profiles"].items()) {
+			for (const auto& item : profile.value().items()) {
+				config.getValue<nlohmann::json>(item.key());
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Invalid profile file: " << path << ": " << e.what() << std::endl;
+		return false;
+	}
+	if (!config.getValue<bool>("realsense.collect_realsense")) {
+		std::cerr << "RealSense collection is disabled (realsense.collect_realsense)" << std::endl;
+		return false;
+	}
+
+	int captures = benchmark.value("captures", 10);
+	std::string save_dir = rshandle.save_dir;
+	nlohmann::json results = nlohmann::json::object();
+	for (const auto& profile : benchmark["profiles"].items()) {
+		cout << "\nProfile " << profile.key() << ": " << captures << " captures\n";
+		nlohmann::json previous = applyOverrides(profile.value());
+		ensureDevices();
+		rshandle.save_dir = config.getValue<std::string>("output_dir") + "/profile_benchmark/" + profile.key();
+		create_folder(rshandle.save_dir, true);
+		rshandle.reset_stage_times();
+		for (int capture = 0; capture < captures; capture++) {
+			rshandle.get_current_frame(capture, get_rs_timeout());
+		}
+		results[profile.key()] = rshandle.stage_times();
+		applyOverrides(previous);
+	}
+	// Back to the streams of the config
+	ensureDevices();
+	rshandle.save_dir = save_dir;
+
+	tabulate::Table table;
+	std::vector<std::string> stages = { "depth_filter_ms", "pointcloud_ms", "crop_ms", "color_ms", "cloud_filter_ms", "normals_ms", "align_ms", "write_ms", "total_ms" };
+	tabulate::Table::Row_t header = { "Profile", "Framesets", "Points" };
+	for (const auto& stage : stages) header.push_back(stage);
+	table.add_row(header);
+	for (const auto& result : results.items()) {
+		tabulate::Table::Row_t row = { result.key(), std::to_string(result.value().value("framesets", 0)),
+			std::to_string(result.value().value("points", 0)) };
+		for (const auto& stage : stages) {
+			row.push_back(std::to_string(static_cast<int>(result.value().value(stage, 0.0))));
+		}
+		table.add_row(row);
+	}
+	std::cout << "\nMean processing time per frameset (ms):\n" << table << std::endl;
+
+	std::string results_path = (fs::path(path).parent_path() / (fs::path(path).stem().string() + "_results.json")).string();
+	std::ofstream results_file(results_path);
+	results_file << results.dump(4);
+	cout << "Results saved to " << results_path << endl;
+	return true;
+}
+
+// TODO: Check Degree Tracker
+bool collectSampleData() {
+	if (liveview_active){
+		std::cout << "Liveview is active, please stop it before scanning." << std::endl;
+		return false;
+	}
 
 	// Scan all the cameras
-	scan(&pool);
+	scan();
 
 	return false;
 }
@@ -610,9 +1213,9 @@ void setObjectName(std::string object_name) {
 	object_info["Pose"] = curr_pose;
 
 	// Update the save directories for RealSense and DSLR
-	rshandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\realsense";
+	rshandle.save_dir = scan_folder + "/pose-" + curr_pose + "/realsense";
 	create_folder(rshandle.save_dir,true);
-	canonhandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\DSLR";
+	canonhandle.save_dir = scan_folder + "/pose-" + curr_pose + "/DSLR";
 	create_folder(canonhandle.save_dir,true);
 }
 
@@ -662,9 +1265,9 @@ void _getCurrCameraValue(const std::vector<std::string>& value_arr) {
 	tabulate::Table cam_val_table;
 	tabulate::Table::Row_t values;
 
-	// Create a row for camera names
-	for (const auto& name: canonhandle.camera_names) {
-		values.push_back(name.first);
+	// Create a row for camera names, in the order of the values (cameraArray)
+	for (const auto& camera: canonhandle.cameraArray) {
+		values.push_back(canonhandle.camera_label(camera));
 	}
 	cam_val_table.add_row(values);
 	
@@ -714,7 +1317,7 @@ bool setTV() {
 		std::string value;
 		GetProperty(activeCamera, canonhandle.bodyID[0], kEdsPropID_Tv, out_table, value);
 		
-		std::cout << "Modifing " << camera_name[activeCamera] << std::endl;
+		std::cout << "Modifing " << canonhandle.camera_label(activeCamera) << std::endl;
 		std::cout << "Current Value: " << value << std::endl;
 		cout << "input no. (ex. 54 = 1/250)" << endl;
 		cout << ">";
@@ -767,7 +1370,7 @@ bool setAV() {
 		GetProperty(activeCamera, canonhandle.bodyID[0], kEdsPropID_Av, out_table, value);
 		
 
-		std::cout << "Modifing " << camera_name[activeCamera] << std::endl;
+		std::cout << "Modifing " << canonhandle.camera_label(activeCamera) << std::endl;
 		std::cout << "Current Value: " << value << std::endl;
 		cout << "input Av (ex. 21 = 5.6)" << endl;
 		cout << ">";
@@ -818,7 +1421,7 @@ bool setISO() {
 		std::string value;
 		GetProperty(activeCamera, canonhandle.bodyID[0], kEdsPropID_ISOSpeed, out_table, value);
 		
-		std::cout << "Modifing " << camera_name[activeCamera] << std::endl;
+		std::cout << "Modifing " << canonhandle.camera_label(activeCamera) << std::endl;
 		std::cout << "Current Value: " << value << std::endl;
 		cout << "input ISOSpeed (ex. 8 = ISO 200)" << endl;
 		cout << ">";
@@ -869,7 +1472,7 @@ bool setWhiteBalance() {
 		std::string value;
 		GetProperty(activeCamera, canonhandle.bodyID[0], kEdsPropID_WhiteBalance, out_table, value);
 		
-		std::cout << "Modifing " << camera_name[activeCamera] << std::endl;
+		std::cout << "Modifing " << canonhandle.camera_label(activeCamera) << std::endl;
 		std::cout << "Current Value: " << value << std::endl;
 		cout << "input WhiteBalance (ex. 0 = Auto)" << endl;
 		cout << ">";
@@ -919,7 +1522,7 @@ bool setDriveMode() {
 		std::string value;
 		GetProperty(activeCamera, canonhandle.bodyID[0], kEdsPropID_DriveMode, out_table, value);
 		
-		std::cout << "Modifing " << camera_name[activeCamera] << std::endl;
+		std::cout << "Modifing " << canonhandle.camera_label(activeCamera) << std::endl;
 		std::cout << "Current Value: " << value << std::endl;
 		cout << "input Drive Mode (ex. 0 = Single shooting)" << endl;
 		cout << ">";
@@ -956,7 +1559,7 @@ bool changeCamera() {
 	// Display all available cameras 
 	std::cout << "0. All cameras" << std::endl;
 	for (const auto& camera : canonhandle.cameraArray) {
-		std::cout << i << ". " << camera_name[camera] << std::endl;
+		std::cout << i << ". " << canonhandle.camera_label(camera) << std::endl;
 		i++; 
 	}
 	option = getvalue();
@@ -1009,8 +1612,8 @@ bool getLiveView() {
 		int i = 0;
 		for (auto& camera : canonhandle.cameraArray) {
 			// Download the image from the camera
-			liveview_th.push_back(std::thread([&]() {
-				DownloadEvfCommand(camera, camera_name[camera], liveview_thread_id);
+			liveview_th.push_back(Scheduler::getInstance().startThread("background", [&camera]() {
+				DownloadEvfCommand(camera, canonhandle.camera_label(camera), liveview_thread_id);
 			}));
 			std::this_thread::sleep_for(.5s);
 			i++;
@@ -1071,20 +1674,15 @@ bool turntableControl() {
 		if (degree_inc == "r")
 			break;
 		
-		// Send the degree increment to the turntable
-		char *send = &degree_inc[0];
-		bool is_sent = Serial->WriteSerialPort(send);
-		
-		// TODO: Calculate wait time based on degrees entered and motor speed 
-		if (is_sent) {
-			// Calculate wait time based on the degree increment
-			int wait_time = std::ceil(((abs(stoi(degree_inc))*200)+500)/1000)+5;
-			cout << "Message sent, waiting up to " << wait_time << " seconds.\n";
-			
-			// Check if the message matched the expected format
-			std::string incoming = Serial->ReadSerialPort(wait_time, "json");
-			cout << "Incoming: " << incoming;
-		} 
+		// Send the degree increment to the turntable and wait for the reply
+		int timeout_ms = TurntableSerial::moveTimeoutMs(std::stoi(degree_inc));
+		cout << "Sending move, waiting up to " << timeout_ms << " ms.\n";
+		try {
+			nlohmann::json incoming = turntable->rotate(std::stoi(degree_inc), timeout_ms).get();
+			cout << "Incoming: " << incoming.dump() << endl;
+		} catch (const std::exception& e) {
+			cout << "WARNING: " << e.what() << endl;
+		}
 
 		// Update degree tracker
 		degree_tracker += std::stoi(degree_inc);
@@ -1177,12 +1775,12 @@ void initializeRealsense() {
 	if (config.getValue<bool>("realsense.collect_realsense")) {
 		cout << "\nAttempting Realsense setup...\n";
 		// Create RealSense Handler
-		rshandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\realsense";
+		rshandle.save_dir = scan_folder + "/pose-" + curr_pose + "/realsense";
 		create_folder(rshandle.save_dir,true);
 		// Get some frames to settle autoexposure.
 		std::cout << "Getting frames..." << std::endl;
 		rshandle.initialize();
-		rshandle.get_frames(10); // make 30 later
+		rshandle.get_frames(config.getValue<int>("realsense.warmup_frames"));
 		// rshandle.get_current_frame();
 	} else {
 		cout << "\nSkipping RealSense setup, 'collect_rs=0'.\n";
@@ -1196,49 +1794,39 @@ void initializeCanon() {
 		cout << "\nEntering DSLR Setup...\n";
 		// CanonHandler canonhandle;
 		canonhandle.initialize();
-		canonhandle.save_dir = scan_folder + "\\pose-" + curr_pose + "\\DSLR";
+		canonhandle.save_dir = scan_folder + "/pose-" + curr_pose + "/DSLR";
 		create_folder(canonhandle.save_dir,true);
-		PreSetting(canonhandle.cameraArray, canonhandle.bodyID);
-		// Naming of the camera
+		canonhandle.open_sessions();
+		// Naming of the camera, by serial number
+		const std::map<std::string, std::string> serial_names = {
+			{ CAMERA_1, "1" }, { CAMERA_2, "2" }, { CAMERA_3, "3" }, { CAMERA_4, "4" }, { CAMERA_5, "5" },
+		};
 		EdsChar serial[13];
 		EdsError err;
-		int index = 1;
-		for (const auto& camera: canonhandle.cameraArray) {
+		for (size_t index = 0; index < canonhandle.cameraArray.size(); index++) {
+			if (!canonhandle.session_open[index]) {
+				// The serial number cannot be read without a session
+				std::cout << "Camera " << index + 1 << " has no session, keeping " << index + 1 << std::endl;
+				canonhandle.register_camera(index, "camera-" + std::to_string(index + 1), std::to_string(index + 1));
+				continue;
+			}
 			// Fetch the serial number
-			err = EdsGetPropertyData(camera, kEdsPropID_BodyIDEx, 0, sizeof(serial), &serial);
+			err = EdsGetPropertyData(canonhandle.cameraArray[index], kEdsPropID_BodyIDEx, 0, sizeof(serial), &serial);
 			// Convert it into string
 			std::string serial_str = "";
 			for (size_t i = 0; i < sizeof(serial) - 1; i++){
 				serial_str += serial[i];
 			}
-			std::cout <<  "Renaming Camera " << index << " (Serial Number: " << serial_str <<")"; 
-			if (serial_str == CAMERA_1) {
-				std::cout << " to 1" << std::endl;
-				canonhandle.camera_names[std::to_string(index)] = "1";
-				camera_name[camera] = "Camera 1";
-			}
-			if (serial_str == CAMERA_2) {
-				std::cout << " to 2" << std::endl;
-				canonhandle.camera_names[std::to_string(index)] = "2";
-				camera_name[camera] = "Camera 2";
-			}
-			if (serial_str == CAMERA_3) {
-				std::cout << " to 3" << std::endl;
-				canonhandle.camera_names[std::to_string(index)] = "3";
-				camera_name[camera] = "Camera 3";
-			}
-			if (serial_str == CAMERA_4) {
-				std::cout << " to 4" << std::endl;
-				canonhandle.camera_names[std::to_string(index)] = "4";
-				camera_name[camera] = "Camera 4";
-			}
-			if (serial_str == CAMERA_5) {
-				std::cout << " to 5" << std::endl;
-				canonhandle.camera_names[std::to_string(index)] = "5";
-				camera_name[camera] = "Camera 5";
+			std::cout <<  "Renaming Camera " << index + 1 << " (Serial Number: " << serial_str <<")"; 
+			auto known = serial_names.find(serial_str);
+			if (known != serial_names.end()) {
+				std::cout << " to " << known->second << std::endl;
+				canonhandle.register_camera(index, serial_str, known->second);
+			} else {
+				// Unknown cameras keep their index
+				std::cout << " - unknown serial, keeping " << index + 1 << std::endl;
+				canonhandle.register_camera(index, serial_str, std::to_string(index + 1));
 			}
-
-			index++;
 		}
 	} else {
 		cout << "\nSkipping DSLR setup, 'collect_dslr=0'.\n";
@@ -1255,8 +1843,36 @@ int main(int argc, char* argv[])
 	fs::path executablePath(argv[0]);
 	fs::path projectDir = executablePath.parent_path().parent_path().parent_path();
 
+	// Command line options
+	// --config <path>: config file to load instead of moad_config.json
+	// --serial <port>: turntable port, overrides serial_com_port (e.g. a TurntableSim pty)
+	// --benchmark: run a full scan without the menu and print the timings
+	// --jobs <path>: run the scans of a job file without the menu (see runJobs)
+	// --profiles <path>: benchmark the RealSense processing of stream profiles (see runProfileBenchmark)
+	json_path = projectDir.string() + "/moad_config.json";
+	std::string serial_override;
+	std::string jobs_path;
+	std::string profiles_path;
+	bool benchmark = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--config" && i + 1 < argc) {
+			json_path = argv[++i];
+		} else if (arg == "--serial" && i + 1 < argc) {
+			serial_override = argv[++i];
+		} else if (arg == "--benchmark") {
+			benchmark = true;
+		} else if (arg == "--jobs" && i + 1 < argc) {
+			jobs_path = argv[++i];
+		} else if (arg == "--profiles" && i + 1 < argc) {
+			profiles_path = argv[++i];
+		} else {
+			cout << "Usage: MultiCamCui [--config <path>] [--serial <port>] [--benchmark] [--jobs <path>] [--profiles <path>]\n";
+			return 1;
+		}
+	}
+
 	// Load the JSON Config file
-	json_path = projectDir.string() + "\\moad_config.json";
 	loadJsonConfig(json_path);
 	ConfigHandler& config = ConfigHandler::getInstance();
 
@@ -1274,12 +1890,12 @@ int main(int argc, char* argv[])
 
 	// Setup Arduino serial port connection
 	cout << "\nAttempting Serial Motor Control setup...\n";
-	char com_port[] = "\\\\.\\COMX";
-	com_port[7] = config.getValue<std::string>("serial_com_port").at(0);
-	DWORD COM_BAUD_RATE = CBR_9600;
+	std::string com_port = TurntableSerial::portName(
+		serial_override.empty() ? config.getValue<std::string>("serial_com_port") : serial_override);
+	int COM_BAUD_RATE = 9600;
 
-	Serial = new SimpleSerial(com_port, COM_BAUD_RATE);
-	if(Serial->connected_) {
+	turntable = new TurntableSerial(com_port, COM_BAUD_RATE, config.getValue<int>("turntable_serial.connect_delay_ms"));
+	if(turntable->connected()) {
 		cout << "Serial connected to " << com_port << endl;
 	} else {
 		cout << "Error creating serial connection.\n";
@@ -1291,10 +1907,27 @@ int main(int argc, char* argv[])
 	object_info["Object Name"] = config.getValue<std::string>("object_name");
 	object_info["Turntable Pos"] = std::to_string(degree_tracker);
 	object_info["Pose"] = curr_pose;
+
+	if (benchmark) {
+		bool success = runBenchmark();
+		delete turntable;
+		return success ? 0 : 1;
+	}
+	if (!jobs_path.empty()) {
+		bool success = runJobs(jobs_path);
+		delete turntable;
+		return success ? 0 : 1;
+	}
+	if (!profiles_path.empty()) {
+		bool success = runProfileBenchmark(profiles_path);
+		delete turntable;
+		return success ? 0 : 1;
+	}
 	
 	// Main Menu initialization
 	MenuHandler menu_handler({
 		{"1", "Full Scan"},
+		{"10", "Resume Scan"},
 		{"2", "Custom Scan"},
 		{"3", "Collect Single Data"},
 		{"4", "Set Object Name"},
@@ -1307,6 +1940,7 @@ int main(int argc, char* argv[])
 	},
 	{
 		{"1", fullScan},
+		{"10", resumeScan},
 		{"2", customScan},
 		{"3", collectSampleData},
 		{"4", setObjectName},
@@ -2,8 +2,20 @@
 // Tabulate Documentation: https://github.com/p-ranav/tabulate
 
 #include <limits>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 #include "MenuHandler.h"
+#include "DeviceRegistry.h"
 
 using namespace std::chrono_literals;
 
@@ -81,6 +93,9 @@ void MenuHandler::ShowMenu() {
 
     // Display the tables and message if available
     std::cout << "\n" << info << "\n" << std::endl;
+    if (DeviceRegistry::getInstance().size() > 0) {
+        std::cout << DeviceStatus() << "\n" << std::endl;
+    }
     std::cout << this->message << "\n" << std::endl;
     std::cout << table << std::endl;
 }
@@ -150,4 +165,109 @@ void MenuHandler::addMessage(MenuMessageStatus status, std::string message) {
     
     // Add the message table to the main message
     this->message = message_table;
-}
\ No newline at end of file
+}
+
+// Builds a table with the state and counters of every registered device. Only atomics are read,
+// so it can be rendered while the capture threads are running.
+tabulate::Table MenuHandler::DeviceStatus() {
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    const char* states[] = {"Offline", "Ready", "Capturing", "Failed"};
+    tabulate::Table status;
+    status.add_row({"Device", "State", "Captured", "Dropped", "Failed", "Retries", "Avg ms", "Written MB"});
+
+    for (int id = 0; id < registry.size(); id++) {
+        DeviceStats& stats = registry.stats(id);
+        int captures = stats.captures;
+        int handled = captures + stats.failures;
+        std::stringstream avg_ms, written_mb;
+        avg_ms << std::fixed << std::setprecision(1) << (handled > 0 ? stats.process_us / 1000.0 / handled : 0.0);
+        written_mb << std::fixed << std::setprecision(1) << stats.bytes_written / 1048576.0;
+        status.add_row({
+            registry.info(id).label,
+            states[static_cast<int>(registry.state(id))],
+            std::to_string(captures),
+            std::to_string(stats.dropped),
+            std::to_string(stats.failures),
+            std::to_string(stats.retries),
+            avg_ms.str(),
+            written_mb.str()
+        });
+        // Highlight the devices with problems
+        if (stats.failures > 0 || registry.state(id) == DeviceState::Failed) {
+            status.row(id + 1).format().font_color(tabulate::Color::red);
+        } else if (stats.dropped > 0 || stats.retries > 0) {
+            status.row(id + 1).format().font_color(tabulate::Color::yellow);
+        }
+    }
+    status.row(0).format().font_style({tabulate::FontStyle::bold});
+    return status;
+}
+
+// Number of rows of the console, 0 when the output is not a console (redirected to a file) or the
+// console does not take escape sequences
+int MenuHandler::ConsoleRows() {
+#ifdef _WIN32
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleMode(output, &mode) || !SetConsoleMode(output, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) return 0;
+    if (!GetConsoleScreenBufferInfo(output, &info)) return 0;
+    return info.srWindow.Bottom - info.srWindow.Top + 1;
+#else
+    winsize size;
+    if (!isatty(STDOUT_FILENO) || ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0) return 0;
+    return size.ws_row;
+#endif
+}
+
+// Draws the device status over the top rows of the console, the cursor goes back to the scan output
+void MenuHandler::DrawStatus() {
+    std::stringstream table;
+    table << DeviceStatus();
+    std::stringstream frame;
+    frame << "\0337\033[H";  // Save the cursor, go to the top left corner
+    std::string line;
+    while (std::getline(table, line)) {
+        frame << line << "\033[K\n";
+    }
+    frame << "\033[K\0338";   // Clear the separator row, restore the cursor
+    std::cout << frame.str() << std::flush;
+}
+
+// Keeps the device status at the top of the console, refreshed every refresh_ms from a background
+// thread until StopStatus is called. The scan output scrolls below it, so the table is redrawn in
+// place instead of being printed again. Without a console, or when the table would take more than
+// half of it, the status is only shown in the menu. The capture threads never wait on it.
+void MenuHandler::StartStatus(int refresh_ms) {
+    if (refresh_ms <= 0 || status_running) return;
+    std::stringstream table;
+    table << DeviceStatus();
+    int table_rows = static_cast<int>(std::count(std::istreambuf_iterator<char>(table), std::istreambuf_iterator<char>(), '\n')) + 1;
+    int rows = ConsoleRows();
+    if (rows == 0 || table_rows + 1 > rows / 2) return;
+
+    // The scan output scrolls in the rows under the table and its separator row
+    status_running = true;
+    std::cout << "\033[" << table_rows + 2 << ";" << rows << "r\033[" << rows << ";1H" << std::flush;
+    DrawStatus();
+    status_thread = std::thread([this, refresh_ms]() {
+        std::unique_lock<std::mutex> lock(print_mtx);
+        while (!status_cv.wait_for(lock, std::chrono::milliseconds(refresh_ms), [this]() { return !status_running; })) {
+            DrawStatus();
+        }
+    });
+}
+
+void MenuHandler::StopStatus() {
+    if (!status_running) return;
+    {
+        std::lock_guard<std::mutex> lock(print_mtx);
+        status_running = false;
+    }
+    status_cv.notify_all();
+    status_thread.join();
+
+    // Last counters of the scan, then the whole console scrolls again
+    DrawStatus();
+    std::cout << "\0337\033[r\0338" << std::flush;
+}
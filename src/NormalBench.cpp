@@ -0,0 +1,188 @@
+// Normal Bench: Compares the normals of the scanner (NormalEstimator, see NormalEstimator.h) with
+// pcl::NormalEstimationOMP, with the k = 2 the scanner used before and with the same neighborhood.
+//
+// The cloud is a synthetic sphere in front of a plane, with depth noise, so the angles are measured
+// to the true normals. With --input the angles are measured to the PCL normals of the same k.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <Eigen/Dense>
+#include <pcl/io/ply_io.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/features/normal_3d_omp.h>
+
+#include "NormalEstimator.h"
+#include "ThreadPool.h"
+
+using std::cout;
+using std::endl;
+
+struct BenchOptions {
+    std::string input;
+    size_t points = 200000;
+    float noise = 0.0005f;
+    int k = 16;
+    float radius = 0;
+    int threads = 1;
+    int repeat = 5;
+};
+
+struct NormalResult {
+    std::string name;
+    double ms = 0;
+    double mean_deg = 0;
+    double p95_deg = 0;
+    size_t invalid = 0;
+};
+
+void printUsage() {
+    cout << "Usage: NormalBench [--input <cloud.ply>] [--points N] [--noise M] [--k N] [--radius M] [--threads N] [--repeat N]\n";
+}
+
+bool parseArgs(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value) options.input = argv[++i];
+        else if (arg == "--points" && has_value) options.points = std::stoul(argv[++i]);
+        else if (arg == "--noise" && has_value) options.noise = std::stof(argv[++i]);
+        else if (arg == "--k" && has_value) options.k = std::stoi(argv[++i]);
+        else if (arg == "--radius" && has_value) options.radius = std::stof(argv[++i]);
+        else if (arg == "--threads" && has_value) options.threads = std::stoi(argv[++i]);
+        else if (arg == "--repeat" && has_value) options.repeat = std::stoi(argv[++i]);
+        else return false;
+    }
+    return options.k >= 3 && options.threads >= 1 && options.repeat >= 1;
+}
+
+// Sphere of 10 cm at 50 cm and a plane at 80 cm, seen from the origin; truth gets the normals
+void synthesizeCloud(const BenchOptions& options, pcl::PointCloud<pcl::PointXYZRGB>& cloud, std::vector<Eigen::Vector3f>& truth) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, options.noise);
+    const Eigen::Vector3f center(0, 0, 0.5f);
+    for (size_t i = 0; i < options.points; i++) {
+        Eigen::Vector3f point, normal;
+        if (i % 2 == 0) {
+            Eigen::Vector3f direction(unit(random), unit(random), unit(random));
+            if (direction.norm() < 1e-3f) direction = Eigen::Vector3f::UnitZ();
+            normal = direction.normalized();
+            point = center + normal * 0.1f;
+        } else {
+            point = Eigen::Vector3f(unit(random) * 0.4f, unit(random) * 0.3f, 0.8f);
+            normal = -Eigen::Vector3f::UnitZ();
+        }
+        // Depth noise along the line of sight, as the cameras have
+        point += point.normalized() * noise(random);
+        pcl::PointXYZRGB colored;
+        colored.getVector3fMap() = point;
+        colored.r = colored.g = colored.b = 128;
+        cloud.push_back(colored);
+        truth.push_back(normal);
+    }
+}
+
+// Angles between the normals and the reference, without the orientation
+void measure(const pcl::PointCloud<pcl::Normal>& normals, const std::vector<Eigen::Vector3f>& reference, NormalResult& result) {
+    std::vector<double> angles;
+    angles.reserve(normals.size());
+    for (size_t i = 0; i < normals.size(); i++) {
+        Eigen::Vector3f normal = normals.points[i].getNormalVector3fMap();
+        if (!std::isfinite(normal.x()) || !std::isfinite(reference[i].x())) {
+            result.invalid++;
+            continue;
+        }
+        double cosine = std::fabs(normal.dot(reference[i]));
+        angles.push_back(std::acos(cosine > 1.0 ? 1.0 : cosine) * 180.0 / EIGEN_PI);
+    }
+    if (angles.empty()) return;
+    double sum = 0;
+    for (double angle : angles) sum += angle;
+    result.mean_deg = sum / angles.size();
+    std::nth_element(angles.begin(), angles.begin() + angles.size() * 95 / 100, angles.end());
+    result.p95_deg = angles[angles.size() * 95 / 100];
+}
+
+void computePcl(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr& cloud, int k, int threads, pcl::PointCloud<pcl::Normal>& normals) {
+    pcl::NormalEstimationOMP<pcl::PointXYZRGB, pcl::Normal> ne;
+    ne.setInputCloud(cloud);
+    ne.setNumberOfThreads(threads);
+    ne.setSearchMethod(pcl::search::KdTree<pcl::PointXYZRGB>::Ptr(new pcl::search::KdTree<pcl::PointXYZRGB>));
+    ne.setKSearch(k);
+    ne.setViewPoint(0, 0, 0);
+    ne.compute(normals);
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    std::vector<Eigen::Vector3f> truth;
+    if (!options.input.empty()) {
+        if (pcl::io::loadPLYFile(options.input, *cloud) < 0 || cloud->empty()) {
+            std::cerr << "Failed to load " << options.input << endl;
+            return 1;
+        }
+    } else {
+        synthesizeCloud(options, *cloud, truth);
+    }
+    cout << "Cloud: " << cloud->size() << " points, k " << options.k << ", radius " << options.radius << ", "
+         << options.threads << " threads, best of " << options.repeat << endl;
+
+    // Each estimator runs repeat times, the fastest run counts
+    auto timeBest = [&options](const std::function<void()>& run) {
+        double best = 0;
+        for (int i = 0; i < options.repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || ms < best) best = ms;
+        }
+        return best;
+    };
+
+    std::vector<NormalResult> results(3);
+    pcl::PointCloud<pcl::Normal> old_normals, pcl_normals, normals;
+    results[0].name = "pcl k=2";
+    results[0].ms = timeBest([&]() { computePcl(cloud, 2, options.threads, old_normals); });
+    results[1].name = "pcl k=" + std::to_string(options.k);
+    results[1].ms = timeBest([&]() { computePcl(cloud, options.k, options.threads, pcl_normals); });
+
+    ThreadPool pool(options.threads > 1 ? options.threads - 1 : 1);
+    NormalEstimator estimator;
+    estimator.k = options.k;
+    estimator.radius = options.radius;
+    estimator.threads = options.threads;
+    pcl::search::KdTree<pcl::PointXYZRGB> tree;
+    results[2].name = options.radius > 0 ? "moad r=" + std::to_string(options.radius) : "moad k=" + std::to_string(options.k);
+    results[2].ms = timeBest([&]() { estimator.compute(cloud, tree, Eigen::Vector3f::Zero(), normals, &pool); });
+
+    // Without a synthetic truth, the PCL normals of the same k are the reference
+    if (truth.empty()) {
+        for (const auto& normal : pcl_normals.points) truth.push_back(normal.getNormalVector3fMap());
+    }
+    measure(old_normals, truth, results[0]);
+    if (options.input.empty()) measure(pcl_normals, truth, results[1]);
+    measure(normals, truth, results[2]);
+
+    cout << std::fixed << std::setprecision(2);
+    cout << std::left << std::setw(20) << "estimator" << std::right << std::setw(12) << "ms" << std::setw(14) << "mean deg"
+         << std::setw(12) << "p95 deg" << std::setw(10) << "invalid" << "\n";
+    for (const auto& result : results) {
+        cout << std::left << std::setw(20) << result.name << std::right << std::setw(12) << result.ms << std::setw(14) << result.mean_deg
+             << std::setw(12) << result.p95_deg << std::setw(10) << result.invalid << "\n";
+    }
+    if (!options.input.empty()) cout << "(angles to the " << results[1].name << " normals)" << endl;
+    return 0;
+}
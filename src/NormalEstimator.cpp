@@ -0,0 +1,203 @@
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <pcl/common/point_tests.h>
+
+#include "NormalEstimator.h"
+
+void CovarianceBlock::resize(size_t count) {
+    xx.resize(count);
+    xy.resize(count);
+    xz.resize(count);
+    yy.resize(count);
+    yz.resize(count);
+    zz.resize(count);
+}
+
+// One Newton step toward the root of 3 e^2 + e^3 = target
+static inline float newtonStep(float e, float target) {
+    float slope = 6.0f * e + 3.0f * e * e;
+    float step = (3.0f * e * e + e * e * e - target) / (slope > 1e-12f ? slope : 1.0f);
+    return e - (slope > 1e-12f ? step : 0.0f);
+}
+
+// Smallest eigenvalue of each matrix from its characteristic polynomial, then the eigenvector as the
+// longest cross product of two rows of (A - lambda I). Each matrix is scaled by its largest
+// coefficient first, so the float arithmetic works on values around 1. The loop is straight-line
+// arithmetic over separate arrays (no trigonometry, no branches, the divisions never by zero), so
+// the compiler vectorizes it.
+void solveNormals(const CovarianceBlock& block, size_t count, float* __restrict nx, float* __restrict ny, float* __restrict nz,
+                  float* __restrict curvature) {
+    const float tiny = 1e-12f;
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    const float* __restrict xx = block.xx.data();
+    const float* __restrict xy = block.xy.data();
+    const float* __restrict xz = block.xz.data();
+    const float* __restrict yy = block.yy.data();
+    const float* __restrict yz = block.yz.data();
+    const float* __restrict zz = block.zz.data();
+    for (size_t i = 0; i < count; i++) {
+        float a00 = xx[i], a01 = xy[i], a02 = xz[i];
+        float a11 = yy[i], a12 = yz[i], a22 = zz[i];
+        float scale = std::fabs(a00);
+        scale = std::fabs(a01) > scale ? std::fabs(a01) : scale;
+        scale = std::fabs(a02) > scale ? std::fabs(a02) : scale;
+        scale = std::fabs(a11) > scale ? std::fabs(a11) : scale;
+        scale = std::fabs(a12) > scale ? std::fabs(a12) : scale;
+        scale = std::fabs(a22) > scale ? std::fabs(a22) : scale;
+        float inv_scale = 1.0f / (scale > 0 ? scale : 1.0f);
+        a00 *= inv_scale; a01 *= inv_scale; a02 *= inv_scale;
+        a11 *= inv_scale; a12 *= inv_scale; a22 *= inv_scale;
+
+        // B = (A - mean I) / sqrt(p) has the eigenvalues -1 - e, with e in [0, 1] the root of
+        // 3 e^2 + e^3 = 2 - 2 det(B) / 2. Newton from the quadratic estimate, which is above the
+        // root of this convex function, converges without overshooting.
+        float mean = (a00 + a11 + a22) / 3.0f;
+        float b00 = a00 - mean, b11 = a11 - mean, b22 = a22 - mean;
+        float p = (b00 * b00 + b11 * b11 + b22 * b22 + 2.0f * (a01 * a01 + a02 * a02 + a12 * a12)) / 6.0f;
+        float q = 0.5f * (b00 * (b11 * b22 - a12 * a12) - a01 * (a01 * b22 - a12 * a02) + a02 * (a01 * a12 - b11 * a02));
+        float root_p = std::sqrt(p);
+        float r = (p > tiny ? q : 0.0f) / (p > tiny ? p * root_p : 1.0f);
+        r = r < -1.0f ? -1.0f : (r > 1.0f ? 1.0f : r);
+        float target = 2.0f - 2.0f * r;
+        float e = std::sqrt(target / 3.0f);
+        e = newtonStep(e, target);
+        e = newtonStep(e, target);
+        e = newtonStep(e, target);
+        float smallest = mean - root_p * (1.0f + e);
+
+        // Rows of A - smallest * I and their cross products
+        float r00 = a00 - smallest, r11 = a11 - smallest, r22 = a22 - smallest;
+        float c0x = a01 * a12 - a02 * r11, c0y = a02 * a01 - r00 * a12, c0z = r00 * r11 - a01 * a01;
+        float c1x = a01 * r22 - a02 * a12, c1y = a02 * a02 - r00 * r22, c1z = r00 * a12 - a01 * a02;
+        float c2x = r11 * r22 - a12 * a12, c2y = a12 * a02 - a01 * r22, c2z = a01 * a12 - r11 * a02;
+        float n0 = c0x * c0x + c0y * c0y + c0z * c0z;
+        float n1 = c1x * c1x + c1y * c1y + c1z * c1z;
+        float n2 = c2x * c2x + c2y * c2y + c2z * c2z;
+        float vx = n1 > n0 ? c1x : c0x;
+        float vy = n1 > n0 ? c1y : c0y;
+        float vz = n1 > n0 ? c1z : c0z;
+        float norm = n1 > n0 ? n1 : n0;
+        vx = n2 > norm ? c2x : vx;
+        vy = n2 > norm ? c2y : vy;
+        vz = n2 > norm ? c2z : vz;
+        norm = n2 > norm ? n2 : norm;
+        float inv_norm = 1.0f / std::sqrt(norm > tiny ? norm : 1.0f);
+        float unset = norm > tiny ? 0.0f : invalid;
+        nx[i] = vx * inv_norm + unset;
+        ny[i] = vy * inv_norm + unset;
+        nz[i] = vz * inv_norm + unset;
+
+        float trace = 3.0f * mean;
+        smallest = smallest > 0 ? smallest : 0.0f;
+        curvature[i] = (trace > tiny ? smallest : 0.0f) / (trace > tiny ? trace : 1.0f);
+    }
+}
+
+void NormalEstimator::computeChunk(const pcl::PointCloud<pcl::PointXYZRGB>& cloud, const pcl::search::KdTree<pcl::PointXYZRGB>& tree,
+                                   const Eigen::Vector3f& viewpoint, size_t begin, size_t end, pcl::PointCloud<pcl::Normal>& normals) const {
+    size_t count = end - begin;
+    CovarianceBlock block;
+    block.resize(count);
+    std::vector<float> nx(count), ny(count), nz(count), curvature(count);
+    std::vector<int> indices;
+    std::vector<float> distances;
+
+    for (size_t j = 0; j < count; j++) {
+        const pcl::PointXYZRGB& point = cloud.points[begin + j];
+        int found = 0;
+        if (pcl::isFinite(point)) {
+            found = radius > 0 ? tree.radiusSearch(point, radius, indices, distances, k) : tree.nearestKSearch(point, k, indices, distances);
+        }
+        // Fewer than 3 neighbors leave a zero covariance, which has no normal
+        float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+        if (found >= 3) {
+            Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+            for (int n = 0; n < found; n++) mean += cloud.points[indices[n]].getVector3fMap();
+            mean /= static_cast<float>(found);
+            for (int n = 0; n < found; n++) {
+                Eigen::Vector3f d = cloud.points[indices[n]].getVector3fMap() - mean;
+                xx += d.x() * d.x();
+                xy += d.x() * d.y();
+                xz += d.x() * d.z();
+                yy += d.y() * d.y();
+                yz += d.y() * d.z();
+                zz += d.z() * d.z();
+            }
+        }
+        block.xx[j] = xx;
+        block.xy[j] = xy;
+        block.xz[j] = xz;
+        block.yy[j] = yy;
+        block.yz[j] = yz;
+        block.zz[j] = zz;
+    }
+
+    solveNormals(block, count, nx.data(), ny.data(), nz.data(), curvature.data());
+
+    // Flip the normals toward the viewpoint
+    for (size_t j = 0; j < count; j++) {
+        const pcl::PointXYZRGB& point = cloud.points[begin + j];
+        pcl::Normal& normal = normals.points[begin + j];
+        float toward = (viewpoint.x() - point.x) * nx[j] + (viewpoint.y() - point.y) * ny[j] + (viewpoint.z() - point.z) * nz[j];
+        float sign = toward < 0 ? -1.0f : 1.0f;
+        normal.normal_x = sign * nx[j];
+        normal.normal_y = sign * ny[j];
+        normal.normal_z = sign * nz[j];
+        normal.curvature = curvature[j];
+    }
+}
+
+void NormalEstimator::compute(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr& cloud, pcl::search::KdTree<pcl::PointXYZRGB>& tree,
+                              const Eigen::Vector3f& viewpoint, pcl::PointCloud<pcl::Normal>& normals, ThreadPool* pool) const {
+    normals.resize(cloud->size());
+    normals.header = cloud->header;
+    normals.is_dense = false;
+    if (cloud->empty()) return;
+    tree.setInputCloud(cloud);
+
+    // The chunks are taken in order by whoever is free. The helper tasks only touch the clouds
+    // after taking a chunk, so one that starts after the last chunk is taken just returns.
+    struct Work {
+        NormalEstimator estimator;
+        const pcl::PointCloud<pcl::PointXYZRGB>* cloud;
+        const pcl::search::KdTree<pcl::PointXYZRGB>* tree;
+        pcl::PointCloud<pcl::Normal>* normals;
+        Eigen::Vector3f viewpoint;
+        size_t chunks;
+        std::atomic<size_t> next{ 0 };
+        size_t done = 0;
+        std::mutex mtx;
+        std::condition_variable finished;
+    };
+    auto work = std::make_shared<Work>();
+    work->estimator = *this;
+    work->estimator.chunk_size = chunk_size > 0 ? chunk_size : 4096;
+    work->cloud = cloud.get();
+    work->tree = &tree;
+    work->normals = &normals;
+    work->viewpoint = viewpoint;
+    work->chunks = (cloud->size() + work->estimator.chunk_size - 1) / work->estimator.chunk_size;
+
+    auto run = [work]() {
+        size_t chunk;
+        while ((chunk = work->next.fetch_add(1)) < work->chunks) {
+            size_t begin = chunk * work->estimator.chunk_size;
+            size_t end = begin + work->estimator.chunk_size;
+            if (end > work->cloud->size()) end = work->cloud->size();
+            work->estimator.computeChunk(*work->cloud, *work->tree, work->viewpoint, begin, end, *work->normals);
+            std::lock_guard<std::mutex> lock(work->mtx);
+            if (++work->done == work->chunks) work->finished.notify_all();
+        }
+    };
+    size_t helpers = pool != nullptr && threads > 1 ? static_cast<size_t>(threads - 1) : 0;
+    if (helpers > work->chunks - 1) helpers = work->chunks - 1;
+    for (size_t i = 0; i < helpers; i++) pool->enqueueTask(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(work->mtx);
+    work->finished.wait(lock, [&work]() { return work->done == work->chunks; });
+}
@@ -4,56 +4,69 @@
 #include "EDSDKTypes.h"
 #include "CameraEvent.h"
 
-EdsError PreSetting(std::vector<EdsCameraRef> const& cameraArray, std::vector<EdsUInt64> const& bodyID)
+// Opens the session of one camera and sets it up for remote shooting, saving to the host
+EdsError PreSettingCamera(EdsCameraRef camera, EdsUInt64 bodyID)
 {
 	EdsError	 err = EDS_ERR_OK;
 	EdsUInt32 saveto;
 	// Specify where to save images
 	saveto = kEdsSaveTo_Host;	//kEdsSaveTo_Host or kEdsSaveTo_Camera or kEdsSaveTo_Both;
 
+	err = EdsOpenSession(camera);
+	if (err != EDS_ERR_OK)
+	{
+		return err;
+	}
+
+	//for powershot
+	err = EdsSendCommand(camera, kEdsCameraCommand_SetRemoteShootingMode, kDcRemoteShootingModeStart);
+
+	err = EdsSetPropertyData(camera, kEdsPropID_SaveTo, 0, sizeof(saveto), &saveto);
+
+	if (err == EDS_ERR_OK)
+	{
+		err = EdsSendStatusCommand(camera, kEdsCameraStatusCommand_UILock, 0);
+	}
+
+	if (err == EDS_ERR_OK)
+	{
+		EdsCapacity capacity = { 0x7FFFFFFF, 0x1000, 1 };
+		err = EdsSetCapacity(camera, capacity);
+	}
+	if (err == EDS_ERR_OK)
+	{
+		EdsSendStatusCommand(camera, kEdsCameraStatusCommand_UIUnLock, 0);
+	}
+
+	//Set Property Event Handler
+	if (err == EDS_ERR_OK)
+	{
+		err = EdsSetPropertyEventHandler(camera, kEdsPropertyEvent_All, handlePropertyEvent, (EdsVoid*)bodyID);// bodyID
+	}
+
+	//Set Object Event Handler
+	if (err == EDS_ERR_OK)
+	{
+		err = EdsSetObjectEventHandler(camera, kEdsObjectEvent_All, handleObjectEvent, (EdsVoid*)bodyID);
+	}
+
+	//Set State Event Handler
+	if (err == EDS_ERR_OK)
+	{
+		err = EdsSetCameraStateEventHandler(camera, kEdsStateEvent_All, handleSateEvent, (EdsVoid*)bodyID);
+	}
+	return err;
+}
+
+EdsError PreSetting(std::vector<EdsCameraRef> const& cameraArray, std::vector<EdsUInt64> const& bodyID)
+{
+	EdsError	 err = EDS_ERR_OK;
+
 	std::cout << "session openning" << std::endl;
 
 	for (EdsUInt32 i = 0; i < cameraArray.size(); i++)
 	{
-		err = EdsOpenSession(cameraArray[i]);
-
-		//for powershot
-		err = EdsSendCommand(cameraArray[i], kEdsCameraCommand_SetRemoteShootingMode, kDcRemoteShootingModeStart);
-
-		err = EdsSetPropertyData(cameraArray[i], kEdsPropID_SaveTo, 0, sizeof(saveto), &saveto);
-
-		if (err == EDS_ERR_OK)
-		{
-			err = EdsSendStatusCommand(cameraArray[i], kEdsCameraStatusCommand_UILock, 0);
-		}
-
-		if (err == EDS_ERR_OK)
-		{
-			EdsCapacity capacity = { 0x7FFFFFFF, 0x1000, 1 };
-			err = EdsSetCapacity(cameraArray[i], capacity);
-		}
-		if (err == EDS_ERR_OK)
-		{
-			EdsSendStatusCommand(cameraArray[i], kEdsCameraStatusCommand_UIUnLock, 0);
-		}
-
-		//Set Property Event Handler
-		if (err == EDS_ERR_OK)
-		{
-			err = EdsSetPropertyEventHandler(cameraArray[i], kEdsPropertyEvent_All, handlePropertyEvent, (EdsVoid*)bodyID[i]);// bodyID
-		}
-
-		//Set Object Event Handler
-		if (err == EDS_ERR_OK)
-		{
-			err = EdsSetObjectEventHandler(cameraArray[i], kEdsObjectEvent_All, handleObjectEvent, (EdsVoid*)bodyID[i]);
-		}
-
-		//Set State Event Handler
-		if (err == EDS_ERR_OK)
-		{
-			err = EdsSetCameraStateEventHandler(cameraArray[i], kEdsStateEvent_All, handleSateEvent, (EdsVoid*)bodyID[i]);
-		}
+		err = PreSettingCamera(cameraArray[i], bodyID[i]);
 	}
 	return err;
 }
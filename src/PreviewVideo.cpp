@@ -0,0 +1,397 @@
+// Preview Video: Headless version of scripts/imgs_to_video.py and scripts/orbit_video_generator.py,
+// to make the preview videos on the processing servers right after a scan.
+//
+// images: one video per camera of every DSLR folder of an object (cam3 of pose-a ->
+//         media/<object>_pose-a_DSLR_cam3.mp4). Frames are decoded and resized on all cores and
+//         kept at most --prefetch frames ahead of the encoder.
+// orbit:  orbit of a cloud (a .ply file, or the realsense clouds of a pose merged) drawn by a CPU
+//         splat rasterizer: a turn around the up axis, a tilt, a second turn and the tilt back.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <memory>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/io/ply_io.h>
+#include <Eigen/Dense>
+
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+using std::cout;
+using std::endl;
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> ColorCloud;
+
+struct VideoOptions {
+    std::string mode;
+    std::string input;
+    std::string output;                                 // Folder (images) or file (orbit)
+    double fps = 24;
+    std::string fourcc = "mp4v";
+    size_t prefetch = 16;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    // images
+    int downscale = 4;
+    std::vector<std::string> exclude;
+    size_t max_frames = 0;
+    // orbit
+    std::vector<double> size = { 1280, 720 };
+    std::string up = "z";
+    double step = 1;                                    // Degrees per frame
+    double elevation = 20;
+    double tilt = 60;
+    double fov = 40;
+    double zoom = 1;
+    int point_size = 2;
+    std::vector<double> background = { 0, 0, 0 };
+};
+
+void printUsage() {
+    cout << "Usage: PreviewVideo images <object_dir> [--output <dir>] [--downscale N] [--exclude a,b]\n"
+         << "                   [--max-frames N] [--fps N] [--prefetch N] [--threads N]\n"
+         << "       PreviewVideo orbit <cloud.ply|pose_dir> [--output <file.mp4>] [--size w,h] [--up z|y|-y]\n"
+         << "                   [--step deg] [--elevation deg] [--tilt deg] [--fov deg] [--zoom N]\n"
+         << "                   [--point-size px] [--background r,g,b] [--fps N] [--prefetch N] [--threads N]\n";
+}
+
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stod(item));
+    }
+    return values;
+}
+
+std::vector<std::string> parseNames(const std::string& text) {
+    std::vector<std::string> names;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) names.push_back(item);
+    }
+    return names;
+}
+
+bool parseArgs(int argc, char* argv[], VideoOptions& options) {
+    if (argc < 3) return false;
+    options.mode = argv[1];
+    options.input = argv[2];
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--fps" && has_value) options.fps = std::stod(argv[++i]);
+        else if (arg == "--fourcc" && has_value) options.fourcc = argv[++i];
+        else if (arg == "--prefetch" && has_value) options.prefetch = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg == "--threads" && has_value) options.threads = std::stoul(argv[++i]);
+        else if (arg == "--downscale" && has_value) options.downscale = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--exclude" && has_value) options.exclude = parseNames(argv[++i]);
+        else if (arg == "--max-frames" && has_value) options.max_frames = std::stoul(argv[++i]);
+        else if (arg == "--size" && has_value) options.size = parseList(argv[++i]);
+        else if (arg == "--up" && has_value) options.up = argv[++i];
+        else if (arg == "--step" && has_value) options.step = std::stod(argv[++i]);
+        else if (arg == "--elevation" && has_value) options.elevation = std::stod(argv[++i]);
+        else if (arg == "--tilt" && has_value) options.tilt = std::stod(argv[++i]);
+        else if (arg == "--fov" && has_value) options.fov = std::stod(argv[++i]);
+        else if (arg == "--zoom" && has_value) options.zoom = std::stod(argv[++i]);
+        else if (arg == "--point-size" && has_value) options.point_size = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--background" && has_value) options.background = parseList(argv[++i]);
+        else return false;
+    }
+    return (options.mode == "images" || options.mode == "orbit") && options.size.size() == 2
+        && options.background.size() == 3 && options.step > 0
+        && (options.up == "z" || options.up == "y" || options.up == "-y");
+}
+
+// Writes count frames made by the pool. At most prefetch frames are decoded or rendered ahead of the
+// encoder, so the memory stays bounded and the encoder never waits when the pool keeps up.
+// Empty frames are skipped. Returns the number of frames written.
+size_t writeVideo(const fs::path& output, size_t count, const std::function<cv::Mat(size_t)>& make_frame,
+                  const VideoOptions& options, ThreadPool& pool) {
+    std::deque<std::future<cv::Mat>> queue;
+    size_t next = 0;
+    auto submit = [&]() {
+        size_t index = next++;
+        auto job = std::make_shared<std::packaged_task<cv::Mat()>>([index, &make_frame]() { return make_frame(index); });
+        queue.push_back(job->get_future());
+        pool.enqueueTask([job]() { (*job)(); });
+    };
+    while (next < count && queue.size() < options.prefetch) submit();
+
+    cv::VideoWriter writer;
+    cv::Size frame_size;
+    size_t written = 0;
+    while (!queue.empty()) {
+        cv::Mat frame = queue.front().get();
+        queue.pop_front();
+        if (next < count) submit();
+        if (frame.empty()) continue;
+
+        if (!writer.isOpened()) {
+            frame_size = frame.size();
+            const std::string& code = options.fourcc;
+            if (code.size() != 4 || !writer.open(output.string(), cv::VideoWriter::fourcc(code[0], code[1], code[2], code[3]),
+                                                 options.fps, frame_size)) {
+                std::cerr << "Failed to open video for writing: " << output.string() << endl;
+                // Drain the queue before returning, the jobs still reference make_frame
+                for (auto& pending : queue) pending.wait();
+                return 0;
+            }
+        }
+        if (frame.size() != frame_size) {
+            cv::resize(frame, frame, frame_size, 0, 0, cv::INTER_AREA);
+        }
+        writer.write(frame);
+        written++;
+    }
+    writer.release();
+    return written;
+}
+
+// Decodes an image at 1/downscale of its size, in the DCT domain for JPEGs when downscale is 2, 4 or 8
+cv::Mat loadFrame(const fs::path& file, int downscale) {
+    int flag = cv::IMREAD_COLOR;
+    if (downscale == 2) flag = cv::IMREAD_REDUCED_COLOR_2;
+    else if (downscale == 4) flag = cv::IMREAD_REDUCED_COLOR_4;
+    else if (downscale == 8) flag = cv::IMREAD_REDUCED_COLOR_8;
+
+    cv::Mat image = cv::imread(file.string(), flag);
+    if (image.empty()) {
+        std::cerr << "Warning: Could not read image " << file.string() << ". Skipping." << endl;
+        return image;
+    }
+    if (flag == cv::IMREAD_COLOR && downscale > 1) {
+        cv::resize(image, image, cv::Size(image.cols / downscale, image.rows / downscale), 0, 0, cv::INTER_AREA);
+    }
+    return image;
+}
+
+int runImages(const VideoOptions& options) {
+    fs::path root = fs::absolute(options.input);
+    fs::path output_dir = options.output.empty() ? root / "media" : fs::path(options.output);
+    std::string object = root.filename().string();
+
+    // Folder -> camera -> images, the camera being the name up to the first _
+    const std::vector<std::string> extensions = { ".png", ".jpg", ".jpeg", ".bmp", ".tiff", ".tif" };
+    std::map<fs::path, std::map<std::string, std::vector<fs::path>>> sequences;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file() || entry.path().parent_path().filename() != "DSLR") continue;
+        std::string name = entry.path().filename().string();
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (std::find(extensions.begin(), extensions.end(), extension) == extensions.end()) continue;
+        bool excluded = std::any_of(options.exclude.begin(), options.exclude.end(),
+                                    [&name](const std::string& text) { return name.find(text) != std::string::npos; });
+        if (excluded) continue;
+        sequences[entry.path().parent_path()][name.substr(0, name.find('_'))].push_back(entry.path());
+    }
+    if (sequences.empty()) {
+        std::cerr << "No DSLR images in " << options.input << endl;
+        return 1;
+    }
+    fs::create_directories(output_dir);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ThreadPool pool(options.threads);
+    // One encoder thread per video, all decoding on the pool
+    std::vector<std::future<size_t>> videos;
+    std::vector<fs::path> outputs;
+    for (auto& folder : sequences) {
+        std::string pose = folder.first.parent_path().lexically_relative(root).generic_string();
+        std::string prefix = object + (pose == "." ? "" : "_" + pose) + "_DSLR_";
+        std::replace(prefix.begin(), prefix.end(), '/', '_');
+        for (auto& camera : folder.second) {
+            std::vector<fs::path>& files = camera.second;
+            std::sort(files.begin(), files.end());
+            if (options.max_frames > 0 && files.size() > options.max_frames) {
+                cout << "[WARNING] Max Frames exceeded, reducing to " << options.max_frames << " frames." << endl;
+                files.resize(options.max_frames);
+            }
+            fs::path output = output_dir / (prefix + camera.first + ".mp4");
+            outputs.push_back(output);
+            videos.push_back(std::async(std::launch::async, [&files, output, &options, &pool]() {
+                auto frame = [&files, &options](size_t index) { return loadFrame(files[index], options.downscale); };
+                return writeVideo(output, files.size(), frame, options, pool);
+            }));
+        }
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < videos.size(); i++) {
+        size_t frames = videos[i].get();
+        total += frames;
+        cout << "Video saved to " << outputs[i].string() << " (" << frames << " frames)" << endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    cout << total << " frames in " << seconds << " s (" << total / seconds << " fps)" << endl;
+    return 0;
+}
+
+// Draws a point cloud as square splats with a depth buffer, from a camera orbiting its center
+class SplatRenderer {
+public:
+    SplatRenderer(const ColorCloud& cloud, const VideoOptions& options) : options(options) {
+        // Points centered on the bounding box, with the up axis as z
+        Eigen::Matrix3f up = Eigen::Matrix3f::Identity();
+        if (options.up == "y") up << 1, 0, 0, 0, 0, -1, 0, 1, 0;
+        else if (options.up == "-y") up << 1, 0, 0, 0, 0, 1, 0, -1, 0;
+
+        Eigen::Vector3f min_point = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f max_point = -min_point;
+        points.reserve(cloud.size());
+        colors.reserve(cloud.size());
+        for (const auto& point : cloud.points) {
+            if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) continue;
+            Eigen::Vector3f position = up * point.getVector3fMap();
+            min_point = min_point.cwiseMin(position);
+            max_point = max_point.cwiseMax(position);
+            points.push_back(position);
+            colors.emplace_back(point.b, point.g, point.r);
+        }
+        Eigen::Vector3f center = (min_point + max_point) / 2;
+        float radius = 0;
+        for (auto& point : points) {
+            point -= center;
+            radius = std::max(radius, point.norm());
+        }
+
+        double half_fov = options.fov * M_PI / 360;
+        distance = static_cast<float>(std::max(radius, 1e-3f) / std::sin(half_fov) / options.zoom);
+        focal = static_cast<float>(options.size[1] / 2 / std::tan(half_fov));
+    }
+
+    size_t size() const { return points.size(); }
+
+    // Camera at yaw degrees around the up axis, elevation degrees above the horizon
+    cv::Mat render(double yaw, double elevation) const {
+        int width = static_cast<int>(options.size[0]);
+        int height = static_cast<int>(options.size[1]);
+        cv::Vec3b background(static_cast<uchar>(options.background[2]), static_cast<uchar>(options.background[1]),
+                             static_cast<uchar>(options.background[0]));
+        cv::Mat image(height, width, CV_8UC3, cv::Scalar(background[0], background[1], background[2]));
+        std::vector<float> depth(static_cast<size_t>(width) * height, std::numeric_limits<float>::max());
+
+        // The camera looks along +y with z up, x is to the right
+        Eigen::Matrix3f rotation = (Eigen::AngleAxisf(static_cast<float>(elevation * M_PI / 180), Eigen::Vector3f::UnitX()) *
+                                    Eigen::AngleAxisf(static_cast<float>(-yaw * M_PI / 180), Eigen::Vector3f::UnitZ())).toRotationMatrix();
+        float cx = width / 2.0f, cy = height / 2.0f;
+        int half = options.point_size / 2;
+        for (size_t i = 0; i < points.size(); i++) {
+            Eigen::Vector3f p = rotation * points[i];
+            float z = distance + p.y();
+            if (z < 1e-3f) continue;
+            int u = static_cast<int>(cx + focal * p.x() / z);
+            int v = static_cast<int>(cy - focal * p.z() / z);
+            int u0 = std::max(0, u - half), u1 = std::min(width - 1, u - half + options.point_size - 1);
+            int v0 = std::max(0, v - half), v1 = std::min(height - 1, v - half + options.point_size - 1);
+            for (int r = v0; r <= v1; r++) {
+                float* depth_row = depth.data() + static_cast<size_t>(r) * width;
+                cv::Vec3b* row = image.ptr<cv::Vec3b>(r);
+                for (int c = u0; c <= u1; c++) {
+                    if (z < depth_row[c]) {
+                        depth_row[c] = z;
+                        row[c] = colors[i];
+                    }
+                }
+            }
+        }
+        return image;
+    }
+
+private:
+    const VideoOptions& options;
+    std::vector<Eigen::Vector3f> points;
+    std::vector<cv::Vec3b> colors;
+    float distance = 1;
+    float focal = 1;
+};
+
+int runOrbit(const VideoOptions& options) {
+    fs::path input = fs::absolute(options.input);
+    std::vector<fs::path> files;
+    fs::path output;
+    if (fs::is_directory(input)) {
+        // A pose folder, merge its realsense clouds like AlignClouds
+        for (const auto& entry : fs::directory_iterator(input / "realsense")) {
+            std::string name = entry.path().filename().string();
+            if (name.size() > 10 && name.substr(name.size() - 10) == "_cloud.ply") files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+        output = input.parent_path() / "media" / (input.filename().string() + "_orbit.mp4");
+    } else {
+        files.push_back(input);
+        output = input.parent_path() / "media" / (input.stem().string() + "_orbit.mp4");
+    }
+    if (!options.output.empty()) output = options.output;
+
+    ThreadPool pool(options.threads);
+    std::vector<std::future<ColorCloud::Ptr>> loaded;
+    for (const auto& file : files) {
+        auto job = std::make_shared<std::packaged_task<ColorCloud::Ptr()>>([file]() {
+            ColorCloud::Ptr cloud(new ColorCloud);
+            if (pcl::io::loadPLYFile<pcl::PointXYZRGB>(file.string(), *cloud) < 0) {
+                std::cerr << "Failed to load " << file.string() << endl;
+            }
+            return cloud;
+        });
+        loaded.push_back(job->get_future());
+        pool.enqueueTask([job]() { (*job)(); });
+    }
+    ColorCloud merged;
+    for (auto& cloud : loaded) {
+        merged += *cloud.get();
+    }
+    SplatRenderer renderer(merged, options);
+    if (renderer.size() == 0) {
+        std::cerr << "No points in " << options.input << endl;
+        return 1;
+    }
+    cout << renderer.size() << " points from " << files.size() << " clouds" << endl;
+
+    // Turn, tilt, turn at the new elevation, tilt back (the loops of orbit_video_generator.py)
+    std::vector<std::pair<double, double>> views;
+    size_t turn = static_cast<size_t>(std::round(360 / options.step));
+    size_t tilt = static_cast<size_t>(std::round(std::abs(options.tilt) / options.step));
+    double tilt_step = options.tilt < 0 ? -options.step : options.step;
+    for (size_t i = 0; i < turn; i++) views.emplace_back(i * options.step, options.elevation);
+    for (size_t i = 0; i < tilt; i++) views.emplace_back(0, options.elevation + (i + 1) * tilt_step);
+    for (size_t i = 0; i < turn; i++) views.emplace_back(i * options.step, options.elevation + tilt * tilt_step);
+    for (size_t i = 0; i < tilt; i++) views.emplace_back(0, options.elevation + (tilt - i - 1) * tilt_step);
+
+    fs::create_directories(output.parent_path());
+    auto start = std::chrono::high_resolution_clock::now();
+    auto frame = [&views, &renderer](size_t index) { return renderer.render(views[index].first, views[index].second); };
+    size_t frames = writeVideo(output, views.size(), frame, options, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    cout << "Saved video as " << output.string() << " (" << frames << " frames in " << seconds << " s)" << endl;
+    return frames > 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    VideoOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    if (!fs::exists(options.input)) {
+        std::cerr << "Not found: " << options.input << endl;
+        return 1;
+    }
+    return options.mode == "images" ? runImages(options) : runOrbit(options);
+}
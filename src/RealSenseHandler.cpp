@@ -6,6 +6,12 @@
 #include <sstream>
 #include <fstream>
 #include <typeinfo>
+#include <filesystem>
+#include <algorithm>
+#include <future>
+#include <chrono>
+#include <limits>
+#include <cmath>
 
 #include <nlohmann/json.hpp>
 
@@ -14,13 +20,15 @@
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/common/transforms.h>
-#include <pcl/filters/passthrough.h>
 #include <pcl/filters/statistical_outlier_removal.h>
 #include <pcl/filters/voxel_grid.h>
-#include <pcl/features/normal_3d.h>
-#include <pcl/features/normal_3d_omp.h>
+
+#include <librealsense2/rsutil.h>
 
 #include "RealSenseHandler.h"
+#include "DeviceStartup.h"
+#include "NormalEstimator.h"
+#include "Scheduler.h"
 #include "DebugUtils.h"
 
 using std::string;
@@ -43,46 +51,224 @@ Eigen::Matrix4f createRotationMatrix(float angle_degrees)
     return transformation;
 }
 
-RealSenseHandler::RealSenseHandler() {
-    //Configure Depth Frame Filters (These are default in RSViewer)
-    threshold_filter.set_option(RS2_OPTION_MIN_DISTANCE, 0.2f); // Minimum threshold distance in meters
-    threshold_filter.set_option(RS2_OPTION_MAX_DISTANCE, 1.5f); // Maximum threshold distance in meters
-    decimation_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, 2); // Decimation magnitude
-    spatial_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, 0.5f); // Spatial filter smooth alpha
-    spatial_filter.set_option(RS2_OPTION_FILTER_SMOOTH_DELTA, 20.0f); // Spatial filter smooth delta
-    spatial_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, 2); // Spatial filter magnitude
-    temporal_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, 0.4f); // Temporal filter smooth alpha
-    temporal_filter.set_option(RS2_OPTION_FILTER_SMOOTH_DELTA, 20.0f); // Temporal filter smooth delta
+// Gives the frameset the capture time of its depth frame in host milliseconds. Global time
+// stamps and the arrival metadata are in the host clock domain. The hardware clock of the
+// device is not, so without them the time the host received the frameset is used.
+TimedFrameset timeFrameset(const rs2::frameset& fs, double received_ms)
+{
+    TimedFrameset timed;
+    timed.frameset = fs;
+    timed.time_ms = received_ms;
+    rs2::depth_frame depth = fs.get_depth_frame();
+    if (depth.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_GLOBAL_TIME) {
+        timed.time_ms = depth.get_timestamp();
+        timed.host_time = true;
+    }
+    else if (depth.supports_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL)) {
+        timed.time_ms = static_cast<double>(depth.get_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL));
+        timed.host_time = true;
+    }
+    return timed;
+}
+
+double hostTimeMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Returns the mean absolute depth change (in mm) between two depth frames, sampled every
+// step pixels over a centered region covering roi of the image. Pixels without depth in
+// either frame are ignored. Returns a negative value when no pixel could be compared.
+float getDepthDeltaMm(const rs2::depth_frame& prev, const rs2::depth_frame& curr, float roi, int step)
+{
+    int width = curr.get_width();
+    int height = curr.get_height();
+    if (prev.get_width() != width || prev.get_height() != height) {
+        return -1.0f;
+    }
+
+    const uint16_t* prev_data = reinterpret_cast<const uint16_t*>(prev.get_data());
+    const uint16_t* curr_data = reinterpret_cast<const uint16_t*>(curr.get_data());
+    int x0 = static_cast<int>(width * (1.0f - roi) / 2.0f);
+    int y0 = static_cast<int>(height * (1.0f - roi) / 2.0f);
+    int x1 = width - x0;
+    int y1 = height - y0;
+
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    for (int y = y0; y < y1; y += step) {
+        const uint16_t* prev_row = prev_data + y * width;
+        const uint16_t* curr_row = curr_data + y * width;
+        for (int x = x0; x < x1; x += step) {
+            if (prev_row[x] == 0 || curr_row[x] == 0) continue;
+            sum += std::abs(static_cast<int>(curr_row[x]) - static_cast<int>(prev_row[x]));
+            count++;
+        }
+    }
+    if (count == 0) {
+        return -1.0f;
+    }
+    return (static_cast<float>(sum) / count) * curr.get_units() * 1000.0f;
+}
+
+// Color of pixel (x, y) of a YUYV frame (BT.601), each pair of pixels shares U and V
+void yuyvPixel(const uint8_t* data, int stride, int x, int y, uint8_t& r, uint8_t& g, uint8_t& b)
+{
+    const uint8_t* pair = data + y * stride + (x & ~1) * 2;
+    int luma = pair[(x & 1) * 2] - 16;
+    int u = pair[1] - 128;
+    int v = pair[3] - 128;
+    auto clamp = [](int value) { return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value)); };
+    r = clamp((298 * luma + 409 * v + 128) >> 8);
+    g = clamp((298 * luma - 100 * u - 208 * v + 128) >> 8);
+    b = clamp((298 * luma + 516 * u + 128) >> 8);
+}
+
+// Where the points of a depth frame are found in a color frame that is not aligned to it
+struct ColorProjection {
+    Eigen::Matrix4f depth_to_color = Eigen::Matrix4f::Identity();
+    rs2_intrinsics intrinsics;
+    const uint8_t* data = nullptr;
+    int stride = 0;
+    bool yuyv = false;
+};
+
+ColorProjection getColorProjection(const rs2::depth_frame& depth, const rs2::video_frame& color)
+{
+    ColorProjection projection;
+    rs2_extrinsics extrinsics = depth.get_profile().get_extrinsics_to(color.get_profile());
+    projection.depth_to_color.topLeftCorner<3, 3>() = Eigen::Map<const Eigen::Matrix3f>(extrinsics.rotation);
+    projection.depth_to_color.topRightCorner<3, 1>() = Eigen::Map<const Eigen::Vector3f>(extrinsics.translation);
+    projection.intrinsics = color.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+    projection.data = reinterpret_cast<const uint8_t*>(color.get_data());
+    projection.stride = color.get_stride_in_bytes();
+    projection.yuyv = color.get_profile().format() == RS2_FORMAT_YUYV;
+    return projection;
+}
+
+// Colors the points of a cloud by projecting them into the color frame, to_depth brings them back
+// to the depth camera. Only the points that are kept are projected, instead of aligning the whole
+// frame. Points outside of the color image are black, as with rs2::align.
+void colorizePoints(pcl::PointCloud<pcl::PointXYZRGB>& cloud, const Eigen::Matrix4f& to_depth, const ColorProjection& projection)
+{
+    Eigen::Matrix4f to_color = projection.depth_to_color * to_depth;
+    Eigen::Matrix3f rotation = to_color.topLeftCorner<3, 3>();
+    Eigen::Vector3f translation = to_color.topRightCorner<3, 1>();
+    int width = projection.intrinsics.width;
+    int height = projection.intrinsics.height;
+    for (auto& point : cloud.points) {
+        Eigen::Vector3f color_point = rotation * point.getVector3fMap() + translation;
+        float pixel[2];
+        rs2_project_point_to_pixel(pixel, &projection.intrinsics, color_point.data());
+        int x = static_cast<int>(pixel[0] + 0.5f);
+        int y = static_cast<int>(pixel[1] + 0.5f);
+        if (color_point.z() <= 0 || x < 0 || y < 0 || x >= width || y >= height) {
+            point.r = point.g = point.b = 0;
+        } else if (projection.yuyv) {
+            yuyvPixel(projection.data, projection.stride, x, y, point.r, point.g, point.b);
+        } else {
+            const uint8_t* pixel_data = projection.data + y * projection.stride + 3 * x;
+            point.r = pixel_data[0];
+            point.g = pixel_data[1];
+            point.b = pixel_data[2];
+        }
+    }
+}
 
+RealSenseHandler::RealSenseHandler() {
+    // The depth frame filters are configured from the config (apply_filters)
 }
 
 RealSenseHandler::~RealSenseHandler() {
     std::cout << "Shutting down RealSense Handler... ";
     running = false;
-    for (auto& pipe : pipeline_map) {
-            pipe.second.stop();
+    stop_frame_threads();
+    for (int slot : started) {
+            devices[slot].pipe->stop();
             cout << ". ";
     }
-    // for (auto& th : frame_thread_map) {
-    //         th.second.join();
-    // }
     std::cout << "Done.\n";
 }
 
 void RealSenseHandler::initialize() {
     std::cout << "Initializing RealSense Handler...\n";
-    ConfigHandler& config = ConfigHandler::getInstance();
+    load_transforms();
+
+    // Check if the device is returning frames
+    try {
+        device_check();
+        initialized = true;
+    }
+    catch(const rs2::error & e) {
+        std::cerr << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n " << e.what() << endl;
+    }
+    apply_filters();
+}
+
+bool RealSenseHandler::is_initialized() const {
+    return initialized;
+}
 
-    // Get Realsense camera transforms from JSON file
-    nlohmann::json realsense_json;
+// Applies a reloaded config to the running devices: transforms and depth filters are updated in
+// place, the pipelines are only restarted when the stream settings or the playback folder changed.
+// Returns true if they were restarted (the caller may want warmup frames).
+bool RealSenseHandler::apply_config() {
+    auto start = std::chrono::steady_clock::now();
+    // The frame threads hold on to their device, join them before new transforms can grow devices.
+    // The next synchronized capture starts them again.
+    stop_frame_threads();
+    load_transforms();
+
+    bool restart = stream_settings() != active_stream;
+    if (restart) {
+        cout << "RealSense stream settings changed, restarting the pipelines...\n";
+        std::vector<std::future<void>> stops;
+        for (int slot : started) {
+            stops.push_back(std::async(std::launch::async, [this, slot]() {
+                try {
+                    devices[slot].pipe->stop();
+                }
+                catch(const rs2::error & e) {
+                    std::cerr << "[" << device_name(devices[slot].serial) << "] failed to stop: " << e.what() << endl;
+                }
+                devices[slot].pipe.reset();
+            }));
+        }
+        for (auto& stop : stops) {
+            stop.get();
+        }
+        started.clear();
+        try {
+            device_check();
+        }
+        catch(const rs2::error & e) {
+            std::cerr << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n " << e.what() << endl;
+        }
+    }
+    apply_filters();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    cout << "RealSense config applied in " << ms << " ms" << (restart ? " (pipelines restarted)" : "") << endl;
+    return restart;
+}
+
+// Loads the camera transforms, each camera gets a slot in the device registry. The file is only
+// parsed again when its content changed.
+void RealSenseHandler::load_transforms() {
+    ConfigHandler& config = ConfigHandler::getInstance();
     std::string transform_dir = config.getValue<std::string>("realsense.transform_path");
-    std::cout << "Loading Realsense camera transforms...\n";
     std::string transform_file = config.getValue<std::string>("realsense.transform_file");
     std::ifstream realsense_file(transform_dir + transform_file);
-    realsense_json = nlohmann::json::parse(realsense_file);
-    std::cout << "Realsense camera transforms loaded.\n";
+    std::stringstream text;
+    text << realsense_file.rdbuf();
+    if (text.str() == transforms_text) return;
 
-    // Load camera names and transforms from JSON
+    std::cout << "Loading Realsense camera transforms...\n";
+    nlohmann::json realsense_json = nlohmann::json::parse(text.str());
+    transforms_text = text.str();
+
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    view_table.clear();
+    table_angles = 0;
     for (auto& [key, value] : realsense_json.items()) {
         Eigen::Matrix4f transform_matrix = Eigen::Matrix4f::Identity();
         for (int i = 0; i < 4; ++i) {
@@ -90,179 +276,621 @@ void RealSenseHandler::initialize() {
                 transform_matrix(i, j) = value["transform_matrix"][i][j].get<float>();
             }
         }
-        camera_names[key] = value["name"].get<std::string>();
-        camera_transforms[key] = transform_matrix;
+        int id = registry.add(DeviceKind::RealSense, key, value["name"].get<std::string>());
+        int slot = registry.info(id).slot;
+        if (slot >= static_cast<int>(devices.size())) devices.resize(slot + 1);
+        devices[slot].id = id;
+        devices[slot].serial = key;
+        devices[slot].transform = transform_matrix;
     }
+    std::cout << "Realsense camera transforms loaded.\n";
+}
 
-    // Check if the device is returning frames
-    try {
-        device_check();
+// Sets the depth filter options from the config, the filters keep their state. The decimation
+// magnitude comes from the stream profile of each device.
+void RealSenseHandler::apply_filters() {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    for (const std::string& filter : config.getValue<std::vector<std::string>>("realsense.depth_filter.chain")) {
+        if (filter != "decimation" && filter != "threshold" && filter != "spatial" && filter != "temporal") {
+            cout << "WARNING: Unknown depth filter " << filter << ", skipped.\n";
+        }
     }
-    catch(const rs2::error & e) {
-        std::cerr << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n " << e.what() << endl;
+    for (auto& device : devices) {
+        if (device.id < 0) continue;
+        device.decimation = stream_profile(device_name(device.serial)).value("decimation", 1);
+        if (device.decimation > 1) {
+            device.decimation_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, static_cast<float>(device.decimation));
+        }
+        device.buffers->setMaxIdle(config.getValue<size_t>("realsense.buffers_per_camera"));
+        std::lock_guard<std::mutex> lock(*device.filter_mtx);
+        device.threshold_filter.set_option(RS2_OPTION_MIN_DISTANCE, config.getValue<float>("realsense.depth_filter.threshold.min"));
+        device.threshold_filter.set_option(RS2_OPTION_MAX_DISTANCE, config.getValue<float>("realsense.depth_filter.threshold.max"));
+        device.spatial_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, config.getValue<float>("realsense.depth_filter.spatial.alpha"));
+        device.spatial_filter.set_option(RS2_OPTION_FILTER_SMOOTH_DELTA, config.getValue<float>("realsense.depth_filter.spatial.delta"));
+        device.spatial_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, config.getValue<float>("realsense.depth_filter.spatial.magnitude"));
+        device.temporal_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, config.getValue<float>("realsense.depth_filter.temporal.alpha"));
+        device.temporal_filter.set_option(RS2_OPTION_FILTER_SMOOTH_DELTA, config.getValue<float>("realsense.depth_filter.temporal.delta"));
     }
 }
 
+// Settings that need the pipelines to be restarted when they change (not the decimation, it is
+// applied on the host)
+nlohmann::json RealSenseHandler::stream_settings() const {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    nlohmann::json settings = config.getValue<nlohmann::json>("realsense.stream");
+    settings.erase("decimation");
+    for (auto& camera : settings["cameras"]) {
+        camera.erase("decimation");
+    }
+    settings["playback_dir"] = config.getValue<std::string>("realsense.playback_dir");
+    return settings;
+}
 
-// Checks for all connected realsense devices, starts a pipeline for each,
-// and adds them all to the pipelines vector.
-int RealSenseHandler::device_check() {
-    // Get the list of connected devices
-    auto devices_list = ctx.query_devices();
-    device_count = devices_list.size();
-    cout << device_count << " RealSense detected.\n";
-    
-    // Display device information
-    for (auto&& dev : devices_list) {
-        std::string serial = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
-        cout << "[" << camera_names[serial] << "] " << serial << endl;
+// Stream profile of a camera: realsense.stream with the entries of realsense.stream.cameras.<name>
+nlohmann::json RealSenseHandler::stream_profile(const std::string& name) const {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    nlohmann::json profile = config.getValue<nlohmann::json>("realsense.stream");
+    nlohmann::json cameras = profile.value("cameras", nlohmann::json::object());
+    profile.erase("cameras");
+    if (cameras.contains(name)) {
+        profile.update(cameras[name]);
     }
+    return profile;
+}
 
-    for (auto&& dev : devices_list) {
-        // Print Device Information
-        bool print_available_streams = false;
-        print_device(dev,print_available_streams);
+// Checks for all connected realsense devices (or the recordings of the playback folder) and
+// starts a pipeline for each of them.
+int RealSenseHandler::device_check() {
+    ConfigHandler& config = ConfigHandler::getInstance();
 
-        // Start device data streams
-        std::string serial = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
-        start_device(serial);
+    // Replay recorded devices instead of the connected ones if a playback folder is given
+    std::vector<std::pair<std::string, std::string>> sources;
+    std::string playback_dir = config.getValue<std::string>("realsense.playback_dir");
+    if (!playback_dir.empty()) {
+        sources = find_recordings(playback_dir);
+    } else {
+        // Get the list of connected devices
+        auto devices_list = ctx.query_devices();
+        cout << devices_list.size() << " RealSense detected.\n";
+
+        // Display device information
+        for (auto&& dev : devices_list) {
+            std::string serial = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+            cout << "[" << device_name(serial) << "] " << serial << endl;
+        }
+        for (auto&& dev : devices_list) {
+            // Print Device Information
+            bool print_available_streams = false;
+            print_device(dev,print_available_streams);
+            sources.emplace_back(dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER), "");
+        }
     }
+    device_count = sources.size();
+    active_stream = stream_settings();
+
+    // Register the devices first so their slots are known, then start all the pipelines at once,
+    // each with its own timeout and retries
+    auto start = std::chrono::steady_clock::now();
+    int timeout_ms = config.getValue<int>("startup.timeout_sec") * 1000;
+    int retries = config.getValue<int>("startup.retries");
+    std::vector<int> slots;
+    for (const auto& source : sources) {
+        slots.push_back(register_camera(source.first));
+    }
+    std::vector<std::future<bool>> starts;
+    for (size_t i = 0; i < sources.size(); i++) {
+        int slot = slots[i];
+        std::pair<std::string, std::string> source = sources[i];
+        starts.push_back(std::async(std::launch::async, [this, slot, source, timeout_ms, retries]() {
+            StartupResult result;
+            result.kind = "RealSense";
+            result.device = device_name(source.first);
+            result.step = source.second.empty() ? "pipeline" : "playback";
+            std::function<std::shared_ptr<rs2::pipeline>()> attempt = [this, source]() {
+                return start_device(source.first, source.second);
+            };
+            // A pipeline that starts after the device was given up is stopped again
+            std::function<void(std::shared_ptr<rs2::pipeline>&)> abandon = [](std::shared_ptr<rs2::pipeline>& late) {
+                try {
+                    late->stop();
+                } catch (const std::exception&) {}
+            };
+            std::shared_ptr<rs2::pipeline> pipe;
+            if (!runStartupStep(attempt, timeout_ms, retries, result, pipe, abandon)) {
+                std::cerr << "[" << result.device << "] failed to start: " << result.error << endl;
+                return false;
+            }
+            devices[slot].pipe = pipe;
+            return true;
+        }));
+    }
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    for (size_t i = 0; i < starts.size(); i++) {
+        int slot = slots[i];
+        if (!starts[i].get()) {
+            registry.setState(devices[slot].id, DeviceState::Failed);
+            continue;
+        }
+        registry.setState(devices[slot].id, DeviceState::Ready);
+        if (std::find(started.begin(), started.end(), slot) == started.end()) {
+            started.push_back(slot);
+        }
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    cout << started.size() << "/" << sources.size() << " RealSense started in " << ms << " ms\n";
 
     return device_count;
 }
 
-void RealSenseHandler::start_device(std::string serial_number) {
+// Serial number and file of every <serial>.bag recording in playback_dir, so scans can be run
+// without the cameras connected. Recordings are played in real time and repeat.
+std::vector<std::pair<std::string, std::string>> RealSenseHandler::find_recordings(std::string playback_dir) {
+    std::vector<std::pair<std::string, std::string>> recordings;
+    if (!std::filesystem::is_directory(playback_dir)) {
+        cout << "RealSense playback folder " << playback_dir << " not found.\n";
+        return recordings;
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(playback_dir)) {
+        if (entry.path().extension() != ".bag") continue;
+
+        std::string serial = entry.path().stem().string();
+        cout << "[" << device_name(serial) << "] " << serial << " (playback: " << entry.path().string() << ")\n";
+        recordings.emplace_back(serial, entry.path().string());
+    }
+    cout << recordings.size() << " RealSense recordings found.\n";
+
+    return recordings;
+}
+
+// Starts the pipeline of a registered device, called from the startup thread of the device
+std::shared_ptr<rs2::pipeline> RealSenseHandler::start_device(std::string serial_number, std::string playback_file) {
     // Define the configuration to use for each pipeline
     rs2::pipeline pipe(ctx);
     rs2::config cfg;
+    if (!playback_file.empty()) {
+        // Recordings keep the streams they were recorded with
+        cfg.enable_device_from_file(playback_file, true);
+        pipe.start(cfg);
+        cout << "[" << device_name(serial_number) << "][PLAYBACK STARTED]\n" << endl;
+        return std::make_shared<rs2::pipeline>(pipe);
+    }
     cfg.enable_device(serial_number);
     cfg.disable_all_streams();
     // cfg.enable_stream(RS2_STREAM_COLOR,640,360,RS2_FORMAT_RGB8,5); 
     // cfg.enable_stream(RS2_STREAM_DEPTH,640,360,RS2_FORMAT_Z16,5);  
-    cfg.enable_stream(RS2_STREAM_COLOR,1280,720,RS2_FORMAT_RGB8,5);
-    cfg.enable_stream(RS2_STREAM_DEPTH,1280,720,RS2_FORMAT_Z16,5); 	
+    nlohmann::json profile = stream_profile(device_name(serial_number));
+    int width = profile["width"].get<int>();
+    int height = profile["height"].get<int>();
+    int fps = profile["fps"].get<int>();
+    // With YUYV the frame is not converted to RGB on the host, only the colors of the points are
+    rs2_format color_format = profile.value("color_format", "rgb8") == "yuyv" ? RS2_FORMAT_YUYV : RS2_FORMAT_RGB8;
+    cfg.enable_stream(RS2_STREAM_COLOR,width,height,color_format,fps);
+    cfg.enable_stream(RS2_STREAM_DEPTH,width,height,RS2_FORMAT_Z16,fps);
 
     // Start the stream
     pipe.start(cfg);
-    cout << "[" << camera_names[serial_number] << "][DEVICE STARTED]\n" << endl;
-    
-    // Add the pipeline to the vector
-    pipeline_map[serial_number] = pipe;
+    cout << "[" << device_name(serial_number) << "][DEVICE STARTED]\n" << endl;
 
     // Separate thread method
     // std::thread frame_thread(&RealSenseHandler::frame_poll_thread, this,  pipe);
     // frame_thread_map[serial_number] = std::move(frame_thread);
+    return std::make_shared<rs2::pipeline>(pipe);
 }
 
-void RealSenseHandler::frame_poll_thread(rs2::pipeline pipe) {
-    std::string serial_number = pipe.get_active_profile().get_device().get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
-    rs2::frameset fs;
-    std::chrono::steady_clock::time_point start, end;
-    std::chrono::milliseconds duration;
-    start = std::chrono::high_resolution_clock::now();
-    while(running) {
-        // Poll for frames
-        fs = pipe.wait_for_frames();
-        // Lock the mutex before accessing the shared variable
+// Returns the slot of a device. Devices missing from the transform file get the next slot,
+// their name is the serial number and their clouds are not transformed.
+int RealSenseHandler::register_camera(const std::string& serial_number) {
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    int id = registry.find(DeviceKind::RealSense, serial_number);
+    if (id >= 0 && registry.info(id).slot < static_cast<int>(devices.size())) {
+        return registry.info(id).slot;
+    }
+
+    cout << "WARNING: No transform for RealSense " << serial_number << ", using identity.\n";
+    id = registry.add(DeviceKind::RealSense, serial_number, serial_number);
+    int slot = registry.info(id).slot;
+    if (slot >= static_cast<int>(devices.size())) devices.resize(slot + 1);
+    devices[slot].id = id;
+    devices[slot].serial = serial_number;
+    return slot;
+}
+
+// Name of a device for messages, the serial number if it is unknown
+std::string RealSenseHandler::device_name(const std::string& serial_number) const {
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    int id = registry.find(DeviceKind::RealSense, serial_number);
+    return id >= 0 ? registry.info(id).name : serial_number;
+}
+
+// Composes the turntable rotation of the angle with every camera transform
+std::vector<ViewTransform> RealSenseHandler::compute_views(int angle) const {
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    Eigen::Matrix4f rotation = createRotationMatrix(static_cast<float>(angle));
+    std::vector<ViewTransform> views(devices.size());
+    for (size_t slot = 0; slot < views.size(); slot++) {
+        views[slot].camera_id = devices[slot].id;
+        views[slot].slot = static_cast<int>(slot);
+        views[slot].camera_name = registry.info(devices[slot].id).name;
+        views[slot].transform = rotation * devices[slot].transform;
+        views[slot].origin = views[slot].transform.col(3);
+    }
+    return views;
+}
+
+// Builds the view transforms of every angle of a scan before it starts, so the capture loop
+// only copies them. Angles are start_degree + k * degree_inc, k < num_moves.
+void RealSenseHandler::prepare_scan(int start_degree, int degree_inc, int num_moves) {
+    table_start = start_degree;
+    table_inc = degree_inc;
+    table_angles = num_moves > 0 ? num_moves : 0;
+    table_cameras = static_cast<int>(devices.size());
+    view_table.clear();
+    view_table.reserve(static_cast<size_t>(table_angles) * table_cameras);
+    for (int k = 0; k < table_angles; k++) {
+        std::vector<ViewTransform> views = compute_views(start_degree + k * degree_inc);
+        view_table.insert(view_table.end(), views.begin(), views.end());
+    }
+}
+
+// View transforms of an angle, from the scan table when the angle is part of it
+std::vector<ViewTransform> RealSenseHandler::get_views(int angle) const {
+    int offset = angle - table_start;
+    if (table_inc == 0 || offset % table_inc != 0 || table_cameras != static_cast<int>(devices.size())) {
+        return compute_views(angle);
+    }
+    int index = offset / table_inc;
+    if (index < 0 || index >= table_angles) {
+        return compute_views(angle);
+    }
+    auto first = view_table.begin() + static_cast<size_t>(index) * table_cameras;
+    return std::vector<ViewTransform>(first, first + table_cameras);
+}
+
+// Keeps the latest framesets of a single device in its frames cache, so a synchronized
+// capture can pick the frameset closest to the trigger time instead of blocking.
+void RealSenseHandler::frame_poll_thread(int slot) {
+    Scheduler::getInstance().enterCaptureThread(static_cast<size_t>(slot));
+    rs2::pipeline pipe = *devices[slot].pipe;
+    while (polling) {
+        rs2::frameset fs;
+        // Use a short timeout so the thread notices when polling is stopped
+        if (!pipe.try_wait_for_frames(&fs, 1000)) {
+            continue;
+        }
+        double arrival_ms = hostTimeMs();
+        TimedFrameset timed = timeFrameset(fs, arrival_ms);
+
+        // Count the frames the device skipped since the last one
+        Device& device = devices[slot];
+        unsigned long long frame_number = fs.get_depth_frame().get_frame_number();
+        if (device.last_frame > 0 && frame_number > device.last_frame + 1) {
+            DeviceRegistry::getInstance().stats(device.id).dropped += static_cast<int>(frame_number - device.last_frame - 1);
+        }
+        device.last_frame = frame_number;
+
+        // Time from the host timestamp of the frame to this thread, when the frame has one
+        float latency_ms = static_cast<float>(arrival_ms - timed.time_ms);
+
+        // Update the cache with the latest frameset, dropping the oldest ones
         std::unique_lock<std::mutex> lock(framesetMutex);
-        // Update the shared variable with the latest frameset
-        frameset_map[serial_number] = fs;
-        // Release the lock
+        std::deque<TimedFrameset>& cache = devices[slot].frames;
+        cache.push_back(timed);
+        while (cache.size() > frame_cache_size) {
+            cache.pop_front();
+        }
+        if (timed.host_time && device.latency_ms.size() < max_latency_samples) {
+            device.latency_ms.push_back(latency_ms);
+        }
         lock.unlock();
+        framesetCondition.notify_all();
+    }
+    DebugUtils::printDebug(DeviceRegistry::getInstance().info(devices[slot].id).name + " frame thread closed.");
+}
+
+// Starts one frame polling thread per pipeline (used by the synchronized capture)
+void RealSenseHandler::start_frame_threads() {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    if (polling) return;
+
+    frame_cache_size = config.getValue<int>("realsense.sync.cache_size");
+    polling = true;
+    for (int slot : started) {
+        devices[slot].frame_thread = std::thread(&RealSenseHandler::frame_poll_thread, this, slot);
+    }
+    cout << "Started " << started.size() << " RealSense frame threads.\n";
+}
+
+void RealSenseHandler::stop_frame_threads() {
+    if (!polling) return;
+
+    polling = false;
+    for (int slot : started) {
+        if (devices[slot].frame_thread.joinable()) {
+            devices[slot].frame_thread.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(framesetMutex);
+    for (auto& device : devices) {
+        device.frames.clear();
+    }
+}
+
+// Waits until the device has produced a frameset at or after trigger_ms, then returns the
+// cached frameset whose timestamp is closest to trigger_ms. Returns an empty frameset on timeout.
+TimedFrameset RealSenseHandler::select_frameset(int slot, double trigger_ms, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(framesetMutex);
+    std::deque<TimedFrameset>& cache = devices[slot].frames;
+
+    // Wait for a frameset newer than the trigger, so frames on both sides of it are known
+    framesetCondition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
+        return !cache.empty() && cache.back().time_ms >= trigger_ms;
+    });
+
+    TimedFrameset best;
+    double best_delta = 0;
+    for (const auto& fs : cache) {
+        double delta = std::abs(fs.time_ms - trigger_ms);
+        if (!best.frameset || delta < best_delta) {
+            best = fs;
+            best_delta = delta;
+        }
+    }
+    return best;
+}
+
+// Devices left out of the capture when only_cameras is set (resumed scans)
+bool RealSenseHandler::skip_device(int slot) const {
+    return !only_cameras.empty() &&
+        only_cameras.count(DeviceRegistry::getInstance().info(devices[slot].id).name) == 0;
+}
+
+// Synchronized capture: every device contributes the frameset closest to a common trigger
+// time. The spread of the selected timestamps is kept in last_sync_info.
+void RealSenseHandler::get_synced_frames(int degree, const std::vector<ViewTransform>& views, int timeout_ms, bool background) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    start_frame_threads();
+
+    double trigger_ms = hostTimeMs();
+    trigger_ms += config.getValue<double>("realsense.sync.trigger_offset_ms");
+
+    // Select one frameset per device
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    std::vector<std::pair<int, TimedFrameset>> selected;
+    for (int slot : started) {
+        if (skip_device(slot)) continue;
+        TimedFrameset fs = select_frameset(slot, trigger_ms, timeout_ms);
+        if (!fs.frameset) {
+            fail_count++;
+            registry.stats(devices[slot].id).failures++;
+            cout << "WARNING: " << views[slot].camera_name << " did not get frames.\n";
+            continue;
+        }
+        selected.emplace_back(slot, fs);
+    }
+
+    // Record the per device offset to the trigger and the overall skew. The skew is only known
+    // when every device has host time stamps, the arrival times include the transfer delay.
+    last_sync_info = nlohmann::json::object();
+    double min_ms = 0, max_ms = 0;
+    bool first = true;
+    bool skew_available = true;
+    for (const auto& fs : selected) {
+        double frame_ms = fs.second.time_ms;
+        last_sync_info["offset_ms"][views[fs.first].camera_name] = frame_ms - trigger_ms;
+        if (!fs.second.host_time) {
+            last_sync_info["arrival_time"].push_back(views[fs.first].camera_name);
+            skew_available = false;
+        }
+        if (first || frame_ms < min_ms) min_ms = frame_ms;
+        if (first || frame_ms > max_ms) max_ms = frame_ms;
+        first = false;
+    }
+    last_sync_info["skew_available"] = skew_available;
+    last_sync_info["skew_ms"] = skew_available ? nlohmann::json(max_ms - min_ms) : nlohmann::json();
+    last_sync_info["devices"] = selected.size();
+    if (skew_available) {
+        cout << "RealSense sync skew at angle " << degree << ": " << (max_ms - min_ms) << " ms\n";
+    }
+    else {
+        cout << "RealSense sync skew at angle " << degree << ": unavailable, selected by arrival time "
+             << last_sync_info["arrival_time"].dump() << "\n";
+    }
+
+    // Process the selected framesets
+    std::vector<std::pair<ViewTransform, TimedFrameset>> framesets;
+    for (const auto& fs : selected) {
+        framesets.emplace_back(views[fs.first], fs.second);
+    }
+    process_framesets(framesets, degree, background);
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        end = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        // int seconds = (duration.count() % 60000) / 1000;
-        // int ms = duration.count() % 1000;
-        // if (duration.count() > 200) {
-        cout << "[" << camera_names[serial_number] << " - " << duration.count() << "ms]\n";
-        // }
-        start = end;
+// Processes the framesets on the cpu queue, one task per device
+void RealSenseHandler::process_framesets(const std::vector<std::pair<ViewTransform, TimedFrameset>>& framesets, int degree, bool background) {
+    std::vector<std::future<void>> tasks;
+    for (const auto& item : framesets) {
+        ViewTransform view = item.first;
+        TimedFrameset frameset = item.second;
+        tasks.push_back(Scheduler::getInstance().submit("cpu", [this, frameset, view, degree]() {
+            DebugUtils::startTimer();
+            process_frameset(frameset.frameset, view, degree, frameset.time_ms);
+            DebugUtils::stopTimer("Processing frames for " + view.camera_name + " at angle " + std::to_string(degree));
+        }));
+    }
+    if (background) return;
+    for (auto& task : tasks) {
+        task.get();
     }
-    cout << camera_names[serial_number] << " thread closed.\n";
+}
+
+// Waits until the object on the turntable stops moving, watching the frame to frame depth
+// change over the center of the reference camera. Returns the time waited in ms, which is
+// never more than max_ms.
+int RealSenseHandler::wait_for_settle(int max_ms) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&]() {
+        return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    };
+
+    // Get the settle parameters from the config
+    std::string device_name = config.getValue<std::string>("turntable_settle.device");
+    float threshold_mm = config.getValue<float>("turntable_settle.threshold_mm");
+    int stable_frames = config.getValue<int>("turntable_settle.stable_frames");
+    int min_ms = config.getValue<int>("turntable_settle.min_ms");
+    float roi = config.getValue<float>("turntable_settle.roi");
+    int step = config.getValue<int>("turntable_settle.step");
+
+    // Find the reference camera, the first one is used if no name is given
+    DeviceRegistry& registry = DeviceRegistry::getInstance();
+    int slot = -1;
+    for (int candidate : started) {
+        if (device_name.empty() || registry.info(devices[candidate].id).name == device_name) {
+            slot = candidate;
+            break;
+        }
+    }
+    if (slot < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(max_ms));
+        return max_ms;
+    }
+    rs2::pipeline pipe = *devices[slot].pipe;
+
+    rs2::frame prev_depth;
+    double prev_ms = 0;
+    int stable = 0;
+    while (elapsed_ms() < max_ms) {
+        int remaining_ms = max_ms - elapsed_ms();
+        TimedFrameset fs;
+        if (polling) {
+            // The frame threads own the pipeline, wait for a newer frameset in the cache
+            std::unique_lock<std::mutex> lock(framesetMutex);
+            std::deque<TimedFrameset>& cache = devices[slot].frames;
+            framesetCondition.wait_for(lock, std::chrono::milliseconds(remaining_ms), [&]() {
+                return !cache.empty() && cache.back().time_ms > prev_ms;
+            });
+            if (!cache.empty()) fs = cache.back();
+        }
+        else {
+            rs2::frameset frameset;
+            if (pipe.try_wait_for_frames(&frameset, remaining_ms)) fs = timeFrameset(frameset, hostTimeMs());
+        }
+        if (!fs.frameset) break;
+
+        rs2::depth_frame depth = fs.frameset.get_depth_frame();
+        double frame_ms = fs.time_ms;
+        if (frame_ms <= prev_ms) continue;
+
+        if (prev_depth) {
+            float delta_mm = getDepthDeltaMm(prev_depth, depth, roi, step);
+            DebugUtils::printDebug("Settle delta: " + std::to_string(delta_mm) + " mm");
+            if (delta_mm >= 0 && delta_mm < threshold_mm) {
+                stable++;
+            } else {
+                stable = 0;
+            }
+            if (stable >= stable_frames && elapsed_ms() >= min_ms) {
+                return elapsed_ms();
+            }
+        }
+        prev_depth = depth;
+        prev_ms = frame_ms;
+    }
+
+    // Never settled, fall back to the fixed delay
+    int waited_ms = elapsed_ms();
+    if (waited_ms < max_ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(max_ms - waited_ms));
+    }
+    return max_ms;
 }
 
 // Gets num_frames frames from all connected devices, but does nothing with them.
 // Verifies proper communication and allows autoexposure to settle.
+// Drops num_frames framesets of every started device, the devices are waited on in parallel
 void RealSenseHandler::get_frames(int num_frames, int timeout_ms) {
-    // cout << "Getting " << num_frames << " frames from " << pipelines.size()
-    //     << " devices:\n";
-    cout << "Getting " << num_frames << " frames from " << pipeline_map.size()
+    cout << "Getting " << num_frames << " frames from " << started.size()
         << " devices:\n";
-    // new_frames.clear();
-    for (int i = 0 ; i < num_frames ; i++) {
-        if (pipeline_map.size() == 0) break;
-        // Iterate through the map
-        for (const auto& pipe : pipeline_map) {
+    std::vector<std::future<StartupResult>> waits;
+    for (int slot : started) {
+        waits.push_back(std::async(std::launch::async, [this, slot, num_frames, timeout_ms]() {
+            auto start = std::chrono::steady_clock::now();
+            StartupResult result;
+            result.kind = "RealSense";
+            result.device = device_name(devices[slot].serial);
+            result.step = "warmup";
+            result.attempts = 1;
+            int received = 0;
             rs2::frameset fs;
-            fs = pipe.second.wait_for_frames(timeout_ms);
-            cout << "- ";
-            std::this_thread::sleep_for(std::chrono::milliseconds(25));
-        }
-        // if (frameset_map.size() == 0) break;
-        // else cout << "FS Map Size: " << frameset_map.size() << endl;
-        // Iterate through the map
-        // std::unique_lock<std::mutex> lock(framesetMutex);
-        // for (const auto& fs : frameset_map) {
-            // rs2::frameset fs;
-            // fs = pipe.second.wait_for_frames(timeout_ms);
-            // cout << "- ";
-        // }
-        // lock.unlock();
-        cout << endl;
+            while (received < num_frames && devices[slot].pipe->try_wait_for_frames(&fs, timeout_ms)) {
+                received++;
+            }
+            result.ok = received == num_frames;
+            if (!result.ok) {
+                result.error = std::to_string(received) + "/" + std::to_string(num_frames) + " frames";
+            }
+            result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }));
+    }
+    for (auto& wait : waits) {
+        StartupResult result = wait.get();
+        cout << "[" << result.device << "] " << (result.ok ? "frames received" : result.error) << " in "
+            << static_cast<int>(result.ms) << " ms\n";
+        StartupReport::getInstance().add(result);
     }
     cout << " [DONE]\n";
 }
 
 // Collects relevant MOAD data from all RealSense devices
-void RealSenseHandler::get_current_frame(int degree, int timeout_ms, ThreadPool* pool) {
+void RealSenseHandler::get_current_frame(int degree, int timeout_ms, bool background) {
     ConfigHandler& config = ConfigHandler::getInstance();
     cout << "\nGetting RealSense Data... \n";
-    // Create a rotation matrix for the current turntable position
-    cout << "Getting rotation matrix for " << turntable_position << " degress...\n";
-    rot_matrix = createRotationMatrix(turntable_position);
+    // Camera transforms for the current turntable position, copied into each task
+    std::vector<ViewTransform> views = get_views(turntable_position);
     if (config.getValue<bool>("debug")) {
-        cout << rot_matrix << endl << endl;
+        for (const auto& view : views) {
+            cout << "[" << view.camera_name << "] " << turntable_position << " degrees:\n" << view.transform << endl << endl;
+        }
     }
 
-    // Check if the functon is being called with a thread pool
-    if (pool == nullptr) {
-        // Create vector of threads
-        std::vector<std::thread> thread_vector;
-        for (const auto& pipe : pipeline_map) {
-            // Create a thread for each pipe
-            thread_vector.emplace_back([&, pipe, timeout_ms, degree]() {
-                process_frames(pipe.second, degree, timeout_ms);});
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-        
-        // Join all threads
-        for (auto& thread : thread_vector) {
-            thread.join();
-        }
+    // Synchronized capture picks the framesets from the frame threads
+    if (config.getValue<bool>("realsense.sync.enable")) {
+        get_synced_frames(degree, views, timeout_ms, background);
+        return;
     }
-    else {
-        for (const auto& pipe : pipeline_map) {
-            // Enqueue a task for each pipe in the thread pool
-            pool->enqueueTask([&, pipe, timeout_ms, degree]() {
-                DebugUtils::startTimer();
-                process_frames(pipe.second, degree, timeout_ms);
-                DebugUtils::stopTimer("Processing frames for " + camera_names[pipe.first] + " at angle " + std::to_string(degree));
-            });
-        }
+    stop_frame_threads();
+    last_sync_info = nlohmann::json::object();
+
+    // Grab a frameset of every device on the capture queue, the turntable may move once they are in
+    std::vector<std::pair<ViewTransform, TimedFrameset>> framesets;
+    std::vector<rs2::pipeline> pipes;
+    for (int slot : started) {
+        if (skip_device(slot)) continue;
+        framesets.emplace_back(views[slot], TimedFrameset());
+        pipes.push_back(*devices[slot].pipe);
+    }
+    std::vector<std::future<void>> grabs;
+    for (size_t i = 0; i < framesets.size(); i++) {
+        grabs.push_back(Scheduler::getInstance().submit("capture", [this, &framesets, &pipes, i, timeout_ms]() {
+            framesets[i].second = grab_frameset(pipes[i], framesets[i].first, timeout_ms);
+        }));
+    }
+    for (auto& grab : grabs) {
+        grab.get();
     }
 
-    cout << "Got frames from all RS at angle " << degree << ", Saving in the background...\n";
+    // Devices without frames were counted as failures already
+    framesets.erase(std::remove_if(framesets.begin(), framesets.end(),
+        [](const std::pair<ViewTransform, TimedFrameset>& item) { return item.second.frameset.size() == 0; }), framesets.end());
+    cout << "Got frames from all RS at angle " << degree << (background ? ", Saving in the background...\n" : ", Saving...\n");
+    process_framesets(framesets, degree, background);
 }
 
-void RealSenseHandler::process_frames(rs2::pipeline pipe, int degree, int timeout_ms) {
-    ConfigHandler& config = ConfigHandler::getInstance();
-    std::stringstream out_file;
-    
-    // Get serial number for this camera
-    std::string serial_number = pipe.get_active_profile().get_device().get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
-    cout << "Processing " << camera_names[serial_number] << " at angle " << degree << "...\n";
+// Waits for a frameset of the device, empty if it did not get one
+TimedFrameset RealSenseHandler::grab_frameset(rs2::pipeline pipe, const ViewTransform& view, int timeout_ms) {
+    cout << "Capturing " << view.camera_name << "...\n";
     
     // Collect frameset from camera
     rs2::frameset fs;
@@ -271,187 +899,165 @@ void RealSenseHandler::process_frames(rs2::pipeline pipe, int degree, int timeou
         fs = pipe.wait_for_frames(timeout_ms);
     } catch (const rs2::error& e) {
         fail_count++;
-        std::cerr << camera_names[serial_number] << ": RS error occurred: " << e.what() << std::endl;
-        cout << "WARNING: " << camera_names[serial_number] << " did not get frames.\n";
-        return;
+        DeviceRegistry::getInstance().stats(view.camera_id).failures++;
+        std::cerr << view.camera_name << ": RS error occurred: " << e.what() << std::endl;
+        cout << "WARNING: " << view.camera_name << " did not get frames.\n";
+        return TimedFrameset();
     } catch (const std::exception& ex) {
-        std::cerr << camera_names[serial_number] << ": An error occurred: " << ex.what() << std::endl;
+        std::cerr << view.camera_name << ": An error occurred: " << ex.what() << std::endl;
     } catch (...) {
         cout << "ERROR: ????\n";
     }
 
     // fs = pipe.wait_for_frames(timeout_ms);
     if (fs.size() == 0) {
-        cout << "WARNING: " << camera_names[serial_number] << " did not get frames.\n";
-        return;
+        DeviceRegistry::getInstance().stats(view.camera_id).failures++;
+        cout << "WARNING: " << view.camera_name << " did not get frames.\n";
+        return TimedFrameset();
     }
+    return timeFrameset(fs, hostTimeMs());
+}
 
-    rs2::align align_to_depth(RS2_STREAM_DEPTH);
-    try {
-        fs = align_to_depth.process(fs);
-    } catch (const std::exception& ex) {
-        std::cerr << camera_names[serial_number] << ": Error aligning frameset: " << ex.what() << std::endl;
-        fs = pipe.wait_for_frames(timeout_ms);
-        cout << camera_names[serial_number] << ": got another frameset\n";
-        fs = align_to_depth.process(fs);
-        cout << camera_names[serial_number] << ": may have recovered.\n";
-    }
+// Aligns, filters and saves a single frameset captured from the given device
+void RealSenseHandler::process_frameset(rs2::frameset fs, ViewTransform view, int degree, double capture_ms) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    DeviceStats& stats = DeviceRegistry::getInstance().stats(view.camera_id);
+    auto process_start = std::chrono::steady_clock::now();
+    std::stringstream out_file;
 
-    // Get color and depth frames from the frameset
+    // Manifest record of the saved files, with the time spent in each stage
+    ManifestRecord record;
+    record.camera = view.camera_name;
+    record.angle = degree;
+    record.capture_ms = capture_ms;
+    auto stage_start = process_start;
+    auto end_stage = [&stage_start, &record](const char* stage) {
+        auto now = std::chrono::steady_clock::now();
+        record.timings[stage] = std::chrono::duration<double, std::milli>(now - stage_start).count();
+        stage_start = now;
+    };
+
+    // Get color and depth frames from the frameset. The color frame is not aligned to the depth
+    // frame, the points that are kept are projected into it (colorizePoints).
     rs2::video_frame color = fs.get_color_frame();
     rs2::depth_frame depth = fs.get_depth_frame();
+    bool yuyv = color.get_profile().format() == RS2_FORMAT_YUYV;
+    ColorProjection projection;
+    try {
+        projection = getColorProjection(depth, color);
+    } catch (const std::exception& ex) {
+        fail_count++;
+        stats.failures++;
+        std::cerr << view.camera_name << ": Error reading the camera calibration: " << ex.what() << std::endl;
+        return;
+    }
     
     // At this point, we should throw the rest of the process in a thread pool 
 
-    // Apply filters to depth frame
-    depth = threshold_filter.process(depth);
-    depth = spatial_filter.process(depth);
-    depth = temporal_filter.process(depth);
+    // Apply the filters to the depth frame, in the order of the chain
+    Device& device = devices[view.slot];
+    std::vector<std::string> chain = config.getValue<std::vector<std::string>>("realsense.depth_filter.chain");
+    {
+        std::lock_guard<std::mutex> lock(*device.filter_mtx);
+        for (const std::string& filter : chain) {
+            if (filter == "decimation" && device.decimation > 1) depth = device.decimation_filter.process(depth);
+            else if (filter == "threshold") depth = device.threshold_filter.process(depth);
+            else if (filter == "spatial") depth = device.spatial_filter.process(depth);
+            else if (filter == "temporal") depth = device.temporal_filter.process(depth);
+        }
+    }
+    end_stage("depth_filter_ms");
+    size_t cloud_points = 0;
 
     // Check if collecting pointclouds is enabled
     if (config.getValue<bool>("realsense.collect_pointcloud")) {
         // [DEUG] Start Timer for pointcloud creation
         DebugUtils::startTimer();
-        // Create PCL point cloud
-        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-        pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr normal_cloud(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+        // Borrow the clouds of the camera, they go back to its pool at the end of the frameset
+        std::shared_ptr<CloudBuffers> buffers = device.buffers->borrow();
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = buffers->cloud;
         // Define the origin point (0, 0, 0, 1)
         Eigen::Vector4f origin(0.0f, 0.0f, 0.0f, 1.0f);
         // pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZRGB>);
 
         // Get the number of points and vertices from the frame
-        rs2::pointcloud pc;
-        rs2::points points = pc.calculate(depth);
+        rs2::points points;
+        {
+            std::lock_guard<std::mutex> lock(*device.filter_mtx);
+            points = device.pointcloud.calculate(depth);
+        }
         const rs2::vertex* vertices = points.get_vertices();
         int numVertices = points.size();
         // cout << "numVertices: " << numVertices << " - ";
         int i;
         for (i = 0; i < numVertices ; i++) {
-            // Create a point and set its coordinates
+            // Pixels without depth have no point
+            if (vertices[i].z <= 0) continue;
+
+            // Create a point and set its coordinates, the color is set once the cloud is cropped
             pcl::PointXYZRGB point;
             point.x = vertices[i].x;
             point.y = vertices[i].y;
             point.z = vertices[i].z;
-
-            // Get color from the corresponding pixel in the color frame
-            const uint8_t* color_data = reinterpret_cast<const uint8_t*>(color.get_data());
-            point.r = color_data[3 * i];
-            point.g = color_data[3 * i + 1];
-            point.b = color_data[3 * i + 2];
             
             // Add the point to the point cloud
             cloud->push_back(point);
         }
         // [DEBUG] Stop Timer for pointcloud creation
         std::stringstream message;
-        message << "[" << degree << "]" << camera_names[serial_number] << " PointCloud Created";
+        message << "[" << degree << "]" << view.camera_name << " PointCloud Created";
         DebugUtils::stopTimer(message.str());
+        end_stage("pointcloud_ms");
 
         // Check for raw pointcloud collection, if enabled, skip the rest of the processing
         if (!config.getValue<bool>("realsense.raw_pointcloud")) {
-            //Apply appropriate pointcloud transform
-            pcl::transformPointCloud(*cloud, *cloud, camera_transforms[serial_number]);
-            pcl::transformPointCloud(*cloud, *cloud, rot_matrix);
-            // pcl::transformPointCloud(*normal_cloud, *normal_cloud, camera_transforms[serial_number]);
-            // pcl::transformPointCloud(*normal_cloud, *normal_cloud, rot_matrix);
-            origin = camera_transforms[serial_number] * origin;
-            origin = rot_matrix * origin;
-            //Apply passthrough filters to remove background
-            pcl::PassThrough<pcl::PointXYZRGB> pass;
-            float fmin, fmax;
-
-            // Check if xpass is enabled
-            if (config.getValue<bool>("realsense.filter.xpass.apply")) {
-                // [DEBUG] Start Timer for x-pass filter
-                DebugUtils::startTimer();
-                
-                // Get the min and max values for the x-pass filter
-                fmin = config.getValue<float>("realsense.filter.xpass.min");
-                fmax = config.getValue<float>("realsense.filter.xpass.max");
-                
-                // Set the values to the pass filter
-                pass.setInputCloud(cloud);
-                pass.setFilterFieldName("x");
-                pass.setFilterLimits(fmin, fmax);
-
-                // Apply the filter to the point cloud
-                pass.filter(*cloud);
-
-                // [DEBUG] Stop Timer for x-pass filter
-                std::stringstream x_pass_message;
-                x_pass_message << "[" << degree << "]" << camera_names[serial_number] << " X-pass Filter";
-                DebugUtils::stopTimer(x_pass_message.str());
-            }
-
-            // Check if ypass is enabled
-            if (config.getValue<bool>("realsense.filter.ypass.apply")) {
-                // [DEBUG] Start Timer for y-pass filter
-                DebugUtils::startTimer();
-                
-                // Get the min and max values for the y-pass filter
-                fmin = config.getValue<float>("realsense.filter.ypass.min");
-                fmax = config.getValue<float>("realsense.filter.ypass.max");
-
-                // Set the values to the pass filter
-                pass.setInputCloud(cloud);
-                pass.setFilterFieldName("y");
-                pass.setFilterLimits(fmin, fmax);
-
-                // Apply the filter to the point cloud
-                pass.filter(*cloud);
-                
-                // [DEBUG] Stop Timer for y-pass filter
-                std::stringstream y_pass_message;
-                y_pass_message << "[" << degree << "]" << camera_names[serial_number] << " Y-pass Filter";
-                DebugUtils::stopTimer(y_pass_message.str());
-            }
-
-            // Check if zpass is enabled
-            if (config.getValue<bool>("realsense.filter.zpass.apply")) {
-                // [DEBUG] Start Timer for z-pass filter
-                DebugUtils::startTimer();
-                
-                // Get the min and max values for the z-pass filter
-                fmin = config.getValue<float>("realsense.filter.zpass.min");
-                fmax = config.getValue<float>("realsense.filter.zpass.max");
-
-                // Set the values to the pass filter
-                pass.setInputCloud(cloud);
-                pass.setFilterFieldName("z");
-                pass.setFilterLimits(fmin, fmax);
-
-                // Apply the filter to the point cloud
-                pass.filter(*cloud);
-
-                // [DEBUG] Stop Timer for z-pass filter
-                std::stringstream z_pass_message;
-                z_pass_message << "[" << degree << "]" << camera_names[serial_number] << " Z-pass Filter";
-                DebugUtils::stopTimer(z_pass_message.str());
+            //Apply the camera and turntable transform (composed in the view table)
+            pcl::transformPointCloud(*cloud, *cloud, view.transform);
+            origin = view.origin;
+            //Crop the box of the object to remove the background
+            DebugUtils::startTimer();
+            Eigen::Vector3f box_min = Eigen::Vector3f::Constant(-std::numeric_limits<float>::infinity());
+            Eigen::Vector3f box_max = Eigen::Vector3f::Constant(std::numeric_limits<float>::infinity());
+            const char* axes[3] = { "xpass", "ypass", "zpass" };
+            for (int axis = 0; axis < 3; axis++) {
+                std::string key = std::string("realsense.filter.") + axes[axis];
+                if (config.getValue<bool>(key + ".apply")) {
+                    box_min[axis] = config.getValue<float>(key + ".min");
+                    box_max[axis] = config.getValue<float>(key + ".max");
+                }
             }
+            buffers->crop(box_min, box_max);
+            std::stringstream crop_message;
+            crop_message << "[" << degree << "]" << view.camera_name << " Crop";
+            DebugUtils::stopTimer(crop_message.str());
+            end_stage("crop_ms");
+
+            // Color the points left in the box, before the voxel grid averages them
+            colorizePoints(*cloud, view.transform.inverse(), projection);
+            end_stage("color_ms");
             
             // Check if statistical outlier removal (SOR) is enabled
             if (config.getValue<bool>("realsense.filter.sor.apply")) {
                 // [DEBUG] Start Timer for SOR filter
                 DebugUtils::startTimer();
 
-                // Create a StatisticalOutlierRemoval filter
-                pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor(true);
+                // StatisticalOutlierRemoval filter of the buffers, it keeps its search tree
+                pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB>& sor = buffers->sor;
 
                 // Get the standard deviation threshold and number of neighbors from the config
-                fmin = config.getValue<float>("realsense.filter.sor.stddev");
+                float stddev = config.getValue<float>("realsense.filter.sor.stddev");
                 int k = config.getValue<int>("realsense.filter.sor.k");
 
                 // Set the parameters for the SOR filter
-                sor.setInputCloud(cloud);
                 sor.setMeanK(k);  // Number of neighbors to use for mean distance estimation
-                sor.setStddevMulThresh(fmin);  // Standard deviation threshold for outlier detection
+                sor.setStddevMulThresh(stddev);  // Standard deviation threshold for outlier detection
                 
                 // Apply the filter to the point cloud
-                sor.filter(*cloud);
+                buffers->filter(sor);
 
                 // [DEBUG] Stop Timer for SOR filter
                 std::stringstream sor_message;
-                sor_message << "[" << degree << "]" << camera_names[serial_number] << " SOR Filter";
+                sor_message << "[" << degree << "]" << view.camera_name << " SOR Filter";
                 DebugUtils::stopTimer(sor_message.str());
             }
 
@@ -460,59 +1066,61 @@ void RealSenseHandler::process_frames(rs2::pipeline pipe, int degree, int timeou
                 // [DEBUG] Start Timer for voxel grid filter
                 DebugUtils::startTimer();
 
-                // Create a VoxelGrid filter
-                pcl::VoxelGrid<pcl::PointXYZRGB> voxel_grid_filter;
+                // VoxelGrid filter of the buffers
+                pcl::VoxelGrid<pcl::PointXYZRGB>& voxel_grid_filter = buffers->voxel;
 
                 // Get the leaf size from the config
-                fmin = config.getValue<float>("realsense.filter.voxel.leaf_size");
+                float leaf_size = config.getValue<float>("realsense.filter.voxel.leaf_size");
 
                 // Set the parameters for the voxel grid filter
-                voxel_grid_filter.setInputCloud(cloud);
-                voxel_grid_filter.setLeafSize(fmin, fmin, fmin); // Adjust the values as per your needs
+                voxel_grid_filter.setLeafSize(leaf_size, leaf_size, leaf_size); // Adjust the values as per your needs
 
                 // Apply the filter to the point cloud
-                voxel_grid_filter.filter(*cloud);
+                buffers->filter(voxel_grid_filter);
 
                 // [DEBUG] Stop Timer for voxel grid filter
                 std::stringstream voxel_message;
-                voxel_message << "[" << degree << "]" << camera_names[serial_number] << " Voxel Filter";
+                voxel_message << "[" << degree << "]" << view.camera_name << " Voxel Filter";
                 DebugUtils::stopTimer(voxel_message.str());
             }
+        } else {
+            colorizePoints(*cloud, Eigen::Matrix4f::Identity(), projection);
+            end_stage("color_ms");
         }
+        end_stage("cloud_filter_ms");
+        // The filters swap the clouds of the buffers
+        cloud = buffers->cloud;
+        cloud_points = cloud->size();
 
         // Check if computing normals is enabled
         if (config.getValue<bool>("realsense.compute_normals")) {
             // [DEBUG] Start Timer for normals computation
             DebugUtils::startTimer();
 
-            // Create a pcl::PointCloud<pcl::Normal> to hold the normals
-            pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
-            pcl::NormalEstimationOMP<pcl::PointXYZRGB, pcl::Normal> ne;
+            // Set the neighborhood and the number of chunks computed at once
+            NormalEstimator ne;
+            ne.k = config.getValue<int>("realsense.normals_k");
+            ne.radius = config.getValue<float>("realsense.normals_radius");
+            ne.threads = config.getValue<int>("realsense.normals_threads");
 
-            // Set the input cloud and parameters for normal estimation
-            ne.setInputCloud(cloud);
-
-            // Set the number of threads for parallel processing
-            ne.setNumberOfThreads(config.getValue<int>("realsense.normals_threads"));
-            ne.setSearchMethod(pcl::search::KdTree<pcl::PointXYZRGB>::Ptr(new pcl::search::KdTree<pcl::PointXYZRGB>));
-            ne.setKSearch(2);
-            ne.setViewPoint(origin[0],origin[1],origin[2]);
-            
-            // Compute the normals
-            ne.compute(*normals);
+            // Compute the normals, oriented toward the camera. The chunks not taken by this task
+            // run on the other threads of the cpu queue.
+            pcl::PointCloud<pcl::Normal>::Ptr normals = buffers->normals;
+            ne.compute(cloud, *buffers->tree, origin.head<3>(), *normals, &Scheduler::getInstance().queue("cpu"));
 
             // Concatenate the original point cloud and the computed normals
-            pcl::concatenateFields(*cloud, *normals, *normal_cloud);
+            pcl::concatenateFields(*cloud, *normals, *buffers->normal_cloud);
             
             // [DEBUG] Stop Timer for normals computation
             std::stringstream normals_message;
-            normals_message << "[" << degree << "]" << camera_names[serial_number] << " Normals Computation";
+            normals_message << "[" << degree << "]" << view.camera_name << " Normals Computation";
             DebugUtils::stopTimer(normals_message.str());
         }
+        end_stage("normals_ms");
         
         // Generate pointcloud name and save
         out_file.str("");
-        out_file << save_dir << "\\" << camera_names[serial_number] << "_"
+        out_file << save_dir << "/" << view.camera_name << "_"
             << std::setfill('0') << std::setw(3) << degree << "_cloud.ply";
         std::cout.copyfmt(std::ios(nullptr));
 
@@ -525,25 +1133,49 @@ void RealSenseHandler::process_frames(rs2::pipeline pipe, int degree, int timeou
             pcl::io::savePLYFile(out_file.str(), *cloud, true);
         } else {
             // Save the point cloud with normals as binary PLY
-            pcl::io::savePLYFile(out_file.str(), *normal_cloud, true);
+            pcl::io::savePLYFile(out_file.str(), *buffers->normal_cloud, true);
         }
+        end_stage("write_ms");
+        record.file = out_file.str();
+        record.type = "cloud";
+        file_saved(view.camera_id, record);
 
-        cout << "[" << degree << "][" << camera_names[serial_number] << ":SAVED]\n";
+        cout << "[" << degree << "][" << view.camera_name << ":SAVED]\n";
     }
     
     // Check if collecting color images is enabled
     if (config.getValue<bool>("realsense.collect_color")) {
-        // Convert the color frame to OpenCV Mat
-        cv::Mat color_mat(color.get_height(), color.get_width(), CV_8UC3, (void*)color.get_data(), cv::Mat::AUTO_STEP);
-        cv::cvtColor(color_mat, color_mat, cv::COLOR_RGB2BGR);
+        // Convert the color frame to OpenCV Mat. RGB frames are aligned to the depth frame with
+        // the aligner of the device, YUYV frames are saved as they are.
+        cv::Mat color_mat;
+        if (yuyv) {
+            cv::Mat yuyv_mat(color.get_height(), color.get_width(), CV_8UC2, (void*)color.get_data(), cv::Mat::AUTO_STEP);
+            cv::cvtColor(yuyv_mat, color_mat, cv::COLOR_YUV2BGR_YUYV);
+        } else {
+            rs2::video_frame aligned = color;
+            try {
+                // The aligner keeps a queue of results, one frameset of the device at a time
+                std::lock_guard<std::mutex> lock(*device.filter_mtx);
+                aligned = device.align.process(fs).get_color_frame();
+            } catch (const std::exception& ex) {
+                std::cerr << view.camera_name << ": Error aligning frameset, saving the color frame as is: " << ex.what() << std::endl;
+            }
+            end_stage("align_ms");
+            color_mat = cv::Mat(aligned.get_height(), aligned.get_width(), CV_8UC3, (void*)aligned.get_data(), cv::Mat::AUTO_STEP);
+            cv::cvtColor(color_mat, color_mat, cv::COLOR_RGB2BGR);
+        }
 
         // Generate image name
         out_file.str("");
-        out_file << save_dir << "\\" << camera_names[serial_number] << "_"
-            << std::setfill('0') << std::setw(3) << turntable_position << "_color.png";
+        out_file << save_dir << "/" << view.camera_name << "_"
+            << std::setfill('0') << std::setw(3) << degree << "_color.png";
 
         // Save the color image
         cv::imwrite(out_file.str(), color_mat);
+        end_stage("write_ms");
+        record.file = out_file.str();
+        record.type = "color";
+        file_saved(view.camera_id, record);
     }
 
     // Check if collecting depth images is enabled
@@ -554,12 +1186,94 @@ void RealSenseHandler::process_frames(rs2::pipeline pipe, int degree, int timeou
         
         // Generate image name
         out_file.str("");
-        out_file << save_dir << "\\" << camera_names[serial_number] << "_"
-            << std::setfill('0') << std::setw(3) << turntable_position << "_depth.png";
+        out_file << save_dir << "/" << view.camera_name << "_"
+            << std::setfill('0') << std::setw(3) << degree << "_depth.png";
         
         // Save the depth image
         cv::imwrite(out_file.str(), depth_mat);
+        end_stage("write_ms");
+        record.file = out_file.str();
+        record.type = "depth";
+        file_saved(view.camera_id, record);
+    }
+    stats.captures++;
+    stats.addTime(process_start);
+    add_stage_times(record.timings, cloud_points);
+}
+
+void RealSenseHandler::add_stage_times(const nlohmann::json& timings, size_t points) {
+    std::lock_guard<std::mutex> lock(stage_mtx);
+    for (const auto& stage : timings.items()) {
+        stage_totals[stage.key()] += stage.value().get<double>();
+    }
+    stage_points += points;
+    stage_framesets++;
+}
+
+void RealSenseHandler::reset_stage_times() {
+    std::lock_guard<std::mutex> lock(stage_mtx);
+    stage_totals.clear();
+    stage_points = 0;
+    stage_framesets = 0;
+}
+
+// Mean ms of each processing stage per frameset since the last reset, with the mean cloud size
+nlohmann::json RealSenseHandler::stage_times() {
+    std::lock_guard<std::mutex> lock(stage_mtx);
+    nlohmann::json times = nlohmann::json::object();
+    double total = 0;
+    for (const auto& stage : stage_totals) {
+        double mean = stage_framesets > 0 ? stage.second / stage_framesets : 0;
+        times[stage.first] = mean;
+        total += mean;
+    }
+    times["total_ms"] = total;
+    times["points"] = stage_framesets > 0 ? stage_points / stage_framesets : 0;
+    times["framesets"] = stage_framesets;
+    return times;
+}
+
+void RealSenseHandler::reset_frame_latency() {
+    std::lock_guard<std::mutex> lock(framesetMutex);
+    for (auto& device : devices) {
+        device.latency_ms.clear();
+    }
+}
+
+// Percentiles and spread of the frame latency of each device since the last reset (frame threads
+// only, so synchronized captures)
+nlohmann::json RealSenseHandler::frame_latency() {
+    std::lock_guard<std::mutex> lock(framesetMutex);
+    nlohmann::json latency = nlohmann::json::object();
+    for (const auto& device : devices) {
+        if (device.latency_ms.empty()) continue;
+        std::vector<float> sorted = device.latency_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0, squares = 0;
+        for (float value : sorted) {
+            sum += value;
+            squares += static_cast<double>(value) * value;
+        }
+        double mean = sum / sorted.size();
+        double variance = squares / sorted.size() - mean * mean;
+        nlohmann::json& entry = latency[DeviceRegistry::getInstance().info(device.id).name];
+        entry["frames"] = sorted.size();
+        entry["p50_ms"] = sorted[sorted.size() / 2];
+        entry["p99_ms"] = sorted[sorted.size() * 99 / 100];
+        entry["max_ms"] = sorted.back();
+        entry["jitter_ms"] = variance > 0 ? std::sqrt(variance) : 0.0;
+    }
+    return latency;
+}
+
+// Adds a saved file to the written bytes of the device and to the scan manifest
+void RealSenseHandler::file_saved(int camera_id, const ManifestRecord& record) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(record.file, ec);
+    if (!ec) {
+        DeviceRegistry::getInstance().stats(camera_id).bytes_written += static_cast<long long>(size);
     }
+    ScanManifest::getInstance().record(record);
 }
 
 /* Prints out RealSense device information, if print_streams is true, 
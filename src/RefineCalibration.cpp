@@ -0,0 +1,174 @@
+// Refine Calibration: Refines the RealSense camera transforms (calibration/realsense/transform.json)
+// from the clouds of a scanned pose with multi-view ICP, and writes a new transform.json.
+//
+// The clouds of all the cameras and angles of the pose are matched against each other (neighboring
+// cameras at the same angle, all cameras at the next angle) and the transforms are solved jointly.
+// The reference camera keeps its rotation about the turntable axis and its height. See CalibrationRefiner.h.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+#include "CalibrationRefiner.h"
+
+namespace fs = std::filesystem;
+using std::cout;
+using std::endl;
+
+struct RefineOptions {
+    std::string pose_dir;
+    std::string transforms = "calibration/realsense/transform.json";
+    std::string output;                                 // Defaults to <pose_dir>/transform.json
+    std::string reference = "rs1";
+    double voxel = 0.004;
+    std::vector<double> distance = { 0.02, 0.005 };     // Start, end
+    int iterations = 30;
+    double min_overlap = 0.3;
+    bool raw = false;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+void printUsage() {
+    cout << "Usage: RefineCalibration <pose_dir> [--transforms <transform.json>] [--output <file.json>]\n"
+         << "                         [--reference rs1] [--voxel size] [--distance start,end] [--iters N]\n"
+         << "                         [--min-overlap ratio] [--raw] [--threads N]\n";
+}
+
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stod(item));
+    }
+    return values;
+}
+
+bool parseArgs(int argc, char* argv[], RefineOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--transforms" && has_value) options.transforms = argv[++i];
+        else if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--reference" && has_value) options.reference = argv[++i];
+        else if (arg == "--voxel" && has_value) options.voxel = std::stod(argv[++i]);
+        else if (arg == "--distance" && has_value) options.distance = parseList(argv[++i]);
+        else if (arg == "--iters" && has_value) options.iterations = std::stoi(argv[++i]);
+        else if (arg == "--min-overlap" && has_value) options.min_overlap = std::stod(argv[++i]);
+        else if (arg == "--raw") options.raw = true;
+        else if (arg == "--threads" && has_value) options.threads = std::stoul(argv[++i]);
+        else if (arg[0] != '-' && options.pose_dir.empty()) options.pose_dir = arg;
+        else return false;
+    }
+    return !options.pose_dir.empty() && options.distance.size() == 2 && options.iterations > 0;
+}
+
+// Same layout as the calibration file, so the output can replace it directly
+void writeTransforms(const std::string& path, const nlohmann::ordered_json& original, const CalibrationRefiner& refiner) {
+    std::ofstream file(path);
+    file << std::fixed << std::setprecision(6) << "{\n";
+    size_t count = 0;
+    for (const auto& entry : original.items()) {
+        std::string name = entry.value()["name"];
+        const auto& names = refiner.cameraNames();
+        size_t camera = std::find(names.begin(), names.end(), name) - names.begin();
+        const Eigen::Matrix4d& transform = refiner.cameraTransform(camera);
+
+        file << "    \"" << entry.key() << "\" : {\n"
+             << "        \"name\": \"" << name << "\",\n"
+             << "        \"serial_number\": \"" << entry.value()["serial_number"].get<std::string>() << "\",\n"
+             << "        \"transform_matrix\":\n"
+             << "        [\n";
+        for (int row = 0; row < 4; row++) {
+            file << "            [";
+            for (int col = 0; col < 4; col++) {
+                double value = transform(row, col);
+                if (std::abs(value) < 5e-7) value = 0;  // No "-0.000000"
+                file << value << (col < 3 ? ", " : "]");
+            }
+            file << (row < 3 ? ",\n" : "\n");
+        }
+        file << "        ]\n"
+             << "    }" << (++count < original.size() ? ",\n" : "\n");
+    }
+    file << "}";
+}
+
+int main(int argc, char* argv[]) {
+    RefineOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    // Accept the pose folder or its realsense folder
+    fs::path realsense_dir = options.pose_dir;
+    if (fs::is_directory(realsense_dir / "realsense")) realsense_dir /= "realsense";
+    if (!fs::is_directory(realsense_dir)) {
+        std::cerr << "Folder not found: " << realsense_dir.string() << endl;
+        return 1;
+    }
+    if (options.output.empty()) options.output = (fs::path(options.pose_dir) / "transform.json").string();
+
+    std::ifstream transform_file(options.transforms);
+    if (!transform_file.is_open()) {
+        std::cerr << "Failed to open " << options.transforms << endl;
+        return 1;
+    }
+    nlohmann::ordered_json original = nlohmann::ordered_json::parse(transform_file);
+
+    CalibrationRefiner refiner(options.threads);
+    std::vector<Eigen::Matrix4d> initial;
+    for (const auto& entry : original.items()) {
+        Eigen::Matrix4d transform;
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) transform(row, col) = entry.value()["transform_matrix"][row][col];
+        }
+        refiner.addCamera(entry.value()["name"], transform);
+        initial.push_back(transform);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto elapsed = [&start]() {
+        auto now = std::chrono::high_resolution_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+        start = now;
+        return ms;
+    };
+
+    size_t views = refiner.loadPose(realsense_dir.string(), options.voxel, options.raw);
+    cout << "Loaded " << views << " views in " << elapsed() << " ms" << endl;
+    if (views < 2) {
+        std::cerr << "Not enough clouds in " << realsense_dir.string() << endl;
+        return 1;
+    }
+    size_t pairs = refiner.findPairs(options.distance[0], options.min_overlap);
+    cout << "Found pairs in " << elapsed() << " ms" << endl;
+    if (pairs == 0) {
+        std::cerr << "No overlapping views, try a larger --distance or a lower --min-overlap" << endl;
+        return 1;
+    }
+    RefinementStats stats = refiner.refine(options.iterations, options.distance[0], options.distance[1], options.reference);
+    cout << "Refined in " << elapsed() << " ms (" << stats.iterations << " iterations)" << endl;
+    cout << "Point to plane rmse at " << options.distance[1] * 1000 << " mm: "
+         << stats.initial_rmse * 1000 << " mm -> " << stats.final_rmse * 1000 << " mm" << endl;
+
+    // Change of every camera
+    for (size_t c = 0; c < initial.size(); c++) {
+        Eigen::Matrix4d delta = refiner.cameraTransform(c) * initial[c].inverse();
+        double rotation = Eigen::AngleAxisd(Eigen::Matrix3d(delta.block<3, 3>(0, 0))).angle() * 180.0 / EIGEN_PI;
+        cout << refiner.cameraNames()[c] << ": rotated " << rotation << " deg, moved "
+             << delta.block<3, 1>(0, 3).norm() * 1000 << " mm" << endl;
+    }
+
+    writeTransforms(options.output, original, refiner);
+    cout << "Transforms saved to " << options.output << endl;
+    return 0;
+}
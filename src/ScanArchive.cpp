@@ -0,0 +1,335 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#ifdef MOAD_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ScanArchive.h"
+#include "Xxh64.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+const char magic[8] = { 'M', 'O', 'A', 'D', 'P', 'A', 'K', '1' };
+
+void writeU64(std::ostream& output, uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    output.write(bytes, 8);
+}
+
+uint64_t readU64(const char* bytes) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | static_cast<unsigned char>(bytes[i]);
+    return value;
+}
+
+double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+ScanArchive::~ScanArchive() {
+    close(false);
+}
+
+bool ScanArchive::compressionAvailable() {
+#ifdef MOAD_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ScanArchive::open(const std::string& archive_path, const std::string& archive_root, const ArchiveOptions& archive_options) {
+    close(false);
+    std::lock_guard<std::mutex> lock(mtx);
+    output.open(archive_path, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "Failed to open file for writing: " << archive_path << std::endl;
+        return false;
+    }
+    if (!compressionAvailable()) {
+        std::cout << "[WARNING] Built without zstd, the archive is not compressed" << std::endl;
+    }
+    path = fs::absolute(archive_path).lexically_normal().string();
+    root = archive_root;
+    options = archive_options;
+    options.block_size = std::max<size_t>(options.block_size, 64 << 10);
+    if (options.pool != nullptr) {
+        pool = options.pool;
+    } else {
+        own_pool = std::make_unique<ThreadPool>(std::max<size_t>(options.threads, 1));
+        pool = own_pool.get();
+    }
+    names.clear();
+    entries.clear();
+    pending = 0;
+    raw_bytes = 0;
+    start_ms = nowMs();
+    output.write(magic, sizeof(magic));
+    write_pos = sizeof(magic);
+    return true;
+}
+
+bool ScanArchive::isOpen() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return output.is_open();
+}
+
+void ScanArchive::add(const std::string& file) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!output.is_open()) return;
+
+    fs::path relative = fs::path(file).lexically_normal().lexically_relative(fs::path(root).lexically_normal());
+    std::string name = relative.generic_string();
+    if (name.empty() || name == "." || name.rfind("..", 0) == 0) return;
+    if (fs::absolute(file).lexically_normal().string() == path) return;
+    if (!names.insert(name).second) return;
+
+    pending++;
+    pool->enqueueTask([this, file, name]() { packFile(file, name); });
+}
+
+void ScanArchive::packFile(const std::string& file, const std::string& name) {
+    // Read and hash the whole file, the blocks share the buffer
+    std::ifstream input(file, std::ios::binary | std::ios::ate);
+    auto data = std::make_shared<std::vector<char>>();
+    bool read = input.is_open();
+    if (read) {
+        data->resize(static_cast<size_t>(input.tellg()));
+        input.seekg(0);
+        read = static_cast<bool>(input.read(data->data(), data->size()));
+    }
+    if (!read) {
+        std::cerr << "Archive: failed to read " << file << std::endl;
+        std::lock_guard<std::mutex> lock(mtx);
+        pending--;
+        done.notify_all();
+        return;
+    }
+
+    Xxh64 hash;
+    hash.update(reinterpret_cast<const unsigned char*>(data->data()), data->size());
+    std::string extension = fs::path(file).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool store = options.store_extensions.count(extension) > 0;
+    size_t blocks = (data->size() + options.block_size - 1) / options.block_size;
+
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        index = entries.size();
+        ArchiveEntry entry;
+        entry.path = name;
+        entry.size = data->size();
+        entry.xxh64 = hash.hex();
+        entry.blocks.resize(blocks);
+        entries.push_back(entry);
+        raw_bytes += data->size();
+        pending += blocks;
+    }
+    // The other blocks go to the pool, the first one is done here
+    for (size_t block = 1; block < blocks; block++) {
+        pool->enqueueTask([this, data, index, block, store]() { packBlock(data, index, block, store); });
+    }
+    if (blocks > 0) packBlock(data, index, 0, store);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    pending--;
+    done.notify_all();
+}
+
+void ScanArchive::packBlock(std::shared_ptr<std::vector<char>> data, size_t entry, size_t block, bool store) {
+    size_t begin = block * options.block_size;
+    size_t size = std::min(options.block_size, data->size() - begin);
+    const char* raw = data->data() + begin;
+
+    std::vector<char> compressed;
+    int method = 0;
+#ifdef MOAD_ZSTD
+    if (!store) {
+        compressed.resize(ZSTD_compressBound(size));
+        size_t result = ZSTD_compress(compressed.data(), compressed.size(), raw, size, options.level);
+        // Keep the raw block when it does not shrink
+        if (!ZSTD_isError(result) && result < size) {
+            compressed.resize(result);
+            method = 1;
+        }
+    }
+#else
+    (void)store;
+#endif
+    const char* bytes = method == 1 ? compressed.data() : raw;
+    size_t stored = method == 1 ? compressed.size() : size;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    ArchiveBlock& target = entries[entry].blocks[block];
+    target.offset = write_pos;
+    target.stored = stored;
+    target.size = size;
+    target.method = method;
+    output.write(bytes, stored);
+    write_pos += stored;
+    pending--;
+    done.notify_all();
+}
+
+void ScanArchive::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [this]() { return pending == 0; });
+}
+
+bool ScanArchive::close(bool sweep) {
+    if (!isOpen()) return false;
+    wait();
+    if (sweep) {
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file()) add(it->path().string());
+        }
+        wait();
+    }
+
+    std::unique_ptr<ThreadPool> workers;
+    std::lock_guard<std::mutex> lock(mtx);
+    workers = std::move(own_pool);
+    pool = nullptr;
+
+    std::sort(entries.begin(), entries.end(), [](const ArchiveEntry& a, const ArchiveEntry& b) { return a.path < b.path; });
+    nlohmann::json index;
+    index["version"] = 1;
+    index["files"] = nlohmann::json::array();
+    for (const auto& entry : entries) {
+        nlohmann::json file;
+        file["path"] = entry.path;
+        file["size"] = entry.size;
+        file["xxh64"] = entry.xxh64;
+        file["blocks"] = nlohmann::json::array();
+        for (const auto& block : entry.blocks) {
+            file["blocks"].push_back({ block.offset, block.stored, block.size, block.method });
+        }
+        index["files"].push_back(file);
+    }
+    std::string text = index.dump();
+    output.write(text.data(), text.size());
+    writeU64(output, write_pos);
+    writeU64(output, text.size());
+    output.write(magic, sizeof(magic));
+    bool good = output.good();
+    output.close();
+
+    uint64_t archive_bytes = write_pos + text.size() + 24;
+    if (good) {
+        std::cout << "Archive saved to " << path << ": " << entries.size() << " files, " << raw_bytes / 1048576.0
+                  << " MB -> " << archive_bytes / 1048576.0 << " MB, closed in " << (nowMs() - start_ms) / 1000 << " s" << std::endl;
+    } else {
+        std::cerr << "Failed to write archive: " << path << std::endl;
+    }
+    return good;
+}
+
+bool ScanArchive::readIndex(const std::string& archive_path, std::vector<ArchiveEntry>& entries, std::string& error) {
+    std::ifstream input(archive_path, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        error = "cannot open " + archive_path;
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(input.tellg());
+    char header[8], trailer[24];
+    if (size < sizeof(header) + sizeof(trailer)) {
+        error = "not an archive";
+        return false;
+    }
+    input.seekg(0);
+    input.read(header, sizeof(header));
+    input.seekg(size - sizeof(trailer));
+    input.read(trailer, sizeof(trailer));
+    if (!input || !std::equal(magic, magic + 8, header) || !std::equal(magic, magic + 8, trailer + 16)) {
+        error = "not an archive or not closed";
+        return false;
+    }
+
+    uint64_t index_offset = readU64(trailer);
+    uint64_t index_size = readU64(trailer + 8);
+    if (index_offset + index_size + sizeof(trailer) != size) {
+        error = "bad index position";
+        return false;
+    }
+    std::string text(index_size, '\0');
+    input.seekg(index_offset);
+    input.read(&text[0], index_size);
+    nlohmann::json index = nlohmann::json::parse(text, nullptr, false);
+    if (!input || index.is_discarded() || !index.contains("files")) {
+        error = "bad index";
+        return false;
+    }
+
+    entries.clear();
+    for (const auto& file : index["files"]) {
+        ArchiveEntry entry;
+        entry.path = file.value("path", "");
+        entry.size = file.value("size", 0ULL);
+        entry.xxh64 = file.value("xxh64", "");
+        for (const auto& block : file["blocks"]) {
+            ArchiveBlock item;
+            item.offset = block[0].get<uint64_t>();
+            item.stored = block[1].get<uint64_t>();
+            item.size = block[2].get<uint64_t>();
+            item.method = block[3].get<int>();
+            entry.blocks.push_back(item);
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool ScanArchive::readEntry(std::ifstream& archive, const ArchiveEntry& entry,
+                            const std::function<void(const char*, size_t)>& sink, std::string& error) {
+    std::vector<char> stored, block;
+    uint64_t total = 0;
+    for (const auto& item : entry.blocks) {
+        stored.resize(item.stored);
+        archive.seekg(item.offset);
+        archive.read(stored.data(), item.stored);
+        if (!archive) {
+            archive.clear();
+            error = "truncated block";
+            return false;
+        }
+
+        if (item.method == 0) {
+            if (item.stored != item.size) {
+                error = "bad stored block";
+                return false;
+            }
+            sink(stored.data(), stored.size());
+        } else if (item.method == 1) {
+#ifdef MOAD_ZSTD
+            block.resize(item.size);
+            size_t result = ZSTD_decompress(block.data(), block.size(), stored.data(), stored.size());
+            if (ZSTD_isError(result) || result != item.size) {
+                error = "corrupt zstd block";
+                return false;
+            }
+            sink(block.data(), block.size());
+#else
+            error = "zstd block, built without zstd";
+            return false;
+#endif
+        } else {
+            error = "unknown block method";
+            return false;
+        }
+        total += item.size;
+    }
+    if (total != entry.size) {
+        error = "size mismatch";
+        return false;
+    }
+    return true;
+}
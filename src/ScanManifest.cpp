@@ -0,0 +1,161 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <regex>
+
+#include "ScanManifest.h"
+#include "ScanArchive.h"
+#include "Xxh64.h"
+#include "ConfigHandler.h"
+
+namespace fs = std::filesystem;
+
+std::string ScanManifest::checksum(const std::string& file) {
+    std::ifstream input(file, std::ios::binary);
+    if (!input.is_open()) return "";
+
+    Xxh64 hash;
+    std::vector<char> chunk(1 << 20);
+    while (input) {
+        input.read(chunk.data(), chunk.size());
+        hash.update(reinterpret_cast<const unsigned char*>(chunk.data()), static_cast<size_t>(input.gcount()));
+    }
+    return hash.hex();
+}
+
+double ScanManifest::nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void ScanManifest::open(const std::string& dir, const nlohmann::json& scan) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    std::lock_guard<std::mutex> lock(mtx);
+    if (manifest.is_open()) manifest.close();
+    if (!config.getValue<bool>("scan_manifest.enable")) return;
+
+    pose_dir = dir;
+    checksums = config.getValue<bool>("scan_manifest.checksum");
+    // Append, a resumed scan continues the same manifest
+    std::string path = (fs::path(dir) / file_name).string();
+    manifest.open(path, std::ios::app);
+    if (!manifest.is_open()) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        return;
+    }
+
+    nlohmann::json line = scan;
+    line["event"] = "scan_start";
+    line["time_ms"] = nowMs();
+    write(line);
+}
+
+void ScanManifest::close(const nlohmann::json& summary) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!manifest.is_open()) return;
+
+    nlohmann::json line = summary;
+    line["event"] = "scan_end";
+    line["time_ms"] = nowMs();
+    write(line);
+    manifest.close();
+}
+
+bool ScanManifest::isOpen() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return manifest.is_open();
+}
+
+void ScanManifest::record(const ManifestRecord& record) {
+    // The file is complete, the scan archive can take it too
+    ScanArchive::getInstance().add(record.file);
+
+    // The scan thread may open the next pose meanwhile, keep the settings of this one
+    std::string dir;
+    bool hashed;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!manifest.is_open()) return;
+        dir = pose_dir;
+        hashed = checksums;
+    }
+
+    // Size and hash outside the lock, the other threads keep writing their records
+    auto hash_start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    auto size = fs::file_size(record.file, ec);
+    std::string hash = hashed ? checksum(record.file) : "";
+    double hash_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - hash_start).count();
+
+    nlohmann::json line;
+    line["event"] = "file";
+    line["path"] = fs::path(record.file).lexically_relative(dir).generic_string();
+    line["size"] = ec ? 0 : static_cast<unsigned long long>(size);
+    if (hashed) line["xxh64"] = hash;
+    line["camera"] = record.camera;
+    line["type"] = record.type;
+    line["angle"] = record.angle;
+    line["capture_ms"] = record.capture_ms;
+    line["timings"] = record.timings;
+    if (hashed) line["timings"]["hash_ms"] = hash_ms;
+    line["time_ms"] = nowMs();
+    for (const auto& item : record.details.items()) {
+        line[item.key()] = item.value();
+    }
+
+    // Only in the manifest of the pose the path is relative to
+    std::lock_guard<std::mutex> lock(mtx);
+    if (manifest.is_open() && pose_dir == dir) write(line);
+}
+
+// Expects the lock to be held
+void ScanManifest::write(const nlohmann::json& line) {
+    manifest << line.dump() << "\n";
+    manifest.flush();
+}
+
+PoseProgress ScanManifest::readProgress(const std::string& dir) {
+    PoseProgress progress;
+    std::ifstream input((fs::path(dir) / file_name).string());
+    if (input.is_open()) {
+        std::string text;
+        while (std::getline(input, text)) {
+            // The last line can be cut if the program stopped while writing it
+            nlohmann::json line = nlohmann::json::parse(text, nullptr, false);
+            if (line.is_discarded() || !line.is_object()) continue;
+
+            std::string event = line.value("event", "");
+            if (event == "scan_start") {
+                progress.scan = line;
+                progress.finished = false;
+            } else if (event == "scan_end") {
+                progress.finished = true;
+            } else if (event == "file") {
+                std::error_code ec;
+                auto size = fs::file_size(fs::path(dir) / line.value("path", ""), ec);
+                if (ec || size != line.value("size", 0ULL)) continue;
+                progress.files[line.value("angle", 0)][line.value("camera", "")].insert(line.value("type", ""));
+            }
+        }
+        return progress;
+    }
+
+    // No manifest, use the names of the saved files
+    std::regex pattern("(.+)_([0-9]+)_([a-z]+)\\.[a-z]+");
+    for (const char* folder : { "realsense", "DSLR" }) {
+        fs::path path = fs::path(dir) / folder;
+        if (!fs::is_directory(path)) continue;
+        for (const auto& entry : fs::directory_iterator(path)) {
+            std::smatch match;
+            std::string name = entry.path().filename().string();
+            std::error_code ec;
+            if (!entry.is_regular_file() || fs::file_size(entry.path(), ec) == 0 || ec) continue;
+            if (!std::regex_match(name, match, pattern)) continue;
+            progress.files[std::stoi(match[2].str())][match[1].str()].insert(match[3].str());
+        }
+    }
+    return progress;
+}
@@ -0,0 +1,158 @@
+// Scan Pack: Packs, lists, verifies and extracts the scan archives (.moadpack, see ScanArchive.h).
+// Replaces scripts/zip_data.py for the transfers: the scanner already writes the archive of each pose
+// while scanning (archive.enable), and `pack` archives any other folder, e.g. a whole object.
+//
+// verify decompresses every file in memory and checks its xxh64 against the index, without
+// writing anything. The files are checked in parallel.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+
+#include "ScanArchive.h"
+#include "ThreadPool.h"
+#include "Xxh64.h"
+
+namespace fs = std::filesystem;
+using std::cout;
+using std::endl;
+
+struct PackOptions {
+    std::string command;
+    std::string input;
+    std::string output;
+    ArchiveOptions archive;
+};
+
+void printUsage() {
+    cout << "Usage: ScanPack pack <folder> [--output <file.moadpack>] [--level N] [--block-mb N] [--threads N]\n"
+         << "       ScanPack verify <file.moadpack> [--threads N]\n"
+         << "       ScanPack list <file.moadpack>\n"
+         << "       ScanPack extract <file.moadpack> <folder> [--threads N]\n";
+}
+
+bool parseArgs(int argc, char* argv[], PackOptions& options) {
+    if (argc < 3) return false;
+    options.command = argv[1];
+    options.input = argv[2];
+    options.archive.threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--level" && has_value) options.archive.level = std::stoi(argv[++i]);
+        else if (arg == "--block-mb" && has_value) options.archive.block_size = std::stoul(argv[++i]) << 20;
+        else if (arg == "--threads" && has_value) options.archive.threads = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg[0] != '-' && options.command == "extract" && options.output.empty()) options.output = arg;
+        else return false;
+    }
+    if (options.command == "extract") return !options.output.empty();
+    return options.command == "pack" || options.command == "verify" || options.command == "list";
+}
+
+int runPack(PackOptions& options) {
+    fs::path folder = fs::absolute(options.input).lexically_normal();
+    if (folder.filename().empty()) folder = folder.parent_path();
+    if (!fs::is_directory(folder)) {
+        std::cerr << "Folder not found: " << options.input << endl;
+        return 1;
+    }
+    if (options.output.empty()) options.output = folder.string() + ScanArchive::extension;
+
+    ScanArchive archive;
+    if (!archive.open(options.output, folder.string(), options.archive)) return 1;
+    return archive.close() ? 0 : 1;
+}
+
+// Checks the files of the archive (verify), or writes them under options.output (extract)
+int runRead(const PackOptions& options, bool extract) {
+    std::vector<ArchiveEntry> entries;
+    std::string error;
+    if (!ScanArchive::readIndex(options.input, entries, error)) {
+        std::cerr << options.input << ": " << error << endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<std::string>> results;
+    {
+        ThreadPool pool(options.archive.threads);
+        for (const auto& entry : entries) {
+            const ArchiveEntry* item = &entry;
+            auto job = std::make_shared<std::packaged_task<std::string()>>([item, &options, extract]() -> std::string {
+                std::ifstream archive(options.input, std::ios::binary);
+                std::ofstream file;
+                if (extract) {
+                    fs::path target = fs::path(options.output) / fs::path(item->path);
+                    fs::create_directories(target.parent_path());
+                    file.open(target, std::ios::binary | std::ios::trunc);
+                    if (!file.is_open()) return "cannot write " + target.string();
+                }
+                Xxh64 hash;
+                std::string error;
+                bool read = ScanArchive::readEntry(archive, *item, [&hash, &file](const char* data, size_t size) {
+                    hash.update(reinterpret_cast<const unsigned char*>(data), size);
+                    if (file.is_open()) file.write(data, size);
+                }, error);
+                if (!read) return error;
+                if (hash.hex() != item->xxh64) return "checksum mismatch";
+                if (file.is_open() && !file.good()) return "write failed";
+                return "";
+            });
+            results.push_back(job->get_future());
+            pool.enqueueTask([job]() { (*job)(); });
+        }
+
+        // Report in index order as the files finish
+        size_t failed = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            std::string result = results[i].get();
+            if (!result.empty()) {
+                std::cerr << "FAILED " << entries[i].path << ": " << result << endl;
+                failed++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        cout << entries.size() - failed << "/" << entries.size() << " files " << (extract ? "extracted" : "verified")
+             << " in " << seconds << " s" << endl;
+        if (failed > 0) return 1;
+    }
+    return 0;
+}
+
+int runList(const PackOptions& options) {
+    std::vector<ArchiveEntry> entries;
+    std::string error;
+    if (!ScanArchive::readIndex(options.input, entries, error)) {
+        std::cerr << options.input << ": " << error << endl;
+        return 1;
+    }
+    uint64_t size = 0, stored = 0;
+    for (const auto& entry : entries) {
+        uint64_t entry_stored = 0;
+        for (const auto& block : entry.blocks) entry_stored += block.stored;
+        cout << entry.xxh64 << "  " << entry.size << "  " << entry_stored << "  " << entry.path << "\n";
+        size += entry.size;
+        stored += entry_stored;
+    }
+    cout << entries.size() << " files, " << size / 1048576.0 << " MB stored in " << stored / 1048576.0 << " MB" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    PackOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    if (options.command == "pack") return runPack(options);
+    if (options.command == "list") return runList(options);
+    return runRead(options, options.command == "extract");
+}
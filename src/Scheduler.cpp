@@ -0,0 +1,197 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#include "Scheduler.h"
+#include "ConfigHandler.h"
+
+const std::vector<std::string>& Scheduler::queueNames() {
+    static const std::vector<std::string> names = { "capture", "cpu", "io", "background" };
+    return names;
+}
+
+void Scheduler::configure() {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    std::map<std::string, QueueOptions> new_options;
+    for (const std::string& name : queueNames()) {
+        nlohmann::json settings = config.getValue<nlohmann::json>("scheduler." + name);
+        QueueOptions& queue_settings = new_options[name];
+        int threads = settings.value("threads", 0);
+        queue_settings.threads = threads > 0 ? static_cast<size_t>(threads) : 0;
+        queue_settings.cores = settings.value("cores", std::vector<int>());
+        queue_settings.priority = settings.value("priority", std::string("normal"));
+    }
+    configure(new_options, config.getValue<bool>("scheduler.capture.dedicated"));
+}
+
+void Scheduler::configure(std::map<std::string, QueueOptions> new_options, bool dedicated) {
+    size_t hardware = std::thread::hardware_concurrency();
+    if (hardware == 0) hardware = 1;
+
+    // Dedicated capture cores: the queues without cores of their own run on the other cores
+    std::vector<int> remaining;
+    if (dedicated) {
+        const std::vector<int>& capture_cores = new_options["capture"].cores;
+        for (int core = 0; core < static_cast<int>(hardware); core++) {
+            if (std::find(capture_cores.begin(), capture_cores.end(), core) == capture_cores.end()) remaining.push_back(core);
+        }
+        if (capture_cores.empty() || remaining.empty()) {
+            std::cout << "WARNING: Dedicated capture needs capture cores and cores left for the other queues, ignored.\n";
+            dedicated = false;
+            remaining.clear();
+        }
+    }
+    for (auto& item : new_options) {
+        QueueOptions& queue_settings = item.second;
+        if (item.first != "capture" && queue_settings.cores.empty()) queue_settings.cores = remaining;
+        // 0 threads: one per core of the queue
+        if (queue_settings.threads == 0) queue_settings.threads = queue_settings.cores.empty() ? hardware : queue_settings.cores.size();
+    }
+
+    // The old pools are destroyed outside the lock, after their tasks
+    std::map<std::string, std::unique_ptr<ThreadPool>> old_queues;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        old_queues.swap(queues);
+        queue_options = new_options;
+        dedicated_capture = dedicated;
+        for (const auto& item : queue_options) {
+            QueueOptions settings = item.second;
+            std::string name = item.first;
+            queues[item.first] = std::make_unique<ThreadPool>(settings.threads, [settings, name](size_t index) {
+                if (!pinCurrentThread(settings.cores) && !settings.cores.empty() && index == 0) {
+                    std::cout << "WARNING: The " << name << " threads could not be pinned to their cores.\n";
+                }
+                if (!setCurrentThreadPriority(settings.priority) && index == 0) {
+                    std::cout << "WARNING: The " << name << " threads could not get the " << settings.priority << " priority.\n";
+                }
+            });
+        }
+    }
+    printSummary();
+}
+
+void Scheduler::enterCaptureThread(size_t device) {
+    QueueOptions capture = options("capture");
+    bool dedicated;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        dedicated = dedicated_capture;
+    }
+    std::vector<int> cores = capture.cores;
+    if (dedicated) cores = { capture.cores[device % capture.cores.size()] };
+    if (!pinCurrentThread(cores) && !cores.empty()) {
+        std::cout << "WARNING: Capture thread " << device << " could not be pinned.\n";
+    }
+    if (!setCurrentThreadPriority(capture.priority)) {
+        std::cout << "WARNING: Capture thread " << device << " could not get the " << capture.priority << " priority.\n";
+    }
+}
+
+ThreadPool& Scheduler::queue(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = queues.find(name);
+    if (it != queues.end()) return *it->second;
+
+    bool known = false;
+    for (const std::string& queue_name : queueNames()) known = known || queue_name == name;
+    if (!known) throw std::runtime_error("Unknown scheduler queue: " + name);
+    queue_options[name] = QueueOptions();
+    queues[name] = std::make_unique<ThreadPool>(1);
+    return *queues[name];
+}
+
+std::future<void> Scheduler::submit(const std::string& name, std::function<void()> task) {
+    auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packaged->get_future();
+    queue(name).enqueueTask([packaged]() { (*packaged)(); });
+    return result;
+}
+
+void Scheduler::waitIdle(const std::string& name) {
+    queue(name).waitIdle();
+}
+
+std::thread Scheduler::startThread(const std::string& name, std::function<void()> loop) {
+    std::vector<int> cores = options(name).cores;
+    return std::thread([cores, loop]() {
+        pinCurrentThread(cores);
+        loop();
+    });
+}
+
+QueueOptions Scheduler::options(const std::string& name) {
+    queue(name);
+    std::lock_guard<std::mutex> lock(mtx);
+    return queue_options[name];
+}
+
+void Scheduler::printSummary() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::cout << "Scheduler (" << std::thread::hardware_concurrency() << " cores):\n";
+    for (const std::string& name : queueNames()) {
+        auto it = queue_options.find(name);
+        if (it == queue_options.end()) continue;
+        std::cout << "  " << name << ": " << it->second.threads << " threads";
+        if (!it->second.cores.empty()) {
+            std::cout << " on cores";
+            for (int core : it->second.cores) std::cout << " " << core;
+        }
+        if (it->second.priority != "normal") std::cout << ", " << it->second.priority << " priority";
+        if (name == "capture" && dedicated_capture) std::cout << ", one core per device";
+        std::cout << "\n";
+    }
+}
+
+bool Scheduler::pinCurrentThread(const std::vector<int>& cores) {
+    if (cores.empty()) return false;
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int core : cores) {
+        if (core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8)) mask |= static_cast<DWORD_PTR>(1) << core;
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bool any = false;
+    for (int core : cores) {
+        if (core >= 0 && core < CPU_SETSIZE) {
+            CPU_SET(core, &set);
+            any = true;
+        }
+    }
+    return any && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool Scheduler::setCurrentThreadPriority(const std::string& priority) {
+    if (priority == "normal") return true;
+#if defined(_WIN32)
+    if (priority == "high") return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) != 0;
+    if (priority == "realtime") return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#elif defined(__linux__)
+    // The nice value of a thread (Linux sets it per thread), or the FIFO real time class, which
+    // needs CAP_SYS_NICE or an rtprio limit
+    if (priority == "high") return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), -10) == 0;
+    if (priority == "realtime") {
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+#endif
+    return false;
+}
@@ -11,10 +11,14 @@ EdsError TakePicture(EdsCameraRef const& camera, std::string const& bodyID) {
 	std::cout << "Shooting cam" << bodyID << std::endl;
 	// Press the shutter button completely to take a picture
 	err = EdsSendCommand(camera, kEdsCameraCommand_PressShutterButton, kEdsCameraCommand_ShutterButton_Completely_NonAF); // kEdsCameraCommand_ShutterButton_Completely
-	// Release the shutter button after taking the picture
-	err = EdsSendCommand(camera, kEdsCameraCommand_PressShutterButton, kEdsCameraCommand_ShutterButton_OFF);
+	// Release the shutter button after taking the picture, also after a failed press so it is not left half pressed
+	EdsError release_err = EdsSendCommand(camera, kEdsCameraCommand_PressShutterButton, kEdsCameraCommand_ShutterButton_OFF);
+	// Report a busy body to the caller instead of the release result, so it can shoot again
+	if (err != EDS_ERR_OK) {
+		return err;
+	}
 	
-	return err;
+	return release_err;
 }
 
 EdsError TakePicture(std::vector<EdsCameraRef> const& cameraArray, std::map<EdsCameraRef, std::string> const& bodyID) {
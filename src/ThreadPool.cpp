@@ -1,8 +1,8 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(size_t numThreads) : stop(false) {
+ThreadPool::ThreadPool(size_t numThreads, std::function<void(size_t)> start) : stop(false) {
     for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back(&ThreadPool::workerThread, this);
+        workers.emplace_back(&ThreadPool::workerThread, this, i, start);
     }
 }
 
@@ -25,7 +25,13 @@ void ThreadPool::enqueueTask(std::function<void()> task) {
     condition.notify_one();
 }
 
-void ThreadPool::workerThread() {
+void ThreadPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idle.wait(lock, [this]() { return tasks.empty() && active == 0; });
+}
+
+void ThreadPool::workerThread(size_t index, std::function<void(size_t)> start) {
+    if (start) start(index);
     while (true) {
         std::function<void()> task;
         {
@@ -34,7 +40,13 @@ void ThreadPool::workerThread() {
             if (stop && tasks.empty()) return;
             task = std::move(tasks.front());
             tasks.pop();
+            active++;
         }
         task(); // Execute the task
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            active--;
+            if (active == 0 && tasks.empty()) idle.notify_all();
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include <iostream>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "TurntableSerial.h"
+#include "ConfigHandler.h"
+
+bool JsonReplyParser::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        // Skip anything between replies (debug prints, line endings)
+        if (depth == 0 && c != '{') continue;
+
+        current += c;
+        if (c == '{') depth++;
+        if (c == '}') depth--;
+
+        if (depth == 0) {
+            try {
+                replies.push_back(nlohmann::json::parse(current));
+            } catch (const nlohmann::json::parse_error& e) {
+                std::cerr << "Turntable: Ignoring malformed reply " << current << ": " << e.what() << std::endl;
+            }
+            current.clear();
+        }
+    }
+    return hasReply();
+}
+
+nlohmann::json JsonReplyParser::takeReply() {
+    nlohmann::json reply = replies.front();
+    replies.pop_front();
+    return reply;
+}
+
+TurntableSerial::TurntableSerial(const std::string& port, int baud_rate, int connect_delay_ms) {
+    is_connected = openPort(port, baud_rate);
+    if (!is_connected) {
+        return;
+    }
+
+    // The Arduino resets when the port is opened, give it time to boot
+    std::this_thread::sleep_for(std::chrono::milliseconds(connect_delay_ms));
+
+    running = true;
+    reader = std::thread(&TurntableSerial::readerThread, this);
+}
+
+TurntableSerial::~TurntableSerial() {
+    running = false;
+    if (reader.joinable()) {
+        reader.join();
+    }
+    closePort();
+
+    // Fail any command still waiting for a reply
+    std::lock_guard<std::mutex> lock(pending_mtx);
+    for (auto& command : pending_commands) {
+        command.reply.set_exception(std::make_exception_ptr(
+            std::runtime_error("Turntable connection closed before reply to " + command.command)));
+    }
+    pending_commands.clear();
+}
+
+std::string TurntableSerial::portName(const std::string& config_value) {
+    // Full device paths (e.g. /dev/ttyACM0 or a pty) are used as given
+    if (config_value.find('/') != std::string::npos || config_value.find('\\') != std::string::npos) {
+        return config_value;
+    }
+#ifdef _WIN32
+    return "\\\\.\\COM" + config_value;
+#else
+    return "/dev/ttyACM" + config_value;
+#endif
+}
+
+int TurntableSerial::moveTimeoutMs(int degrees) {
+    ConfigHandler& config = ConfigHandler::getInstance();
+    int ms_per_degree = config.getValue<int>("turntable_serial.ms_per_degree");
+    int margin_ms = config.getValue<int>("turntable_serial.timeout_margin_ms");
+    return std::abs(degrees) * ms_per_degree + margin_ms;
+}
+
+std::future<nlohmann::json> TurntableSerial::rotate(int degrees, int timeout_ms) {
+    PendingCommand command;
+    command.command = std::to_string(degrees);
+    command.timeout = std::chrono::milliseconds(timeout_ms);
+    std::future<nlohmann::json> reply = command.reply.get_future();
+
+    if (!is_connected) {
+        command.reply.set_exception(std::make_exception_ptr(std::runtime_error("Turntable serial port not connected")));
+        return reply;
+    }
+
+    // The firmware protocol has no delimiters, so a command is only written once the
+    // previous one was acknowledged. Later commands wait in the queue.
+    std::lock_guard<std::mutex> lock(pending_mtx);
+    pending_commands.push_back(std::move(command));
+    if (pending_commands.size() == 1) {
+        sendFront();
+    }
+    return reply;
+}
+
+// Writes the command at the front of the queue (pending_mtx must be held)
+void TurntableSerial::sendFront() {
+    while (!pending_commands.empty()) {
+        PendingCommand& command = pending_commands.front();
+        command.deadline = std::chrono::steady_clock::now() + command.timeout;
+        if (writePort(command.command)) {
+            return;
+        }
+        command.reply.set_exception(std::make_exception_ptr(
+            std::runtime_error("Failed to write turntable command " + command.command)));
+        pending_commands.pop_front();
+    }
+}
+
+size_t TurntableSerial::pending() {
+    std::lock_guard<std::mutex> lock(pending_mtx);
+    return pending_commands.size();
+}
+
+void TurntableSerial::readerThread() {
+    char buffer[256];
+    while (running) {
+        int received = readPort(buffer, sizeof(buffer));
+        if (received > 0 && parser.feed(buffer, received)) {
+            std::lock_guard<std::mutex> lock(pending_mtx);
+            while (parser.hasReply()) {
+                handleReply(parser.takeReply());
+            }
+        }
+        expireCommands();
+    }
+}
+
+// The command a reply answers, from its "degrees" (or "command" for errors), empty if it has neither
+std::string TurntableSerial::replyCommand(const nlohmann::json& reply) {
+    if (reply.contains("degrees") && reply["degrees"].is_number_integer()) {
+        return std::to_string(reply["degrees"].get<int>());
+    }
+    if (reply.contains("command") && reply["command"].is_string()) {
+        return reply["command"].get<std::string>();
+    }
+    return "";
+}
+
+// Resolves the command a reply belongs to (pending_mtx must be held). The firmware answers in
+// command order, so a late reply of a timed out command comes before the reply of the command
+// sent after it.
+void TurntableSerial::handleReply(const nlohmann::json& reply) {
+    std::string command = replyCommand(reply);
+    if (!expired_commands.empty()) {
+        // Without the command in the reply, the oldest expired command is assumed
+        auto expired = expired_commands.begin();
+        if (!command.empty()) {
+            while (expired != expired_commands.end() && expired->command != command) expired++;
+        }
+        if (expired != expired_commands.end()) {
+            std::cerr << "Turntable: Discarding late reply " << reply.dump() << std::endl;
+            expired_commands.erase(expired_commands.begin(), expired + 1);
+            return;
+        }
+    }
+    if (pending_commands.empty() || (!command.empty() && command != pending_commands.front().command)) {
+        std::cerr << "Turntable: Unexpected reply " << reply.dump() << std::endl;
+        return;
+    }
+    // Only the front command has been sent, so the reply is for it
+    pending_commands.front().reply.set_value(reply);
+    pending_commands.pop_front();
+    sendFront();
+}
+
+void TurntableSerial::expireCommands() {
+    std::lock_guard<std::mutex> lock(pending_mtx);
+    auto now = std::chrono::steady_clock::now();
+    while (!pending_commands.empty() && pending_commands.front().deadline < now) {
+        PendingCommand& command = pending_commands.front();
+        command.reply.set_exception(std::make_exception_ptr(
+            std::runtime_error("Timed out waiting for turntable reply to " + command.command)));
+        // Its reply may still come, until the next command times out too (or as long as it would
+        // have waited if nothing is queued)
+        ExpiredCommand expired;
+        expired.command = command.command;
+        expired.forget_at = now + command.timeout;
+        pending_commands.pop_front();
+        sendFront();
+        if (!pending_commands.empty()) expired.forget_at = pending_commands.front().deadline;
+        expired_commands.push_back(expired);
+    }
+
+    // A reply that never came must not swallow the replies of the later commands
+    while (!expired_commands.empty() && expired_commands.front().forget_at < now) {
+        expired_commands.pop_front();
+    }
+}
+
+#ifdef _WIN32
+
+bool TurntableSerial::openPort(const std::string& port, int baud_rate) {
+    handle = CreateFileA(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Turntable: Failed to open " << port << " (error " << GetLastError() << ")" << std::endl;
+        return false;
+    }
+
+    DCB dcb = { 0 };
+    dcb.DCBlength = sizeof(dcb);
+    if (!GetCommState(handle, &dcb)) {
+        std::cerr << "Turntable: Failed to get the serial parameters of " << port << std::endl;
+        closePort();
+        return false;
+    }
+    dcb.BaudRate = baud_rate;
+    dcb.ByteSize = 8;
+    dcb.StopBits = ONESTOPBIT;
+    dcb.Parity = NOPARITY;
+    dcb.fDtrControl = DTR_CONTROL_ENABLE;
+    if (!SetCommState(handle, &dcb)) {
+        std::cerr << "Turntable: Failed to set the serial parameters of " << port << std::endl;
+        closePort();
+        return false;
+    }
+
+    // Reads return after 100 ms without data so the reader thread can check for shutdown
+    COMMTIMEOUTS timeouts = { 0 };
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 100;
+    timeouts.WriteTotalTimeoutConstant = 1000;
+    SetCommTimeouts(handle, &timeouts);
+    PurgeComm(handle, PURGE_RXCLEAR | PURGE_TXCLEAR);
+    return true;
+}
+
+void TurntableSerial::closePort() {
+    if (handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool TurntableSerial::writePort(const std::string& data) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+    DWORD written = 0;
+    if (!WriteFile(handle, data.c_str(), static_cast<DWORD>(data.size()), &written, NULL)) {
+        return false;
+    }
+    return written == data.size();
+}
+
+int TurntableSerial::readPort(char* buffer, int size) {
+    DWORD received = 0;
+    if (!ReadFile(handle, buffer, size, &received, NULL)) {
+        return -1;
+    }
+    return static_cast<int>(received);
+}
+
+#else
+
+static speed_t toBaudConstant(int baud_rate) {
+    switch (baud_rate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B9600;
+    }
+}
+
+bool TurntableSerial::openPort(const std::string& port, int baud_rate) {
+    fd = open(port.c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        std::cerr << "Turntable: Failed to open " << port << std::endl;
+        return false;
+    }
+
+    // Raw 8N1 mode, the firmware protocol is plain bytes
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        std::cerr << "Turntable: Failed to get the serial parameters of " << port << std::endl;
+        closePort();
+        return false;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, toBaudConstant(baud_rate));
+    cfsetospeed(&tty, toBaudConstant(baud_rate));
+    tty.c_cflag |= (CLOCAL | CREAD);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        std::cerr << "Turntable: Failed to set the serial parameters of " << port << std::endl;
+        closePort();
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+void TurntableSerial::closePort() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool TurntableSerial::writePort(const std::string& data) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+    ssize_t written = write(fd, data.c_str(), data.size());
+    return written == static_cast<ssize_t>(data.size());
+}
+
+int TurntableSerial::readPort(char* buffer, int size) {
+    // Wait up to 100 ms for data so the reader thread can check for shutdown
+    pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 100) <= 0) {
+        return 0;
+    }
+    return static_cast<int>(read(fd, buffer, size));
+}
+
+#endif
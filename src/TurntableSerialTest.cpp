@@ -0,0 +1,114 @@
+// Turntable Serial Test: Runs TurntableSerial against TurntableSim on a pseudo-terminal and checks
+// that the replies resolve the right moves: in order, on a timeout, with the late reply of a timed
+// out move and with a reply the turntable never sends. Linux only, like TurntableSim.
+//
+// Usage: TurntableSerialTest <path to TurntableSim>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <csignal>
+#include <cstdio>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "TurntableSerial.h"
+
+using std::cout;
+using std::endl;
+
+// The simulator moves in base_ms + 2 ms per degree and loses the reply of its fifth move
+static const char* base_ms = "100";
+static const char* ms_per_degree = "2";
+static const char* drop_replies = "5";
+
+int failures = 0;
+
+void check(bool passed, const std::string& name) {
+    cout << (passed ? "PASS " : "FAIL ") << name << endl;
+    if (!passed) failures++;
+}
+
+// Degrees of the reply of a move, or -1 if it failed
+int replyDegrees(std::future<nlohmann::json>& reply) {
+    try {
+        return reply.get().value("degrees", -1);
+    } catch (const std::exception& e) {
+        cout << "  " << e.what() << endl;
+        return -1;
+    }
+}
+
+bool timedOut(std::future<nlohmann::json>& reply) {
+    try {
+        reply.get();
+    } catch (const std::runtime_error& e) {
+        return std::string(e.what()).find("Timed out") != std::string::npos;
+    }
+    return false;
+}
+
+// Starts the simulator and waits for the pty path in its port file
+pid_t startSimulator(const std::string& simulator, const std::string& port_file, std::string& port) {
+    std::remove(port_file.c_str());
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(simulator.c_str(), simulator.c_str(), "--base-ms", base_ms, "--ms-per-degree", ms_per_degree,
+              "--command-gap-ms", "20", "--drop-replies", drop_replies, "--port-file", port_file.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    for (int i = 0; i < 50 && port.empty(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::ifstream input(port_file);
+        std::getline(input, port);
+    }
+    return pid;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cout << "Usage: TurntableSerialTest <path to TurntableSim>\n";
+        return 1;
+    }
+    std::string port;
+    std::string port_file = "/tmp/turntable_serial_test_" + std::to_string(getpid());
+    pid_t simulator = startSimulator(argv[1], port_file, port);
+    if (simulator < 0 || port.empty()) {
+        cout << "FAIL TurntableSim did not start" << endl;
+        return 1;
+    }
+
+    {
+        TurntableSerial turntable(port, 9600, 0);
+        check(turntable.connected(), "connect to " + port);
+
+        // Moves 1 and 2: queued at once, resolved in order
+        std::future<nlohmann::json> first = turntable.rotate(5, 2000);
+        std::future<nlohmann::json> second = turntable.rotate(10, 2000);
+        check(replyDegrees(first) == 5 && replyDegrees(second) == 10, "in order replies");
+
+        // Move 3 takes 280 ms, its reply comes after the timeout and must not resolve move 4
+        std::future<nlohmann::json> slow = turntable.rotate(90, 100);
+        std::future<nlohmann::json> next = turntable.rotate(3, 2000);
+        check(timedOut(slow), "timeout");
+        check(replyDegrees(next) == 3, "late reply discarded");
+
+        // Move 5 has no reply, the moves after it still get theirs
+        std::future<nlohmann::json> lost = turntable.rotate(7, 400);
+        std::future<nlohmann::json> after_lost = turntable.rotate(8, 2000);
+        std::future<nlohmann::json> later = turntable.rotate(9, 2000);
+        check(timedOut(lost), "dropped reply times out");
+        check(replyDegrees(after_lost) == 8 && replyDegrees(later) == 9, "moves after a dropped reply");
+        check(turntable.pending() == 0, "no pending moves");
+    }
+
+    kill(simulator, SIGTERM);
+    waitpid(simulator, nullptr, 0);
+    std::remove(port_file.c_str());
+    cout << (failures == 0 ? "All turntable serial tests passed" : std::to_string(failures) + " turntable serial tests failed") << endl;
+    return failures == 0 ? 0 : 1;
+}
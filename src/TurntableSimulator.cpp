@@ -0,0 +1,181 @@
+// Turntable Simulator: Emulates the turntable Arduino on a pseudo-terminal, so scans can be
+// run and benchmarked without the physical rig. The pty path is printed on startup and can be
+// used as serial_com_port (or with MultiCamCui --serial).
+//
+// Protocol: the host writes the degrees to move as plain text (e.g. "5" or "-90"), the
+// simulator waits for the configured motion time and replies with a JSON object.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+using std::cout;
+using std::endl;
+
+static volatile std::sig_atomic_t running = 1;
+
+void handleSignal(int) {
+    running = 0;
+}
+
+struct SimulatorOptions {
+    int ms_per_degree = 20;     // Motor speed
+    int base_ms = 300;          // Acceleration and firmware overhead per move
+    int command_gap_ms = 50;    // Idle time that ends a command (like Serial.parseInt timeout)
+    std::string port_file;      // Optional file to write the pty path to
+    std::set<int> drop_replies; // Moves (counted from 1) whose reply is lost, to test the host timeouts
+    bool verbose = false;
+};
+
+void printUsage() {
+    cout << "Usage: TurntableSim [--ms-per-degree N] [--base-ms N] [--command-gap-ms N]\n"
+         << "                    [--port-file PATH] [--drop-replies 2,5] [--verbose]\n";
+}
+
+bool parseArgs(int argc, char* argv[], SimulatorOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--ms-per-degree" && has_value) options.ms_per_degree = std::atoi(argv[++i]);
+        else if (arg == "--base-ms" && has_value) options.base_ms = std::atoi(argv[++i]);
+        else if (arg == "--command-gap-ms" && has_value) options.command_gap_ms = std::atoi(argv[++i]);
+        else if (arg == "--port-file" && has_value) options.port_file = argv[++i];
+        else if (arg == "--drop-replies" && has_value) {
+            std::stringstream moves(argv[++i]);
+            std::string move;
+            while (std::getline(moves, move, ',')) {
+                if (!move.empty()) options.drop_replies.insert(std::atoi(move.c_str()));
+            }
+        }
+        else if (arg == "--verbose") options.verbose = true;
+        else return false;
+    }
+    return true;
+}
+
+// Creates the pseudo-terminal, returns the master fd and the slave path
+int openPty(std::string& slave_path) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    slave_path = ptsname(master);
+
+    // Raw mode, so the host sees exactly the bytes the firmware would send
+    int slave = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+    if (slave >= 0) {
+        termios tty;
+        tcgetattr(slave, &tty);
+        cfmakeraw(&tty);
+        tcsetattr(slave, TCSANOW, &tty);
+        close(slave);
+    }
+    return master;
+}
+
+// Simulates one move and sends the reply
+void executeMove(int master, const std::string& command, int& position, const SimulatorOptions& options) {
+    static int moves = 0;
+    moves++;
+    nlohmann::json reply;
+    int degrees = 0;
+    try {
+        degrees = std::stoi(command);
+    } catch (const std::exception&) {
+        reply["status"] = "error";
+        reply["command"] = command;
+        std::string data = reply.dump() + "\r\n";
+        write(master, data.c_str(), data.size());
+        return;
+    }
+
+    int motion_ms = options.base_ms + std::abs(degrees) * options.ms_per_degree;
+    if (options.verbose) {
+        cout << "Moving " << degrees << " degrees (" << motion_ms << " ms)" << endl;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(motion_ms));
+
+    position = ((position + degrees) % 360 + 360) % 360;
+    reply["status"] = "done";
+    reply["degrees"] = degrees;
+    reply["position"] = position;
+    reply["motion_ms"] = motion_ms;
+    if (options.drop_replies.count(moves) > 0) {
+        if (options.verbose) cout << "Dropping the reply of move " << moves << endl;
+        return;
+    }
+    std::string data = reply.dump() + "\r\n";
+    write(master, data.c_str(), data.size());
+}
+
+int main(int argc, char* argv[]) {
+    SimulatorOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::string slave_path;
+    int master = openPty(slave_path);
+    if (master < 0) {
+        std::cerr << "Failed to create pseudo-terminal: " << std::strerror(errno) << endl;
+        return 1;
+    }
+    cout << slave_path << endl;
+    if (!options.port_file.empty()) {
+        std::ofstream port_file(options.port_file);
+        port_file << slave_path << endl;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    int position = 0;
+    std::string command;
+    char buffer[64];
+    while (running) {
+        // The command ends with a newline or after command_gap_ms without new bytes
+        pollfd pfd = { master, POLLIN, 0 };
+        int ready = poll(&pfd, 1, options.command_gap_ms);
+        if (ready > 0 && (pfd.revents & POLLIN)) {
+            ssize_t received = read(master, buffer, sizeof(buffer));
+            if (received > 0) {
+                for (ssize_t i = 0; i < received; i++) {
+                    if (buffer[i] == '\n' || buffer[i] == '\r') {
+                        if (!command.empty()) executeMove(master, command, position, options);
+                        command.clear();
+                    } else {
+                        command += buffer[i];
+                    }
+                }
+                continue;
+            }
+        }
+        if (ready > 0 && (pfd.revents & POLLHUP)) {
+            // No host connected, wait for the next one
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        if (!command.empty()) {
+            executeMove(master, command, position, options);
+            command.clear();
+        }
+    }
+
+    close(master);
+    return 0;
+}